@@ -10,7 +10,9 @@
 // clang-repl-JIT boundary in both directions: catalog thunks Create<T> a
 // Box to hand to the runtime, Evaluate returns one to hand back. Storage
 // is hybrid -- fundamentals (K_Bool ... K_LongDouble) live inline in the
-// union; K_PtrOrObj keeps an owned pointer plus a type-erased
+// union; so do the bytes of small trivially copyable, trivially
+// destructible objects (K_InlineObj), which therefore never touch the
+// heap; K_PtrOrObj keeps an owned pointer plus a type-erased
 // {retain, release} pair so the public header sees only `void*` and
 // function pointers, never the concrete payload type. Copy is shallow +
 // refcounted on K_PtrOrObj (matching clang::Value's model); the bridge
@@ -103,13 +105,18 @@ public:
         K_Char_U, // alias of UChar storage; reached only by runtime bridge
     K_Void,
     K_PtrOrObj,
+    K_InlineObj, // trivially copyable object held in the inline buffer
     K_Unspecified,
   };
 
+  /// Capacity of the K_InlineObj buffer. Its alignment is that of the
+  /// storage union, i.e. of the most aligned fundamental (long double).
+  static constexpr unsigned kInlineSize = 32;
+
   /// Operations vtable for a K_PtrOrObj payload. Defined once per concrete
   /// payload type in the TU that knows the type (see Evaluate's
   /// kCompatValueOps in CppInterOp.cpp). The Box stores a pointer to this
-  /// const-static struct; the storage slot is 2 pointers (16 bytes).
+  /// const-static struct in the union's 2-pointer object slot.
   ///
   /// retain/release implement intrusive ref-counting: AdoptObject installs
   /// the payload with refcount 1; copy ctor / copy assign call retain;
@@ -133,6 +140,7 @@ private:
       void* m_Ptr;
       const ObjectOps* m_Ops;
     } m_Object;
+    unsigned char m_Inline[kInlineSize];
   };
 
   Kind m_kind = K_Unspecified;
@@ -231,11 +239,43 @@ public:
     return v;
   }
 
-  /// Object payload accessor; only valid for K_PtrOrObj. Returns the
-  /// raw pointer set at AdoptObject time. Layout is producer-defined --
-  /// the producer that installed the ObjectOps knows how to extract the
-  /// underlying object.
+  /// Inline-object construction: copies the \c size bytes at \c obj into
+  /// the Box. Only for trivially copyable, trivially destructible objects
+  /// of at most kInlineSize bytes whose alignment the storage union
+  /// satisfies; the producer checks. Copies of the Box copy the bytes and
+  /// the destructor does nothing.
+  static Box CreateInline(const void* obj, unsigned size, void* type) noexcept {
+#ifndef NDEBUG
+    assert(size <= kInlineSize && "Cpp::Box::CreateInline(): too large");
+#endif
+    Box v;
+    v.m_kind = K_InlineObj;
+    v.m_Type = type;
+    const auto* src = static_cast<const unsigned char*>(obj);
+    for (unsigned i = 0; i < size; ++i)
+      v.m_storage.m_Inline[i] = src[i];
+    return v;
+  }
+
+  /// In-place variant of CreateInline: \c init(dst) constructs the object
+  /// directly in the Box's buffer, sparing the copy.
+  template <class Init> static Box ConstructInline(Init&& init, void* type) {
+    Box v;
+    v.m_kind = K_InlineObj;
+    v.m_Type = type;
+    init(v.m_storage.m_Inline);
+    return v;
+  }
+
+  /// Object payload accessor; only valid for K_PtrOrObj and K_InlineObj.
+  /// For K_PtrOrObj, returns the raw pointer set at AdoptObject time.
+  /// Layout is producer-defined -- the producer that installed the
+  /// ObjectOps knows how to extract the underlying object. For
+  /// K_InlineObj, returns the address of the object inside this Box; it
+  /// is invalidated when the Box is moved or destroyed.
   void* getObjectPtr() const noexcept {
+    if (m_kind == K_InlineObj)
+      return const_cast<unsigned char*>(m_storage.m_Inline);
     return m_kind == K_PtrOrObj ? m_storage.m_Object.m_Ptr : nullptr;
   }
 
@@ -249,8 +289,9 @@ public:
   }
 
   /// Runtime-typed dispatch via visitor. Switch over Kind, call visitor
-  /// with the typed T extracted from storage. K_PtrOrObj / K_Void / K_*
-  /// non-fundamental kinds are not dispatched -- caller checks Kind first.
+  /// with the typed T extracted from storage. K_PtrOrObj / K_InlineObj /
+  /// K_Void / K_* non-fundamental kinds are not dispatched -- caller checks
+  /// Kind first.
   // always_inline so the switch reduces to the single case the AOT Kind
   // resolves to; the other arms then dead-strip.
   template <class V>
@@ -264,6 +305,7 @@ public:
     case K_Char_U:
     case K_Void:
     case K_PtrOrObj:
+    case K_InlineObj:
     case K_Unspecified:
       CPPINTEROP_UNREACHABLE();
     }
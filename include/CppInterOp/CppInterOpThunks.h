@@ -19,6 +19,9 @@
 //     // Per-instance lookup -- typically reads the handler pointer from an
 //     // extra prefix slot reserved via MakeVTableOverlay's
 //     // n_extra_prefix_slots, i.e. vptr[-(kVTableOverlayPrefixSize + 1)].
+//     // Instances installed with InstallSharedVTableOverlay share their
+//     // prefix slots, so there the handler is passed as instance_data and
+//     // read back with Cpp::GetSharedVTableOverlayData(self).
 //     static Handler& From(void* self);
 //
 //     // Marshal Args... into the target language, call the bound callable
@@ -30,7 +33,10 @@
 // Each instantiation of dispatch<T, Slot, R, Args...> produces a concrete
 // function with the right calling convention to install in a patched vtable
 // slot. The catalog is a per-binding table of such instantiations indexed by
-// (signature shape, slot).
+// (signature shape, slot). Cpp::EmitThunkCatalog writes the catalog source
+// for a set of reflected classes; Cpp::GetDispatchThunk returns catalog
+// entries registered with Cpp::RegisterThunkCatalog and JIT-compiles the
+// instantiations that are missing.
 //
 //===----------------------------------------------------------------------===//
 
@@ -42,10 +48,15 @@
 namespace Cpp {
 namespace Thunks {
 
-template <class T, std::size_t Slot, class R, class... Args>
-R dispatch(void* self, Args... args) {
-  return T::template Call<R, Args...>(T::From(self), Slot, args...);
-}
+// Spelled through a macro so that GetDispatchThunk hands the interpreter
+// the very same definition.
+#define CPPINTEROP_THUNKS_DISPATCH_DEFINITION                                 \
+  template <class T, std::size_t Slot, class R, class... Args>                \
+  R dispatch(void* self, Args... args) {                                      \
+    return T::template Call<R, Args...>(T::From(self), Slot, args...);        \
+  }
+
+CPPINTEROP_THUNKS_DISPATCH_DEFINITION
 
 } // namespace Thunks
 } // namespace Cpp
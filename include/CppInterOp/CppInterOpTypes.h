@@ -606,6 +606,181 @@ struct VTableOverlay;
 // dangling -- do not dereference) and the cleanup_data passed at install.
 using VTableOverlayDtorHook = void (*)(void* inst, void* cleanup_data);
 
+/// A virtual method and the vtable slot it occupies, counted from the
+/// address point.
+struct VTableSlot {
+  FuncRef m_Method;
+  int m_Slot = -1;
+};
+
+/// Precomputed vtable shape of a polymorphic class, as returned by
+/// GetVTableLayoutInfo. Bindings fetch it once per class and hand the slot
+/// indices to the slot-based MakeVTableOverlay, so that installing an
+/// overlay on each new instance does no AST work.
+struct VTableLayoutInfo {
+  /// True if MakeVTableOverlay accepts the class; the remaining fields are
+  /// only filled in if it does.
+  bool m_CanOverlay = false;
+  /// True if objects of the class carry more than one vptr (several
+  /// polymorphic bases or a virtual base; Itanium only). Slots then run on
+  /// through the secondary vtables of the class's vtable group.
+  bool m_MultipleVPtrs = false;
+  /// Number of vtable slots from the address point onward.
+  int m_NumSlots = 0;
+  /// The final overrider in each slot, in slot order. On Itanium the
+  /// destructor occupies two slots (complete, then deleting).
+  std::vector<VTableSlot> m_Slots;
+  /// The class described.
+  DeclRef m_Class;
+};
+
+/// One precompiled Cpp::Thunks::dispatch instantiation of a thunk catalog,
+/// as written by EmitThunkCatalog and consumed by RegisterThunkCatalog.
+struct ThunkCatalogEntry {
+  /// Signature shape, "R(A1, A2)", with the types spelled fully qualified.
+  const char* m_Shape;
+  /// The Slot template argument.
+  std::size_t m_Slot;
+  /// Address of the instantiation.
+  void* m_Fn;
+};
+
+/// Host callback behind a MakeClosure trampoline. It receives the
+/// user_data given to MakeClosure and the call's arguments in the JitCall
+/// layout: args[i] points to the i-th argument, and ret to storage for the
+/// result (nullptr for void). A result returned by value is constructed in
+/// ret; for a reference result, the referee's address is stored in
+/// *(void**)ret.
+using ClosureHandler = void (*)(void* user_data, size_t nargs, void** args,
+                                void* ret);
+
+/// A column of values of one fundamental type, as returned by
+/// EvaluateBatch: the elements are stored contiguously, so the buffer can be
+/// handed as is to array libraries.
+struct BoxColumn {
+  /// The Cpp::Box::Kind of every element (enums count as their underlying
+  /// integer type); -1 if the batch failed.
+  int m_Kind = -1;
+  /// The element type shared by all elements.
+  TypeRef m_Type;
+  /// sizeof of an element, and the number of elements.
+  size_t m_ElementSize = 0;
+  size_t m_Size = 0;
+  /// m_Size * m_ElementSize bytes of element data.
+  std::vector<unsigned char> m_Data;
+
+  /// The elements as an array of \c T, which must match m_Kind.
+  template <class T> const T* as() const {
+    return reinterpret_cast<const T*>(m_Data.data());
+  }
+};
+
+/// The buffer of a contiguous container, as returned by GetContiguousView.
+/// Element i lives at m_Data + i * m_Stride.
+struct ContiguousView {
+  /// Address of the first element; nullptr if the object is not a known
+  /// contiguous container (an empty one may also have no buffer).
+  void* m_Data = nullptr;
+  /// Number of elements.
+  size_t m_Size = 0;
+  /// Type of the elements.
+  TypeRef m_ElementType;
+  /// Bytes between consecutive elements.
+  size_t m_Stride = 0;
+};
+
+/// Describes the buffer of \c obj, an object of type \c type, in \c view
+/// (see RegisterContiguousView). Returns false if \c obj has no buffer.
+using ContiguousViewHook = bool (*)(void* obj, TypeRef type,
+                                    ContiguousView& view);
+
+/// Cached properties of a canonical type, as returned by GetTypeIdInfo.
+struct TypeIdInfo {
+  /// sizeof in bytes; 0 for incomplete, void and function types.
+  size_t m_Size = 0;
+  /// alignof in bytes; 0 whenever m_Size is 0.
+  size_t m_Align = 0;
+  /// A Cpp::Box::Kind: the fundamental kind for builtins Box can carry,
+  /// K_Void for void, K_Unspecified for other builtins and K_PtrOrObj
+  /// for everything else; -1 for an unknown type id.
+  int m_BuiltinKind = -1;
+  /// Number of pointer levels, e.g. 2 for `int**`.
+  unsigned m_PointerDepth = 0;
+  bool m_IsPOD = false;
+};
+
+/// One template instantiation in an InstantiateTemplates batch.
+struct TemplateInstantiation {
+  DeclRef m_Template;
+  std::vector<TemplateArgInfo> m_Args;
+};
+
+/// An instance field of a class and its byte offset from the start of the
+/// object, as returned by GetFieldLayout.
+struct FieldLayoutEntry {
+  DeclRef m_Field;
+  intptr_t m_Offset = 0;
+};
+
+/// Opaque handle returned by OpenReflectionDatabase: a read-only view of a
+/// memory-mapped reflection index written by ExportReflectionDatabase.
+struct ReflectionDatabase;
+
+/// Kind of a ReflectionDBScope.
+enum ReflectionDBScopeKind : unsigned char {
+  kRDBRoot,
+  kRDBNamespace,
+  kRDBClass,
+  kRDBEnum,
+};
+
+/// Flags of ReflectionDBMethod and ReflectionDBField records.
+enum ReflectionDBFlags : unsigned {
+  kRDBStatic = 1 << 0,
+  kRDBVirtual = 1 << 1,
+  kRDBConst = 1 << 2,
+  kRDBConstructor = 1 << 3,
+  kRDBDestructor = 1 << 4,
+};
+
+/// The strings in the ReflectionDB* records below point into the mapped
+/// file and stay valid until the database is closed.
+struct ReflectionDBScope {
+  /// Fully qualified name.
+  const char* m_Name = "";
+  /// Id of the enclosing scope, as returned by ReflectionDBGetScope; 0 for
+  /// the root.
+  size_t m_Parent = 0;
+  ReflectionDBScopeKind m_Kind = kRDBRoot;
+  /// sizeof for classes and enums.
+  size_t m_Size = 0;
+};
+
+struct ReflectionDBMethod {
+  const char* m_Name = "";
+  const char* m_Signature = "";
+  /// Symbol to pass to GetFunctionAddress; empty if the method has none
+  /// (pure virtual, deleted).
+  const char* m_MangledName = "";
+  unsigned m_NumArgs = 0;
+  unsigned m_Flags = 0; ///< ReflectionDBFlags.
+};
+
+struct ReflectionDBField {
+  const char* m_Name = "";
+  const char* m_Type = "";
+  /// Symbol of a static data member; empty for instance fields.
+  const char* m_MangledName = "";
+  /// Byte offset from the start of the object; 0 for static data members.
+  intptr_t m_Offset = 0;
+  unsigned m_Flags = 0; ///< ReflectionDBFlags.
+};
+
+struct ReflectionDBEnumerator {
+  const char* m_Name = "";
+  int64_t m_Value = 0;
+};
+
 // FIXME: Rework GetDimensions to make this enum redundant.
 namespace DimensionValue {
 enum : long int {
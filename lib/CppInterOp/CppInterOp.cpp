@@ -8,6 +8,7 @@
 //------------------------------------------------------------------------------
 
 #include "CppInterOp/CppInterOp.h"
+#include "CppInterOp/CppInterOpThunks.h"
 #include "Unwrap.h"
 #include "CppInterOp/Error.h"
 
@@ -76,8 +77,11 @@
 #include "clang/Sema/TemplateDeduction.h"
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Demangle/Demangle.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
@@ -92,6 +96,7 @@
 #include "llvm/Support/Error.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Process.h"
 #include "llvm/Support/Signals.h"
@@ -111,6 +116,7 @@
 #include <deque>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -828,6 +834,108 @@ bool IsSmartPtrType(ConstTypeRef TyRef) {
   return INTEROP_RETURN(false);
 }
 
+// Element type of the standard contiguous containers (std::vector except
+// vector<bool>, std::array, std::span, std::basic_string and
+// std::basic_string_view); null for anything else.
+static QualType getStdContiguousElementType(const CXXRecordDecl* RD) {
+  const auto* CTSD = llvm::dyn_cast<ClassTemplateSpecializationDecl>(RD);
+  if (!CTSD || !CTSD->isInStdNamespace() || !CTSD->getIdentifier())
+    return {};
+  llvm::StringRef Name = CTSD->getName();
+  if (Name != "vector" && Name != "array" && Name != "span" &&
+      Name != "basic_string" && Name != "basic_string_view")
+    return {};
+  const TemplateArgumentList& Args = CTSD->getTemplateArgs();
+  if (!Args.size() || Args[0].getKind() != TemplateArgument::Type)
+    return {};
+  QualType Elt = Args[0].getAsType();
+  // vector<bool> is bit-packed and has no data().
+  if (Name == "vector" && Elt->isBooleanType())
+    return {};
+  return Elt;
+}
+
+ContiguousView GetContiguousView(ConstTypeRef type, void* obj) {
+  INTEROP_TRACE(type, obj);
+  ContiguousView View;
+  QualType QT = QualType::getFromOpaquePtr(type.data);
+  if (QT.isNull() || !obj)
+    return INTEROP_RETURN(View);
+  QT = QT.getNonReferenceType().getCanonicalType();
+  ASTContext& C = getASTContext();
+
+  if (const auto* CAT = C.getAsConstantArrayType(QT)) {
+    QualType Elt = CAT->getElementType();
+    View.m_Data = obj;
+    View.m_Size = CAT->getSize().getLimitedValue();
+    View.m_ElementType = Elt.getAsOpaquePtr();
+    View.m_Stride = C.getTypeSizeInChars(Elt).getQuantity();
+    return INTEROP_RETURN(View);
+  }
+
+  const auto* RD = QT->getAsCXXRecordDecl();
+  if (!RD)
+    return INTEROP_RETURN(View);
+  auto& II = getInterpInfo();
+  // A hook registered for the class wins over one for its template.
+  const Decl* Keys[] = {RD->getCanonicalDecl(), nullptr};
+  if (const auto* CTSD = llvm::dyn_cast<ClassTemplateSpecializationDecl>(RD))
+    Keys[1] = CTSD->getSpecializedTemplate()->getCanonicalDecl();
+  for (const Decl* Key : Keys) {
+    if (!Key)
+      continue;
+    auto Hook = II.ContiguousViewHooks.find(Key);
+    if (Hook == II.ContiguousViewHooks.end())
+      continue;
+    if (!Hook->second(obj, QT.getAsOpaquePtr(), View))
+      View = ContiguousView();
+    return INTEROP_RETURN(View);
+  }
+
+  QualType Elt = getStdContiguousElementType(RD);
+  if (Elt.isNull())
+    return INTEROP_RETURN(View);
+  void*& Extractor = II.ContiguousViewExtractors[QT.getAsOpaquePtr()];
+  if (!Extractor) {
+    static unsigned long long Serial = 0;
+    std::string Name = "__cppinterop_view" + std::to_string(Serial++);
+    std::string T;
+    get_type_as_string(QT, T, C, PrintingPolicy(C.getPrintingPolicy()));
+    std::string Code = "__attribute__((used)) extern \"C\" void " + Name +
+                       "(void* obj, void** data, __SIZE_TYPE__* size) {\n" +
+                       "  auto& o = *static_cast<" + T + "*>(obj);\n" +
+                       "  *data = (void*)o.data();\n" +
+                       "  *size = o.size();\n" + "}\n";
+    Extractor = getInterp().compileFunction(Name, Code, /*ifUnique=*/false,
+                                            /*withAccessControl=*/true);
+    if (!Extractor) {
+      II.ContiguousViewExtractors.erase(QT.getAsOpaquePtr());
+      return INTEROP_RETURN(View);
+    }
+  }
+  VTableOverlay::BitCastFn<void (*)(void*, void**, size_t*)>(Extractor)(
+      obj, &View.m_Data, &View.m_Size);
+  View.m_ElementType = Elt.getAsOpaquePtr();
+  View.m_Stride = C.getTypeSizeInChars(Elt).getQuantity();
+  return INTEROP_RETURN(View);
+}
+
+void RegisterContiguousView(ConstDeclRef scope, ContiguousViewHook hook) {
+  INTEROP_TRACE(scope, hook);
+  const auto* D = unwrap<Decl>(scope);
+  if (const auto* RD = llvm::dyn_cast_or_null<CXXRecordDecl>(D))
+    if (const ClassTemplateDecl* CTD = RD->getDescribedClassTemplate())
+      D = CTD;
+  if (!llvm::isa_and_nonnull<CXXRecordDecl, ClassTemplateDecl>(D))
+    return INTEROP_VOID_RETURN();
+  auto& Hooks = getInterpInfo().ContiguousViewHooks;
+  if (hook)
+    Hooks[D->getCanonicalDecl()] = hook;
+  else
+    Hooks.erase(D->getCanonicalDecl());
+  return INTEROP_VOID_RETURN();
+}
+
 TypeRef GetIntegerTypeFromEnumScope(ConstDeclRef DRef) {
   INTEROP_TRACE(DRef);
   const auto* D = unwrap<clang::Decl>(DRef);
@@ -2749,27 +2857,27 @@ static int vtableMethodSlotCount(ConstDeclRef DRef) {
 }
 
 // True if \c RD's vtable layout is beyond the single-vptr overlay model:
-//  * multiple polymorphic direct bases -> secondary-base subobjects have
-//    their own vptrs that the overlay does not touch, so dispatch through
-//    a pointer to such a subobject would silently hit the original method;
+//  * several vptrs, whether from multiple polymorphic direct bases or from
+//    a base further up which has them -> secondary-base subobjects have
+//    their own vptrs, so dispatch through a pointer to such a subobject
+//    would silently hit the original method;
 //  * any virtual base -> the primary vtable has vbase-offset entries
 //    before the address point, and the virtual-base subobject carries a
-//    vtable-in-derived with virtual thunks that the overlay does not
-//    retarget. Returns true so MakeVTableOverlay can refuse instead of
-//    quietly mis-overlaying.
+//    vtable-in-derived with virtual thunks.
+// The ABI's vtable context counts the vptrs, so bases of bases are covered.
+// On Itanium such classes take the vtable-group overlay path
+// (installVTableGroupOverlay), which retargets every vptr; on Microsoft
+// MakeVTableOverlay refuses them instead of quietly mis-overlaying.
 static bool hasComplexVTableLayout(const CXXRecordDecl* RD) {
   if (RD->getNumVBases() > 0)
     return true;
-  unsigned polymorphic_direct_bases = 0;
-  for (const auto& B : RD->bases()) {
-    const auto* BD = B.getType()->getAsCXXRecordDecl();
-    if (!BD)
-      continue;
-    BD = BD->getDefinition();
-    if (BD && BD->isPolymorphic() && ++polymorphic_direct_bases > 1)
-      return true;
+  ASTContext& C = getASTContext();
+  if (C.getTargetInfo().getCXXABI().isMicrosoft()) {
+    auto* VTC = llvm::cast<MicrosoftVTableContext>(C.getVTableContext());
+    return VTC->getVFPtrOffsets(RD).size() > 1;
   }
-  return false;
+  auto* VTC = llvm::cast<ItaniumVTableContext>(C.getVTableContext());
+  return VTC->getVTableLayout(RD).getNumVTables() > 1;
 }
 
 // ABI-only prefix size (excludes the hidden self-pointer slot CppInterOp
@@ -2790,8 +2898,10 @@ static_assert(detail::kVTableOverlayPrefixSize == kABIPrefixSize + 1,
 struct VTableOverlayDtorHost {
 #ifdef _WIN32
   void Wrapper(int flags);
+  void SharedWrapper(int flags);
 #else
   void Wrapper();
+  void SharedWrapper();
 #endif
 };
 #ifdef _WIN32
@@ -2830,7 +2940,17 @@ struct VTableOverlay {
   void** block;         // owned, freed in ~VTableOverlay
   void** original_vptr; // restored on caller-driven teardown
   void* inst;           // object whose vptr was replaced
+  // MakeVTableOverlayArray covers count objects, stride bytes apart,
+  // starting at inst; every other overlay covers just inst.
+  std::size_t count;
+  std::size_t stride;
   std::size_t n_extra_prefix_slots;
+  // Slots between the hidden slot and the address point: the ABI prefix,
+  // or everything up to the primary address point of a vtable group.
+  std::size_t n_abi_prefix_slots;
+  // (object offset, original vptr) of the secondary vptrs that a vtable
+  // group overlay replaced; restored together with original_vptr.
+  llvm::SmallVector<std::pair<std::ptrdiff_t, void**>, 0> secondary_vptrs;
   bool dtor_fired = false; // wrapper started -- skip vptr restore
   // Dtor-hook fields. orig_dtor stays null when the caller passed
   // on_destroy = nullptr; the wrapper is then not installed at all.
@@ -2839,24 +2959,37 @@ struct VTableOverlay {
   void* cleanup_data = nullptr;
 
   VTableOverlay(void** block, void** orig_vptr, void* inst,
-                std::size_t n_extra)
-      : block(block), original_vptr(orig_vptr), inst(inst),
-        n_extra_prefix_slots(n_extra) {
+                std::size_t n_extra,
+                std::size_t n_abi_prefix = kABIPrefixSize,
+                std::size_t count = 1, std::size_t stride = 0)
+      : block(block), original_vptr(orig_vptr), inst(inst), count(count),
+        stride(stride), n_extra_prefix_slots(n_extra),
+        n_abi_prefix_slots(n_abi_prefix) {
     // Stash self-pointer in the hidden slot before publishing the vptr;
     // the wrapper reads it at fire time via a fixed offset from vptr.
     *hidden_slot() = this;
-    WriteVPtr(inst, address_point());
+    void** vptr = address_point();
+    for (std::size_t i = 0; i < count; ++i)
+      WriteVPtr(element(i), vptr);
   }
   ~VTableOverlay() {
-    if (!dtor_fired)
-      WriteVPtr(inst, original_vptr);
+    if (!dtor_fired) {
+      for (std::size_t i = 0; i < count; ++i) {
+        WriteVPtr(element(i), original_vptr);
+        for (const auto& VP : secondary_vptrs)
+          WriteVPtr(static_cast<char*>(element(i)) + VP.first, VP.second);
+      }
+    }
     delete[] block;
   }
   VTableOverlay(const VTableOverlay&) = delete;
   VTableOverlay& operator=(const VTableOverlay&) = delete;
 
   void** address_point() const {
-    return block + n_extra_prefix_slots + detail::kVTableOverlayPrefixSize;
+    return block + n_extra_prefix_slots + 1 + n_abi_prefix_slots;
+  }
+  void* element(std::size_t i) const {
+    return static_cast<char*>(inst) + i * stride;
   }
   VTableOverlay** hidden_slot() const {
     return reinterpret_cast<VTableOverlay**>(block + n_extra_prefix_slots);
@@ -2917,17 +3050,17 @@ constexpr int kMinVTableMethodSlots = 1;
 constexpr int kMinVTableMethodSlots = 2;
 #endif
 
-// Reflection-free pointer surgery: copy inst's vtable, overwrite slots with
-// fns, install the copy and return a DRef owning it. The slot indices and
-// count are resolved from reflection by the caller (MakeVTableOverlay).
-// n_extra_prefix_slots prepends nullptr-initialized void* slots before the
-// ABI prefix; the caller stashes per-instance data there and thunks read it
-// via vptr[-(kPrefix + 1 + i)].
-static VTableOverlay* applyVTableOverlay(void* inst, int total_method_slots,
-                                         const int* slots, void* const* fns,
-                                         std::size_t n,
-                                         std::size_t n_extra_prefix_slots) {
-  if (!inst || total_method_slots < kMinVTableMethodSlots)
+// Reflection-free pointer surgery: copy the vtable at orig_vptr into a new
+// block laid out as described above VTableOverlay and overwrite slots with
+// fns. Returns nullptr if a slot is out of range. n_extra_prefix_slots
+// prepends nullptr-initialized void* slots before the ABI prefix; the
+// caller stashes its data there and thunks read it via
+// vptr[-(kPrefix + 1 + i)]. The hidden slot is left for the caller to fill.
+static void** buildVTableOverlayBlock(void** orig_vptr, int total_method_slots,
+                                      const int* slots, void* const* fns,
+                                      std::size_t n,
+                                      std::size_t n_extra_prefix_slots) {
+  if (total_method_slots < kMinVTableMethodSlots)
     return nullptr;
   for (std::size_t i = 0; i < n; ++i) {
     if (slots[i] < 0 || slots[i] >= total_method_slots)
@@ -2940,22 +3073,46 @@ static VTableOverlay* applyVTableOverlay(void* inst, int total_method_slots,
   constexpr int kPrefix = detail::kVTableOverlayPrefixSize;
   const std::size_t total = n_extra_prefix_slots + kPrefix + total_method_slots;
 
-  void** orig_vptr = VTableOverlay::ReadVPtr(inst);
   // Zero-init so user-extra slots are nullptr (callers will populate).
-  // The hidden slot at block[n_extra_prefix_slots] is filled by the
-  // VTableOverlay ctor below. The memcpy then copies the original ABI
-  // prefix + methods into the remaining region.
+  // The memcpy copies the original ABI prefix + methods into the region
+  // after the hidden slot.
   void** block = new void*[total]();
   std::memcpy(block + n_extra_prefix_slots + 1, orig_vptr - kABIPrefixSize,
               (kABIPrefixSize + total_method_slots) * sizeof(void*));
 
   for (std::size_t i = 0; i < n; ++i)
     block[n_extra_prefix_slots + kPrefix + slots[i]] = fns[i];
+  return block;
+}
+
+// Copy inst's vtable, overwrite slots with fns, install the copy and return
+// a DRef owning it. The slot indices and count are resolved from
+// reflection by the caller (MakeVTableOverlay). For arrays, all count
+// elements must share inst's vtable.
+static VTableOverlay* applyVTableOverlay(void* inst, int total_method_slots,
+                                         const int* slots, void* const* fns,
+                                         std::size_t n,
+                                         std::size_t n_extra_prefix_slots,
+                                         std::size_t count,
+                                         std::size_t stride) {
+  if (!inst)
+    return nullptr;
+  void** orig_vptr = VTableOverlay::ReadVPtr(inst);
+  for (std::size_t i = 1; i < count; ++i)
+    if (VTableOverlay::ReadVPtr(static_cast<char*>(inst) + i * stride) !=
+        orig_vptr)
+      return nullptr;
+  void** block = buildVTableOverlayBlock(orig_vptr, total_method_slots, slots,
+                                         fns, n, n_extra_prefix_slots);
+  if (!block)
+    return nullptr;
 
   // Per-instance install: the new vptr is written into *this* object only.
   // Other live and future instances of the same TyRef continue to use the
-  // class's original vtable; ~VTableOverlay restores `inst`'s vptr.
-  return new VTableOverlay(block, orig_vptr, inst, n_extra_prefix_slots);
+  // class's original vtable; ~VTableOverlay restores `inst`'s vptr. The
+  // VTableOverlay ctor fills the hidden slot.
+  return new VTableOverlay(block, orig_vptr, inst, n_extra_prefix_slots,
+                           kABIPrefixSize, count, stride);
 }
 
 // Itanium emits the destructor pair (D1, D0) at slots 0 and 1; the
@@ -2969,42 +3126,356 @@ constexpr int kDeletingDtorSlot = 0;
 constexpr int kDeletingDtorSlot = 1;
 #endif
 
-VTableOverlay*
-MakeVTableOverlay(void* inst, ConstDeclRef base, const ConstFuncRef* methods,
-                  void* const* overlay_fns, std::size_t n_overlays,
-                  std::size_t n_extra_prefix_slots,
-                  VTableOverlayDtorHook on_destroy, void* cleanup_data) {
-  INTEROP_TRACE(inst, base, methods, overlay_fns, n_overlays,
-                n_extra_prefix_slots, on_destroy, cleanup_data);
-  // Refuse layouts the single-primary-vptr overlay cannot fully express,
-  // so the caller cannot silently produce mis-dispatching objects. Must run
-  // before vtableMethodSlotCount: on MSVC, getVFTableLayout(RD, offset 0)
-  // asserts when a virtual-inheritance class has no VFTable at that offset.
-  if (!inst)
-    return INTEROP_RETURN(nullptr);
+// Everything GetVTableLayoutInfo reports about RD, which must be a
+// definition. Classes the overlay cannot handle are reported before their
+// slots are counted: on MSVC, getVFTableLayout(RD, offset 0) asserts when a
+// virtual-inheritance class has no VFTable at that offset. On Itanium the
+// slots of a class with several vptrs cover its whole vtable group, which
+// the loop below walks unchanged: the group starts with the primary vtable.
+static VTableLayoutInfo computeVTableLayoutInfo(const CXXRecordDecl* RD) {
+  VTableLayoutInfo Info;
+  if (!RD->isPolymorphic() || RD->isDependentType())
+    return Info;
+  ASTContext& C = getASTContext();
+  bool MultipleVPtrs = hasComplexVTableLayout(RD);
+  if (MultipleVPtrs && C.getTargetInfo().getCXXABI().isMicrosoft())
+    return Info;
+  int total_method_slots = vtableMethodSlotCount(RD);
+  if (total_method_slots < kMinVTableMethodSlots)
+    return Info;
+  Info.m_CanOverlay = true;
+  Info.m_MultipleVPtrs = MultipleVPtrs;
+  Info.m_NumSlots = total_method_slots;
+  Info.m_Class = const_cast<CXXRecordDecl*>(RD);
+
+  llvm::ArrayRef<VTableComponent> Components;
+  if (C.getTargetInfo().getCXXABI().isMicrosoft()) {
+    auto* VTC = llvm::cast<MicrosoftVTableContext>(C.getVTableContext());
+    Components =
+        VTC->getVFTableLayout(RD, CharUnits::Zero()).vtable_components();
+  } else {
+    auto* VTC = llvm::cast<ItaniumVTableContext>(C.getVTableContext());
+    const VTableLayout& L = VTC->getVTableLayout(RD);
+    Components =
+        L.vtable_components().drop_front(L.getAddressPointIndices()[0]);
+  }
+  for (size_t i = 0, e = Components.size(); i < e; ++i) {
+    const VTableComponent& VC = Components[i];
+    const CXXMethodDecl* MD = nullptr;
+    if (VC.isDestructorKind())
+      MD = VC.getDestructorDecl();
+    else if (VC.isUsedFunctionPointerKind())
+      MD = VC.getFunctionDecl();
+    if (!MD)
+      continue;
+    VTableSlot Slot;
+    Slot.m_Method = const_cast<CXXMethodDecl*>(MD);
+    Slot.m_Slot = static_cast<int>(i);
+    Info.m_Slots.push_back(Slot);
+  }
+  return Info;
+}
+
+// The per-interpreter cached VTableLayoutInfo of RD, which must be a
+// definition. The reference is invalidated by the next cache insertion.
+static const VTableLayoutInfo& cachedVTableLayoutInfo(const CXXRecordDecl* RD) {
+  auto& Cache = getInterpInfo().VTableLayouts;
+  auto It = Cache.find(RD->getCanonicalDecl());
+  if (It == Cache.end())
+    It = Cache.try_emplace(RD->getCanonicalDecl(), computeVTableLayoutInfo(RD))
+             .first;
+  return It->second;
+}
+
+VTableLayoutInfo GetVTableLayoutInfo(ConstDeclRef base) {
+  INTEROP_TRACE(base);
   const auto* RD = llvm::dyn_cast_or_null<CXXRecordDecl>(unwrap<Decl>(base));
   if (RD)
     RD = RD->getDefinition();
-  if (!RD || !RD->isPolymorphic() || hasComplexVTableLayout(RD))
-    return INTEROP_RETURN(nullptr);
+  if (!RD)
+    return INTEROP_RETURN(VTableLayoutInfo());
+  return INTEROP_RETURN(cachedVTableLayoutInfo(RD));
+}
 
-  int total_method_slots = vtableMethodSlotCount(base);
-  if (total_method_slots < kMinVTableMethodSlots)
-    return INTEROP_RETURN(nullptr);
+// Defined with the JitCall helpers below.
+namespace {
+void get_type_as_string(QualType QT, std::string& type_name, ASTContext& C,
+                        PrintingPolicy Policy);
+} // namespace
 
-  llvm::SmallVector<int, 8> slots;
-  slots.reserve(n_overlays);
+// The Itanium vtable group of RD, which must be a definition, in the form
+// the vtable-group overlay consumes.
+static InterpreterInfo::VTableGroup
+computeVTableGroup(const CXXRecordDecl* RD) {
+  InterpreterInfo::VTableGroup G;
+  auto* VTC =
+      llvm::cast<ItaniumVTableContext>(getASTContext().getVTableContext());
+  const VTableLayout& L = VTC->getVTableLayout(RD);
+  llvm::ArrayRef<VTableComponent> Components = L.vtable_components();
+  G.AddressPoint = static_cast<int>(L.getAddressPointIndices()[0]);
+  G.NumComponents = static_cast<int>(Components.size());
+
+  // Each vtable of the group belongs to the subobject (and its primary
+  // bases) at one object offset; the primary vtable comes first.
+  llvm::SmallVector<intptr_t, 4> Offsets(L.getNumVTables(), 0);
+  for (const auto& AP : L.getAddressPoints())
+    Offsets[AP.second.VTableIndex] = AP.first.getBaseOffset().getQuantity();
+  for (size_t i = 0, e = L.getNumVTables(); i < e; ++i) {
+    size_t AddressPoint = L.getVTableOffset(i) + L.getAddressPointIndices()[i];
+    G.VPtrs.emplace_back(Offsets[i],
+                         static_cast<int>(AddressPoint) - G.AddressPoint);
+  }
+
+  std::vector<bool> AdjustsReturn(Components.size(), false);
+  for (const auto& Thunk : L.vtable_thunks())
+    if (!Thunk.second.Return.isEmpty())
+      AdjustsReturn[Thunk.first] = true;
+
+  G.SlotOverrider.assign(G.NumComponents - G.AddressPoint, -1);
+  for (size_t i = 0, e = L.getNumVTables(); i < e; ++i) {
+    size_t Begin = L.getVTableOffset(i);
+    for (size_t j = Begin, End = Begin + L.getVTableSize(i); j < End; ++j) {
+      const VTableComponent& VC = Components[j];
+      int Slot = static_cast<int>(j) - G.AddressPoint;
+      if (VC.getKind() == VTableComponent::CK_DeletingDtorPointer) {
+        G.DeletingDtors.emplace_back(Slot, Offsets[i]);
+        continue;
+      }
+      if (VC.getKind() != VTableComponent::CK_FunctionPointer)
+        continue;
+      const Decl* MD = VC.getFunctionDecl()->getCanonicalDecl();
+      auto Ins = G.OverriderIndex.try_emplace(
+          MD, static_cast<int>(G.Overriders.size()));
+      if (Ins.second) {
+        G.Overriders.emplace_back();
+        G.Overriders.back().Method = MD;
+      }
+      auto& O = G.Overriders[Ins.first->second];
+      O.Slots.emplace_back(Slot, Offsets[i]);
+      O.AdjustsReturn |= AdjustsReturn[j];
+      G.SlotOverrider[Slot] = Ins.first->second;
+    }
+  }
+  return G;
+}
+
+// The per-interpreter cached vtable group of RD, which must be a definition
+// with several vptrs on an Itanium target.
+static InterpreterInfo::VTableGroup&
+cachedVTableGroup(const CXXRecordDecl* RD) {
+  auto& Cache = getInterpInfo().VTableGroups;
+  auto It = Cache.find(RD->getCanonicalDecl());
+  if (It == Cache.end())
+    It = Cache.emplace(RD->getCanonicalDecl(), computeVTableGroup(RD)).first;
+  return It->second;
+}
+
+// The this-adjusting thunk a vtable group overlay installs in a slot of the
+// vtable at object offset Offset: it moves `this` back to the complete
+// object and calls what the overlay stored in the private slot of
+// Overrider, past the end of the group. Overrider -1 selects the
+// deleting-destructor thunk, which passes the complete object and the
+// hidden self-pointer slot to runVTableOverlayGroupDtorHook. The thunks
+// depend on the class only, so each is compiled once per interpreter.
+// Returns nullptr if the method's signature cannot be forwarded.
+static void* vtableGroupThunk(InterpreterInfo::VTableGroup& G, int Overrider,
+                              intptr_t Offset) {
+  auto It = G.Thunks.find({Overrider, Offset});
+  if (It != G.Thunks.end())
+    return It->second;
+
+  const int NumSlots = G.NumComponents - G.AddressPoint;
+  const int PrivateSlot =
+      NumSlots +
+      (Overrider < 0 ? static_cast<int>(G.Overriders.size()) : Overrider);
+  std::string Ret = "void";
+  std::vector<std::string> Params;
+  if (Overrider >= 0) {
+    const auto* MD = llvm::cast<CXXMethodDecl>(G.Overriders[Overrider].Method);
+    if (MD->isVariadic())
+      return G.Thunks[{Overrider, Offset}] = nullptr;
+    ASTContext& C = MD->getASTContext();
+    PrintingPolicy Policy(C.getPrintingPolicy());
+    Ret.clear();
+    get_type_as_string(MD->getReturnType(), Ret, C, Policy);
+    for (const ParmVarDecl* P : MD->parameters()) {
+      Params.emplace_back();
+      get_type_as_string(P->getType(), Params.back(), C, Policy);
+    }
+  }
+
+  // A free function taking `this` first has the member function's calling
+  // convention on Itanium, including where an sret pointer goes. Types are
+  // spelled through aliases so that function-pointer types need no
+  // declarator surgery.
+  static unsigned long long Serial = 0;
+  std::string Name = "__cppinterop_vtable_thunk" + std::to_string(Serial++);
+  std::ostringstream Code;
+  Code << "#pragma clang diagnostic push\n"
+          "#pragma clang diagnostic ignored \"-Wreturn-type-c-linkage\"\n";
+  Code << "using " << Name << "_r = " << Ret << ";\n";
+  for (size_t i = 0; i < Params.size(); ++i)
+    Code << "using " << Name << "_p" << i << " = " << Params[i] << ";\n";
+  Code << "__attribute__((used)) extern \"C\" " << Name << "_r " << Name
+       << "(void* self";
+  for (size_t i = 0; i < Params.size(); ++i)
+    Code << ", " << Name << "_p" << i << " a" << i;
+  Code << ") {\n"
+       << "  char* obj = static_cast<char*>(self) - " << Offset << "LL;\n"
+       << "  void** vp = *reinterpret_cast<void***>(obj);\n";
+  if (Overrider < 0) {
+    Code << "  reinterpret_cast<void (*)(void*, void*)>(vp[" << PrivateSlot
+         << "])(obj, vp[" << -(G.AddressPoint + 1) << "]);\n";
+  } else {
+    Code << "  return reinterpret_cast<" << Name << "_r (*)(void*";
+    for (size_t i = 0; i < Params.size(); ++i)
+      Code << ", " << Name << "_p" << i;
+    Code << ")>(vp[" << PrivateSlot << "])(obj";
+    for (size_t i = 0; i < Params.size(); ++i)
+      Code << ", static_cast<" << Name << "_p" << i << "&&>(a" << i << ")";
+    Code << ");\n";
+  }
+  Code << "}\n"
+       << "#pragma clang diagnostic pop\n";
+  void* Addr = getInterp().compileFunction(Name, Code.str(),
+                                           /*ifUnique=*/false,
+                                           /*withAccessControl=*/false);
+  return G.Thunks[{Overrider, Offset}] = Addr;
+}
+
+#ifndef _WIN32
+// Target of the deleting-destructor thunks of a vtable group overlay, with
+// the complete object and the overlay from the hidden slot; otherwise the
+// same as VTableOverlayDtorHost::Wrapper.
+static void runVTableOverlayGroupDtorHook(void* obj, void* hidden) {
+  auto* ov = static_cast<VTableOverlay*>(hidden);
+  auto orig_dtor = ov->orig_dtor;
+  ov->dtor_fired = true;
+  if (ov->cleanup)
+    ov->cleanup(obj, ov->cleanup_data);
+  (static_cast<VTableOverlayDtorHost*>(obj)->*orig_dtor)();
+}
+#endif
+
+// MakeVTableOverlay for classes whose objects carry several vptrs (Itanium
+// only). The whole vtable group is copied into one block,
+//
+//   [ user extras (N) ] [ hidden self-ptr ] [ group ] [ private slots ]
+//                                                ^ primary address point
+//
+// and every vptr of inst is pointed at its vtable in the copy. A replaced
+// method gets its function in its primary-vtable slots; its slots in
+// secondary and virtual-base vtables get a thunk that adjusts `this` and
+// calls the function through the method's private slot, so the replacement
+// always receives the complete object. The thunks hard-code subobject
+// offsets, hence inst must be a complete object of RD; the vptr check below
+// rejects objects whose vtables do not form RD's group. The extra-prefix
+// slots sit at a fixed distance from the address point only when no vcall
+// or vbase offsets precede it, so they are refused otherwise.
+static VTableOverlay*
+installVTableGroupOverlay(void* inst, const CXXRecordDecl* RD,
+                          const int* slots, void* const* overlay_fns,
+                          std::size_t n_overlays,
+                          std::size_t n_extra_prefix_slots,
+                          VTableOverlayDtorHook on_destroy, void* cleanup_data,
+                          std::size_t count = 1, std::size_t stride = 0) {
+#ifdef _WIN32
+  return nullptr;
+#else
+  if (!inst)
+    return nullptr;
+  InterpreterInfo::VTableGroup& G = cachedVTableGroup(RD);
+  if (n_extra_prefix_slots && G.AddressPoint != kABIPrefixSize)
+    return nullptr;
+  const int NumSlots = G.NumComponents - G.AddressPoint;
+  void** orig_vptr = VTableOverlay::ReadVPtr(inst);
+  for (std::size_t i = 0; i < count; ++i) {
+    for (const auto& VP : G.VPtrs) {
+      void* sub = static_cast<char*>(inst) + i * stride + VP.first;
+      if (VTableOverlay::ReadVPtr(sub) != orig_vptr + VP.second)
+        return nullptr;
+    }
+  }
+
+  // Resolve the slot values, compiling missing thunks, before anything is
+  // allocated or published.
+  llvm::SmallVector<std::pair<int, void*>, 8> method_slots;
   for (std::size_t i = 0; i < n_overlays; ++i) {
-    int slot = virtualMethodSlot(methods[i]);
-    if (slot < 0)
-      return INTEROP_RETURN(nullptr);
-    slots.push_back(slot);
+    if (slots[i] < 0 || slots[i] >= NumSlots)
+      return nullptr;
+    int O = G.SlotOverrider[slots[i]];
+    if (O < 0 || G.Overriders[O].AdjustsReturn)
+      return nullptr;
+    for (const auto& S : G.Overriders[O].Slots) {
+      void* fn = overlay_fns[i];
+      if (S.second && !(fn = vtableGroupThunk(G, O, S.second)))
+        return nullptr;
+      method_slots.emplace_back(S.first, fn);
+    }
+  }
+  llvm::SmallVector<std::pair<int, void*>, 4> dtor_slots;
+  int primary_dtor_slot = -1;
+  if (on_destroy) {
+    for (const auto& D : G.DeletingDtors) {
+      void* thunk = vtableGroupThunk(G, -1, D.second);
+      if (!thunk)
+        return nullptr;
+      dtor_slots.emplace_back(D.first, thunk);
+      if (D.second == 0)
+        primary_dtor_slot = D.first;
+    }
+    if (primary_dtor_slot < 0)
+      return nullptr;
+  }
+
+  const std::size_t n_private = G.Overriders.size() + 1;
+  void** block =
+      new void*[n_extra_prefix_slots + 1 + G.NumComponents + n_private]();
+  std::memcpy(block + n_extra_prefix_slots + 1, orig_vptr - G.AddressPoint,
+              G.NumComponents * sizeof(void*));
+  void** vptr = block + n_extra_prefix_slots + 1 + G.AddressPoint;
+  for (std::size_t i = 0; i < n_overlays; ++i)
+    vptr[NumSlots + G.SlotOverrider[slots[i]]] = overlay_fns[i];
+  vptr[NumSlots + G.Overriders.size()] =
+      VTableOverlay::BitCastFn<void*>(&runVTableOverlayGroupDtorHook);
+  for (const auto& S : method_slots)
+    vptr[S.first] = S.second;
+
+  // The ctor publishes the primary vptr; the secondary ones follow. As in
+  // installVTableOverlay, the hook fields are set before the dtor thunks
+  // become reachable.
+  auto* ov = new VTableOverlay(block, orig_vptr, inst, n_extra_prefix_slots,
+                               G.AddressPoint, count, stride);
+  for (const auto& VP : llvm::drop_begin(G.VPtrs))
+    ov->secondary_vptrs.emplace_back(VP.first, orig_vptr + VP.second);
+  for (std::size_t i = 0; i < count; ++i)
+    for (const auto& VP : llvm::drop_begin(G.VPtrs))
+      VTableOverlay::WriteVPtr(static_cast<char*>(ov->element(i)) + VP.first,
+                               vptr + VP.second);
+  if (on_destroy) {
+    ov->orig_dtor = SlotToDtorFn(vptr[primary_dtor_slot]);
+    ov->cleanup = on_destroy;
+    ov->cleanup_data = cleanup_data;
+    for (const auto& D : dtor_slots)
+      vptr[D.first] = D.second;
   }
-  auto* ov = applyVTableOverlay(inst, total_method_slots, slots.data(),
-                                overlay_fns, n_overlays,
-                                n_extra_prefix_slots);
+  return ov;
+#endif
+}
+
+// Shared tail of the MakeVTableOverlay overloads and MakeVTableOverlayArray,
+// once the slots have been resolved.
+static VTableOverlay*
+installVTableOverlay(void* inst, int total_method_slots, const int* slots,
+                     void* const* overlay_fns, std::size_t n_overlays,
+                     std::size_t n_extra_prefix_slots,
+                     VTableOverlayDtorHook on_destroy, void* cleanup_data,
+                     std::size_t count = 1, std::size_t stride = 0) {
+  auto* ov =
+      applyVTableOverlay(inst, total_method_slots, slots, overlay_fns,
+                         n_overlays, n_extra_prefix_slots, count, stride);
   if (!ov)
-    return INTEROP_RETURN(nullptr);
+    return nullptr;
 
   // Optional dtor hook: capture the original D0 (already copied into
   // the block), wire the hook fields on the overlay, then publish the
@@ -3018,8 +3489,116 @@ MakeVTableOverlay(void* inst, ConstDeclRef base, const ConstFuncRef* methods,
     ov->cleanup_data = cleanup_data;
     vptr[kDeletingDtorSlot] = DtorFnToSlot(&VTableOverlayDtorHost::Wrapper);
   }
+  return ov;
+}
+
+// Reflection-driven body of MakeVTableOverlay and MakeVTableOverlayArray:
+// the class checks and slot resolution run once for all count objects.
+static VTableOverlay*
+makeVTableOverlay(void* inst, std::size_t count, std::size_t stride,
+                  ConstDeclRef base, const ConstFuncRef* methods,
+                  void* const* overlay_fns, std::size_t n_overlays,
+                  std::size_t n_extra_prefix_slots,
+                  VTableOverlayDtorHook on_destroy, void* cleanup_data) {
+  // Refuse layouts the single-primary-vptr overlay cannot fully express,
+  // so the caller cannot silently produce mis-dispatching objects.
+  if (!inst || !count)
+    return nullptr;
+  const auto* RD = llvm::dyn_cast_or_null<CXXRecordDecl>(unwrap<Decl>(base));
+  if (RD)
+    RD = RD->getDefinition();
+  if (!RD)
+    return nullptr;
+  const VTableLayoutInfo& Layout = cachedVTableLayoutInfo(RD);
+  if (!Layout.m_CanOverlay)
+    return nullptr;
+  if (count > 1) {
+    CharUnits Size = getASTContext().getASTRecordLayout(RD).getSize();
+    if (stride < static_cast<std::size_t>(Size.getQuantity()))
+      return nullptr;
+  }
+  int total_method_slots = Layout.m_NumSlots;
+
+  llvm::SmallVector<int, 8> slots;
+  slots.reserve(n_overlays);
+  if (Layout.m_MultipleVPtrs) {
+    // A method may fill slots in several vtables of the group; any one of
+    // them identifies its final overrider in RD.
+    InterpreterInfo::VTableGroup& G = cachedVTableGroup(RD);
+    for (std::size_t i = 0; i < n_overlays; ++i) {
+      const auto* MD =
+          llvm::dyn_cast_or_null<CXXMethodDecl>(unwrap<Decl>(methods[i]));
+      if (!MD || !MD->isVirtual() ||
+          !(MD->getParent() == RD || RD->isDerivedFrom(MD->getParent())))
+        return nullptr;
+      const CXXMethodDecl* Overrider = MD->getCorrespondingMethodInClass(RD);
+      if (!Overrider)
+        return nullptr;
+      auto It = G.OverriderIndex.find(Overrider->getCanonicalDecl());
+      if (It == G.OverriderIndex.end())
+        return nullptr;
+      slots.push_back(G.Overriders[It->second].Slots.front().first);
+    }
+    return installVTableGroupOverlay(inst, RD, slots.data(), overlay_fns,
+                                     n_overlays, n_extra_prefix_slots,
+                                     on_destroy, cleanup_data, count, stride);
+  }
+  for (std::size_t i = 0; i < n_overlays; ++i) {
+    int slot = virtualMethodSlot(methods[i]);
+    if (slot < 0)
+      return nullptr;
+    slots.push_back(slot);
+  }
+  return installVTableOverlay(inst, total_method_slots, slots.data(),
+                              overlay_fns, n_overlays, n_extra_prefix_slots,
+                              on_destroy, cleanup_data, count, stride);
+}
 
-  return INTEROP_RETURN(ov);
+VTableOverlay*
+MakeVTableOverlay(void* inst, ConstDeclRef base, const ConstFuncRef* methods,
+                  void* const* overlay_fns, std::size_t n_overlays,
+                  std::size_t n_extra_prefix_slots,
+                  VTableOverlayDtorHook on_destroy, void* cleanup_data) {
+  INTEROP_TRACE(inst, base, methods, overlay_fns, n_overlays,
+                n_extra_prefix_slots, on_destroy, cleanup_data);
+  return INTEROP_RETURN(makeVTableOverlay(
+      inst, /*count=*/1, /*stride=*/0, base, methods, overlay_fns, n_overlays,
+      n_extra_prefix_slots, on_destroy, cleanup_data));
+}
+
+VTableOverlay* MakeVTableOverlayArray(void* base_ptr, std::size_t stride,
+                                      std::size_t count, ConstDeclRef base,
+                                      const ConstFuncRef* methods,
+                                      void* const* overlay_fns,
+                                      std::size_t n_overlays,
+                                      std::size_t n_extra_prefix_slots) {
+  INTEROP_TRACE(base_ptr, stride, count, base, methods, overlay_fns,
+                n_overlays, n_extra_prefix_slots);
+  // Array elements are destroyed in place, never through the deleting
+  // destructor one by one, so there is no dtor hook to offer.
+  return INTEROP_RETURN(makeVTableOverlay(
+      base_ptr, count, stride, base, methods, overlay_fns, n_overlays,
+      n_extra_prefix_slots, /*on_destroy=*/nullptr, /*cleanup_data=*/nullptr));
+}
+
+VTableOverlay* MakeVTableOverlay(void* inst, const VTableLayoutInfo& layout,
+                                 const int* slots, void* const* overlay_fns,
+                                 std::size_t n_overlays,
+                                 std::size_t n_extra_prefix_slots,
+                                 VTableOverlayDtorHook on_destroy,
+                                 void* cleanup_data) {
+  INTEROP_TRACE(inst, layout, slots, overlay_fns, n_overlays,
+                n_extra_prefix_slots, on_destroy, cleanup_data);
+  if (!layout.m_CanOverlay)
+    return INTEROP_RETURN(nullptr);
+  if (layout.m_MultipleVPtrs)
+    return INTEROP_RETURN(installVTableGroupOverlay(
+        inst, llvm::cast<CXXRecordDecl>(unwrap<Decl>(layout.m_Class)), slots,
+        overlay_fns, n_overlays, n_extra_prefix_slots, on_destroy,
+        cleanup_data));
+  return INTEROP_RETURN(installVTableOverlay(
+      inst, layout.m_NumSlots, slots, overlay_fns, n_overlays,
+      n_extra_prefix_slots, on_destroy, cleanup_data));
 }
 
 void DestroyVTableOverlay(VTableOverlay* overlay) {
@@ -3028,76 +3607,565 @@ void DestroyVTableOverlay(VTableOverlay* overlay) {
   return INTEROP_VOID_RETURN();
 }
 
-void GetDatamembers(DeclRef DRef, std::vector<DeclRef>& datamembers) {
-  INTEROP_TRACE(DRef, INTEROP_OUT(datamembers));
-  auto* D = unwrap<Decl>(DRef);
+// Overlay vtable shared by every instance installed with the same original
+// vtable, slot count, slot replacements, extra-prefix size and dtor hook.
+// The block has the VTableOverlay layout, but its hidden slot points at this
+// object, and instances only carry the vptr: their own data, if any, lives
+// in the registry's side table.
+struct SharedVTableOverlay {
+  void** block; // owned
+  void** original_vptr;
+  std::size_t n_extra_prefix_slots;
+  llvm::FoldingSetNodeID key;
+  std::size_t refcount = 0; // number of instances using the block
+  VTableOverlayDtorSlotFn orig_dtor = nullptr;
+  VTableOverlayDtorHook cleanup = nullptr;
 
-  if (auto* CXXRD = llvm::dyn_cast_or_null<CXXRecordDecl>(D)) {
-    getSema().ForceDeclarationOfImplicitMembers(CXXRD);
-    if (CXXRD->hasDefinition())
-      CXXRD = CXXRD->getDefinition();
+  void** address_point() const {
+    return block + n_extra_prefix_slots + detail::kVTableOverlayPrefixSize;
+  }
+};
 
-    llvm::SmallVector<RecordDecl::decl_iterator, 2> stack_begin;
-    llvm::SmallVector<RecordDecl::decl_iterator, 2> stack_end;
-    stack_begin.push_back(CXXRD->decls_begin());
-    stack_end.push_back(CXXRD->decls_end());
-    while (!stack_begin.empty()) {
-      if (stack_begin.back() == stack_end.back()) {
-        stack_begin.pop_back();
-        stack_end.pop_back();
-        continue;
-      }
-      Decl* D = *(stack_begin.back());
-      if (auto* FD = llvm::dyn_cast<FieldDecl>(D)) {
-        if (FD->isAnonymousStructOrUnion()) {
-          if (const auto* RT = FD->getType()->getAs<RecordType>()) {
-            if (auto* CXXRD = llvm::dyn_cast<CXXRecordDecl>(RT->getDecl())) {
-              stack_begin.back()++;
-              stack_begin.push_back(CXXRD->decls_begin());
-              stack_end.push_back(CXXRD->decls_end());
-              continue;
-            }
-          }
-        }
-        datamembers.push_back(D);
+namespace {
+struct SharedVTableOverlayRegistry {
+  std::mutex Lock;
+  std::map<llvm::FoldingSetNodeID, SharedVTableOverlay*> Interned;
+  // Lets RemoveSharedVTableOverlay recognize the instances it owns.
+  llvm::DenseMap<void**, SharedVTableOverlay*> ByAddressPoint;
+  // The instance_data of every overlaid instance that was given one.
+  llvm::DenseMap<void*, void*> InstanceData;
+
+  // Takes inst's entry out of InstanceData; the caller holds Lock.
+  void* takeInstanceData(void* inst) {
+    auto It = InstanceData.find(inst);
+    if (It == InstanceData.end())
+      return nullptr;
+    void* data = It->second;
+    InstanceData.erase(It);
+    return data;
+  }
 
-      } else if (auto* USD = llvm::dyn_cast<UsingShadowDecl>(D)) {
-        if (llvm::isa<FieldDecl>(USD->getTargetDecl()))
-          datamembers.push_back(USD);
-      }
-      stack_begin.back()++;
-    }
+  // Drops one instance's reference; the caller holds Lock.
+  void release(SharedVTableOverlay* S) {
+    if (--S->refcount)
+      return;
+    Interned.erase(S->key);
+    ByAddressPoint.erase(S->address_point());
+    delete[] S->block;
+    delete S;
   }
-  return INTEROP_VOID_RETURN();
-}
+};
+} // namespace
 
-void GetStaticDatamembers(ConstDeclRef DRef,
-                          std::vector<DeclRef>& datamembers) {
-  INTEROP_TRACE(DRef, INTEROP_OUT(datamembers));
-  GetClassDecls<VarDecl>(DRef, datamembers);
-  return INTEROP_VOID_RETURN();
+static SharedVTableOverlayRegistry& getSharedVTableOverlays() {
+  // Leaked on purpose: overlaid objects may be destroyed during static
+  // destruction and their dtor hook still needs the registry.
+  static auto* Registry = new SharedVTableOverlayRegistry();
+  return *Registry;
 }
 
-void GetEnumConstantDatamembers(ConstDeclRef DRef,
-                                std::vector<DeclRef>& datamembers,
-                                bool include_enum_class) {
-  INTEROP_TRACE(DRef, INTEROP_OUT(datamembers), include_enum_class);
-  std::vector<DeclRef> EDs;
-  GetClassDecls<EnumDecl>(DRef, EDs);
-  for (DeclRef i : EDs) {
-    auto* ED = unwrap<EnumDecl>(i);
-
-    bool is_class_tagged = ED->isScopedUsingClassTag();
-    if (is_class_tagged && !include_enum_class)
-      continue;
-
-    std::copy(ED->enumerator_begin(), ED->enumerator_end(),
-              std::back_inserter(datamembers));
+// Dtor wrapper of shared overlays; see VTableOverlayDtorHost::Wrapper.
+// Runs the optional cleanup hook, then the original deleting destructor,
+// and only then releases the instance's reference so the block cannot go
+// away while the destructor still executes.
+#ifdef _WIN32
+void VTableOverlayDtorHost::SharedWrapper(int flags) {
+#else
+void VTableOverlayDtorHost::SharedWrapper() {
+#endif
+  void** vptr = VTableOverlay::ReadVPtr(this);
+  auto* S = *reinterpret_cast<SharedVTableOverlay**>(
+      vptr - detail::kVTableOverlayPrefixSize);
+  auto& Registry = getSharedVTableOverlays();
+  void* data;
+  {
+    std::lock_guard<std::mutex> Guard(Registry.Lock);
+    data = Registry.takeInstanceData(this);
   }
-  return INTEROP_VOID_RETURN();
-}
+  if (S->cleanup)
+    S->cleanup(this, data);
+#ifdef _WIN32
+  (this->*S->orig_dtor)(flags);
+#else
+  (this->*S->orig_dtor)();
+#endif
+  std::lock_guard<std::mutex> Guard(Registry.Lock);
+  Registry.release(S);
+}
+
+bool InstallSharedVTableOverlay(void* inst, const VTableLayoutInfo& layout,
+                                const int* slots, void* const* overlay_fns,
+                                std::size_t n_overlays,
+                                std::size_t n_extra_prefix_slots,
+                                VTableOverlayDtorHook on_destroy,
+                                void* instance_data) {
+  INTEROP_TRACE(inst, layout, slots, overlay_fns, n_overlays,
+                n_extra_prefix_slots, on_destroy, instance_data);
+  // Shared blocks cover the single-vptr layout only.
+  if (!inst || !layout.m_CanOverlay || layout.m_MultipleVPtrs)
+    return INTEROP_RETURN(false);
 
-DeclRef LookupDatamember(const std::string& name, ConstDeclRef parent) {
+  void** orig_vptr = VTableOverlay::ReadVPtr(inst);
+  llvm::FoldingSetNodeID ID;
+  ID.AddPointer(orig_vptr);
+  // The block holds m_NumSlots slots: a layout of a base class installed on
+  // an object of a derived class must not share a block with the layout of
+  // the derived class, which has more.
+  ID.AddInteger(layout.m_NumSlots);
+  ID.AddInteger(n_extra_prefix_slots);
+  ID.AddInteger(reinterpret_cast<uintptr_t>(on_destroy));
+  for (std::size_t i = 0; i < n_overlays; ++i) {
+    ID.AddInteger(slots[i]);
+    ID.AddPointer(overlay_fns[i]);
+  }
+
+  auto& Registry = getSharedVTableOverlays();
+  std::lock_guard<std::mutex> Guard(Registry.Lock);
+  // Overlays do not stack: orig_vptr must be the class's own vtable.
+  if (Registry.ByAddressPoint.count(orig_vptr))
+    return INTEROP_RETURN(false);
+  SharedVTableOverlay*& S = Registry.Interned[ID];
+  if (!S) {
+    void** block =
+        buildVTableOverlayBlock(orig_vptr, layout.m_NumSlots, slots,
+                                overlay_fns, n_overlays, n_extra_prefix_slots);
+    if (!block) {
+      Registry.Interned.erase(ID);
+      return INTEROP_RETURN(false);
+    }
+    S = new SharedVTableOverlay{block, orig_vptr, n_extra_prefix_slots, ID};
+    block[n_extra_prefix_slots] = S; // hidden slot
+    // The dtor wrapper is always installed: besides running on_destroy it
+    // drops the reference of instances deleted through operator delete.
+    void** vptr = S->address_point();
+    S->orig_dtor = SlotToDtorFn(vptr[kDeletingDtorSlot]);
+    S->cleanup = on_destroy;
+    vptr[kDeletingDtorSlot] =
+        DtorFnToSlot(&VTableOverlayDtorHost::SharedWrapper);
+    Registry.ByAddressPoint[S->address_point()] = S;
+  }
+  ++S->refcount;
+  if (instance_data)
+    Registry.InstanceData[inst] = instance_data;
+  VTableOverlay::WriteVPtr(inst, S->address_point());
+  return INTEROP_RETURN(true);
+}
+
+void RemoveSharedVTableOverlay(void* inst) {
+  INTEROP_TRACE(inst);
+  if (!inst)
+    return INTEROP_VOID_RETURN();
+  auto& Registry = getSharedVTableOverlays();
+  std::lock_guard<std::mutex> Guard(Registry.Lock);
+  auto It = Registry.ByAddressPoint.find(VTableOverlay::ReadVPtr(inst));
+  if (It == Registry.ByAddressPoint.end())
+    return INTEROP_VOID_RETURN();
+  SharedVTableOverlay* S = It->second;
+  VTableOverlay::WriteVPtr(inst, S->original_vptr);
+  Registry.InstanceData.erase(inst);
+  Registry.release(S);
+  return INTEROP_VOID_RETURN();
+}
+
+void* GetSharedVTableOverlayData(void* inst) {
+  INTEROP_TRACE(inst);
+  auto& Registry = getSharedVTableOverlays();
+  std::lock_guard<std::mutex> Guard(Registry.Lock);
+  auto It = Registry.InstanceData.find(inst);
+  if (It == Registry.InstanceData.end())
+    return INTEROP_RETURN(nullptr);
+  return INTEROP_RETURN(It->second);
+}
+
+// Return type followed by the parameter types of MD, spelled as in the JIT
+// wrappers; these are the R and Args... of its Cpp::Thunks::dispatch
+// instantiation. False for variadic methods, whose arguments dispatch cannot
+// forward.
+static bool dispatchTypes(const CXXMethodDecl* MD,
+                          llvm::SmallVectorImpl<std::string>& Types) {
+  if (MD->isVariadic())
+    return false;
+  ASTContext& C = MD->getASTContext();
+  PrintingPolicy Policy(C.getPrintingPolicy());
+  Types.emplace_back();
+  get_type_as_string(MD->getReturnType(), Types.back(), C, Policy);
+  for (const ParmVarDecl* P : MD->parameters()) {
+    Types.emplace_back();
+    get_type_as_string(P->getType(), Types.back(), C, Policy);
+  }
+  return true;
+}
+
+// The "R(A1, A2)" signature shape of dispatchTypes' result.
+static std::string dispatchShape(llvm::ArrayRef<std::string> Types) {
+  return Types.front() + "(" + llvm::join(Types.drop_front(), ", ") + ")";
+}
+
+static std::string dispatchKey(llvm::StringRef Traits, std::size_t Slot,
+                               llvm::StringRef Shape) {
+  return (Traits + "|" + llvm::Twine(Slot) + "|" + Shape).str();
+}
+
+static std::string dispatchInstantiation(llvm::StringRef Traits,
+                                         std::size_t Slot,
+                                         llvm::ArrayRef<std::string> Types) {
+  return ("Cpp::Thunks::dispatch<" + Traits + ", " + llvm::Twine(Slot) +
+          ", " + llvm::join(Types, ", ") + ">")
+      .str();
+}
+
+std::string EmitThunkCatalog(const std::vector<ConstDeclRef>& classes,
+                             const char* traits, const char* name) {
+  INTEROP_TRACE(classes, traits, name);
+  if (!traits || !name)
+    return INTEROP_RETURN(std::string());
+
+  std::string Entries;
+  llvm::raw_string_ostream OS(Entries);
+  std::set<std::string> Seen;
+  std::size_t N = 0;
+  for (ConstDeclRef Class : classes) {
+    const auto* RD = llvm::dyn_cast_or_null<CXXRecordDecl>(unwrap<Decl>(Class));
+    if (RD)
+      RD = RD->getDefinition();
+    if (!RD)
+      continue;
+    // Nothing below inserts into the layout cache, so the reference holds.
+    const VTableLayoutInfo& Layout = cachedVTableLayoutInfo(RD);
+    if (!Layout.m_CanOverlay)
+      continue;
+    // dispatch passes its `this` to From as the complete object, which only
+    // holds in the primary vtable: the slots of the secondary vtables of a
+    // group receive a base subobject and are left to the this-adjusting
+    // thunks of the vtable-group overlay.
+    int SlotEnd = Layout.m_NumSlots;
+    if (Layout.m_MultipleVPtrs) {
+      auto* VTC =
+          llvm::cast<ItaniumVTableContext>(getASTContext().getVTableContext());
+      const VTableLayout& L = VTC->getVTableLayout(RD);
+      SlotEnd = static_cast<int>(L.getVTableSize(0) -
+                                 L.getAddressPointIndices()[0]);
+    }
+    for (const VTableSlot& S : Layout.m_Slots) {
+      if (S.m_Slot >= SlotEnd)
+        break;
+      const auto* MD = unwrap<CXXMethodDecl>(S.m_Method);
+      llvm::SmallVector<std::string, 4> Types;
+      if (llvm::isa<CXXDestructorDecl>(MD) || !dispatchTypes(MD, Types))
+        continue;
+      std::string Shape = dispatchShape(Types);
+      if (!Seen.insert(dispatchKey(traits, S.m_Slot, Shape)).second)
+        continue;
+      OS << "    {\"";
+      llvm::printEscapedString(Shape, OS);
+      OS << "\", " << S.m_Slot << ",\n     reinterpret_cast<void*>(&"
+         << dispatchInstantiation(traits, S.m_Slot, Types) << ")},\n";
+      ++N;
+    }
+  }
+
+  std::string Source;
+  llvm::raw_string_ostream Out(Source);
+  Out << "// Thunk catalog for " << traits
+      << ", generated by Cpp::EmitThunkCatalog.\n"
+      << "// Compile it where " << traits
+      << " and the types of the listed signatures are declared.\n\n"
+      << "#include \"CppInterOp/CppInterOpThunks.h\"\n"
+      << "#include \"CppInterOp/CppInterOpTypes.h\"\n\n"
+      << "#include <cstddef>\n\n"
+      << "extern const Cpp::ThunkCatalogEntry " << name << "[] = {\n"
+      << Entries << "    {nullptr, 0, nullptr}};\n"
+      << "extern const std::size_t " << name << "_size = " << N << ";\n";
+  return INTEROP_RETURN(Source);
+}
+
+namespace {
+// Catalog entries registered by bindings. They are plain host functions,
+// so unlike JIT-compiled thunks they are shared by all interpreters.
+struct ThunkCatalogRegistry {
+  std::mutex Lock;
+  llvm::StringMap<void*> Thunks;
+};
+} // namespace
+
+static ThunkCatalogRegistry& getThunkCatalogs() {
+  static ThunkCatalogRegistry Registry;
+  return Registry;
+}
+
+void RegisterThunkCatalog(const char* traits, const ThunkCatalogEntry* entries,
+                          std::size_t n) {
+  INTEROP_TRACE(traits, entries, n);
+  if (!traits)
+    return INTEROP_VOID_RETURN();
+  auto& Registry = getThunkCatalogs();
+  std::lock_guard<std::mutex> Guard(Registry.Lock);
+  for (std::size_t i = 0; i < n; ++i)
+    if (entries[i].m_Shape && entries[i].m_Fn)
+      Registry.Thunks[dispatchKey(traits, entries[i].m_Slot,
+                                  entries[i].m_Shape)] = entries[i].m_Fn;
+  return INTEROP_VOID_RETURN();
+}
+
+void* GetDispatchThunk(const char* traits, ConstFuncRef method,
+                       std::size_t slot) {
+  INTEROP_TRACE(traits, method, slot);
+  const auto* MD = llvm::dyn_cast_or_null<CXXMethodDecl>(
+      UnwrapUsingShadowToFunction(unwrap<Decl>(method)));
+  llvm::SmallVector<std::string, 4> Types;
+  if (!traits || !MD || !MD->isVirtual() || !dispatchTypes(MD, Types))
+    return INTEROP_RETURN(nullptr);
+  std::string Key = dispatchKey(traits, slot, dispatchShape(Types));
+  {
+    auto& Registry = getThunkCatalogs();
+    std::lock_guard<std::mutex> Guard(Registry.Lock);
+    auto It = Registry.Thunks.find(Key);
+    if (It != Registry.Thunks.end())
+      return INTEROP_RETURN(It->second);
+  }
+  auto& Cache = getInterpInfo().DispatchThunks;
+  auto It = Cache.find(Key);
+  if (It != Cache.end())
+    return INTEROP_RETURN(It->second);
+
+  // The definition is guarded like the header, so it is skipped if the
+  // binding already included CppInterOpThunks.h into the interpreter. The
+  // getter hands back the address of the instantiation itself.
+#define CPPINTEROP_STRINGIFY_IMPL(...) #__VA_ARGS__
+#define CPPINTEROP_STRINGIFY(...) CPPINTEROP_STRINGIFY_IMPL(__VA_ARGS__)
+  static unsigned long long Serial = 0;
+  std::string Name = "__cppinterop_dispatch_thunk" + std::to_string(Serial++);
+  std::string Code = "#ifndef CPPINTEROP_CPPINTEROPTHUNKS_H\n"
+                     "#define CPPINTEROP_CPPINTEROPTHUNKS_H\n"
+                     "#include <cstddef>\n"
+                     "namespace Cpp { namespace Thunks {\n";
+  Code += CPPINTEROP_STRINGIFY(CPPINTEROP_THUNKS_DISPATCH_DEFINITION);
+  Code += "\n} }\n#endif\n";
+  Code += "__attribute__((used)) extern \"C\" void* " + Name + "() {\n" +
+          "  return reinterpret_cast<void*>(&" +
+          dispatchInstantiation(traits, slot, Types) + ");\n}\n";
+#undef CPPINTEROP_STRINGIFY
+#undef CPPINTEROP_STRINGIFY_IMPL
+  void* Getter = getInterp().compileFunction(Name, Code, /*ifUnique=*/false,
+                                             /*withAccessControl=*/false);
+  if (!Getter)
+    return INTEROP_RETURN(nullptr);
+  void* Addr = VTableOverlay::BitCastFn<void* (*)()>(Getter)();
+  Cache[Key] = Addr;
+  return INTEROP_RETURN(Addr);
+}
+
+// Trampolines compiled per MakeClosure pool; a pool of a shape is only
+// JIT-compiled once the previous pools of that shape are all in use.
+static constexpr unsigned kClosurePoolSize = 64;
+
+// JIT-compile a pool of trampolines for the function type FPT. Trampoline I
+// of the pool loads its handler and user data from Slots[2 * I] and
+// Slots[2 * I + 1], an index fixed when the trampoline is instantiated, and
+// passes its arguments and return storage on in the JitCall layout.
+static InterpreterInfo::ClosurePool*
+compileClosurePool(const FunctionProtoType* FPT, llvm::StringRef Shape) {
+  ASTContext& C = getASTContext();
+  PrintingPolicy Policy(C.getPrintingPolicy());
+  QualType Ret = FPT->getReturnType();
+
+  auto Slots = std::make_unique<void*[]>(2 * kClosurePoolSize);
+  static unsigned long long Serial = 0;
+  std::string NS = "__cppinterop_closure" + std::to_string(Serial++);
+  std::string Code;
+  llvm::raw_string_ostream OS(Code);
+  std::string Type;
+  OS << "namespace " << NS << " {\n";
+  get_type_as_string(Ret, Type, C, Policy);
+  OS << "using R = " << Type << ";\n";
+  std::string Params;
+  std::string Args;
+  for (unsigned i = 0, e = FPT->getNumParams(); i < e; ++i) {
+    Type.clear();
+    get_type_as_string(FPT->getParamType(i), Type, C, Policy);
+    OS << "using A" << i << " = " << Type << ";\n";
+    std::string I = std::to_string(i);
+    Params += (i ? ", A" : "A") + I + " a" + I;
+    Args += (i ? ", " : "") + ("(void*)__builtin_addressof(a" + I + ")");
+  }
+  OS << "using H = void (*)(void*, __SIZE_TYPE__, void**, void*);\n"
+     << "template <unsigned I> R trampoline(" << Params << ") {\n"
+     << "  void** s = reinterpret_cast<void**>((__UINTPTR_TYPE__)"
+     << reinterpret_cast<uintptr_t>(Slots.get()) << "ULL) + 2 * I;\n";
+  if (FPT->getNumParams())
+    OS << "  void* args[] = {" << Args << "};\n";
+  else
+    OS << "  void** args = nullptr;\n";
+  OS << "  H h = reinterpret_cast<H>(s[0]);\n";
+  if (Ret->isVoidType()) {
+    OS << "  h(s[1], " << FPT->getNumParams() << ", args, nullptr);\n";
+  } else if (Ret->isReferenceType()) {
+    Type.clear();
+    get_type_as_string(C.getPointerType(Ret.getNonReferenceType()), Type, C,
+                       Policy);
+    OS << "  void* r = nullptr;\n"
+       << "  h(s[1], " << FPT->getNumParams() << ", args, &r);\n"
+       << "  return static_cast<R>(*static_cast<" << Type << ">(r));\n";
+  } else {
+    // The handler constructs the result in raw storage, which is destroyed
+    // once it has been moved into the return value.
+    OS << "  alignas(R) unsigned char r[sizeof(R)];\n"
+       << "  h(s[1], " << FPT->getNumParams() << ", args, r);\n"
+       << "  struct D { R* p; ~D() { p->~R(); } } d{reinterpret_cast<R*>(r)};\n"
+       << "  return static_cast<R&&>(*d.p);\n";
+  }
+  OS << "}\n} // namespace " << NS << "\n";
+  std::string Getter = NS + "_get";
+  OS << "__attribute__((used)) extern \"C\" void " << Getter
+     << "(void** out) {\n";
+  for (unsigned i = 0; i < kClosurePoolSize; ++i)
+    OS << "  out[" << i << "] = (void*)&" << NS << "::trampoline<" << i
+       << ">;\n";
+  OS << "}\n";
+
+  void* Fn = getInterp().compileFunction(Getter, Code, /*ifUnique=*/false,
+                                         /*withAccessControl=*/false);
+  if (!Fn)
+    return nullptr;
+  auto& II = getInterpInfo();
+  InterpreterInfo::ClosurePool& Pool = II.ClosurePools.emplace_back();
+  Pool.Shape = Shape.str();
+  Pool.Slots = std::move(Slots);
+  Pool.Trampolines.resize(kClosurePoolSize);
+  VTableOverlay::BitCastFn<void (*)(void**)>(Fn)(Pool.Trampolines.data());
+  auto& Free = II.FreeClosures[Shape];
+  for (unsigned i = kClosurePoolSize; i-- > 0;)
+    Free.emplace_back(&Pool, i);
+  return &Pool;
+}
+
+void* MakeClosure(ConstTypeRef signature, ClosureHandler handler,
+                  void* user_data) {
+  INTEROP_TRACE(signature, handler, user_data);
+  QualType QT = QualType::getFromOpaquePtr(signature.data);
+  if (QT.isNull() || !handler)
+    return INTEROP_RETURN(nullptr);
+#ifndef CPPINTEROP_USE_CLING
+  // The trampolines read their slots, and call the handler, at addresses of
+  // this process.
+  if (getInterp().isOutOfProcess())
+    return INTEROP_RETURN(nullptr);
+#endif
+  if (const auto* PT = QT->getAs<clang::PointerType>())
+    QT = PT->getPointeeType();
+  const auto* FPT = QT->getAs<FunctionProtoType>();
+  if (!FPT || FPT->isVariadic())
+    return INTEROP_RETURN(nullptr);
+
+  ASTContext& C = getASTContext();
+  PrintingPolicy Policy(C.getPrintingPolicy());
+  llvm::SmallVector<std::string, 4> Types;
+  Types.emplace_back();
+  get_type_as_string(FPT->getReturnType(), Types.back(), C, Policy);
+  for (QualType P : FPT->getParamTypes()) {
+    Types.emplace_back();
+    get_type_as_string(P, Types.back(), C, Policy);
+  }
+  std::string Shape = dispatchShape(Types);
+
+  auto& II = getInterpInfo();
+  auto& Free = II.FreeClosures[Shape];
+  if (Free.empty() && !compileClosurePool(FPT, Shape))
+    return INTEROP_RETURN(nullptr);
+  auto [Pool, Index] = Free.back();
+  Free.pop_back();
+  Pool->Slots[2 * Index] = reinterpret_cast<void*>(handler);
+  Pool->Slots[2 * Index + 1] = user_data;
+  void* Closure = Pool->Trampolines[Index];
+  II.LiveClosures[Closure] = {Pool, Index};
+  return INTEROP_RETURN(Closure);
+}
+
+void FreeClosure(void* closure) {
+  INTEROP_TRACE(closure);
+  auto& II = getInterpInfo();
+  auto It = II.LiveClosures.find(closure);
+  if (It == II.LiveClosures.end())
+    return INTEROP_VOID_RETURN();
+  auto [Pool, Index] = It->second;
+  II.LiveClosures.erase(It);
+  Pool->Slots[2 * Index] = nullptr;
+  Pool->Slots[2 * Index + 1] = nullptr;
+  if (!Pool->Retired)
+    II.FreeClosures[Pool->Shape].emplace_back(Pool, Index);
+  return INTEROP_VOID_RETURN();
+}
+
+void GetDatamembers(DeclRef DRef, std::vector<DeclRef>& datamembers) {
+  INTEROP_TRACE(DRef, INTEROP_OUT(datamembers));
+  auto* D = unwrap<Decl>(DRef);
+
+  if (auto* CXXRD = llvm::dyn_cast_or_null<CXXRecordDecl>(D)) {
+    getSema().ForceDeclarationOfImplicitMembers(CXXRD);
+    if (CXXRD->hasDefinition())
+      CXXRD = CXXRD->getDefinition();
+
+    llvm::SmallVector<RecordDecl::decl_iterator, 2> stack_begin;
+    llvm::SmallVector<RecordDecl::decl_iterator, 2> stack_end;
+    stack_begin.push_back(CXXRD->decls_begin());
+    stack_end.push_back(CXXRD->decls_end());
+    while (!stack_begin.empty()) {
+      if (stack_begin.back() == stack_end.back()) {
+        stack_begin.pop_back();
+        stack_end.pop_back();
+        continue;
+      }
+      Decl* D = *(stack_begin.back());
+      if (auto* FD = llvm::dyn_cast<FieldDecl>(D)) {
+        if (FD->isAnonymousStructOrUnion()) {
+          if (const auto* RT = FD->getType()->getAs<RecordType>()) {
+            if (auto* CXXRD = llvm::dyn_cast<CXXRecordDecl>(RT->getDecl())) {
+              stack_begin.back()++;
+              stack_begin.push_back(CXXRD->decls_begin());
+              stack_end.push_back(CXXRD->decls_end());
+              continue;
+            }
+          }
+        }
+        datamembers.push_back(D);
+
+      } else if (auto* USD = llvm::dyn_cast<UsingShadowDecl>(D)) {
+        if (llvm::isa<FieldDecl>(USD->getTargetDecl()))
+          datamembers.push_back(USD);
+      }
+      stack_begin.back()++;
+    }
+  }
+  return INTEROP_VOID_RETURN();
+}
+
+void GetStaticDatamembers(ConstDeclRef DRef,
+                          std::vector<DeclRef>& datamembers) {
+  INTEROP_TRACE(DRef, INTEROP_OUT(datamembers));
+  GetClassDecls<VarDecl>(DRef, datamembers);
+  return INTEROP_VOID_RETURN();
+}
+
+void GetEnumConstantDatamembers(ConstDeclRef DRef,
+                                std::vector<DeclRef>& datamembers,
+                                bool include_enum_class) {
+  INTEROP_TRACE(DRef, INTEROP_OUT(datamembers), include_enum_class);
+  std::vector<DeclRef> EDs;
+  GetClassDecls<EnumDecl>(DRef, EDs);
+  for (DeclRef i : EDs) {
+    auto* ED = unwrap<EnumDecl>(i);
+
+    bool is_class_tagged = ED->isScopedUsingClassTag();
+    if (is_class_tagged && !include_enum_class)
+      continue;
+
+    std::copy(ED->enumerator_begin(), ED->enumerator_end(),
+              std::back_inserter(datamembers));
+  }
+  return INTEROP_VOID_RETURN();
+}
+
+DeclRef LookupDatamember(const std::string& name, ConstDeclRef parent) {
   INTEROP_TRACE(name, parent);
   const clang::DeclContext* Within = nullptr;
   if (parent) {
@@ -3157,11 +4225,8 @@ TypeRef GetVariableType(ConstDeclRef var) {
   return INTEROP_RETURN(nullptr);
 }
 
-intptr_t GetVariableOffset(compat::Interpreter& I, Decl* D,
-                           CXXRecordDecl* BaseCXXRD) {
-  if (!D)
-    return 0;
-
+static intptr_t computeVariableOffset(compat::Interpreter& I, Decl* D,
+                                      CXXRecordDecl* BaseCXXRD) {
   auto& C = I.getSema().getASTContext();
 
   if (auto* FD = llvm::dyn_cast<FieldDecl>(D)) {
@@ -3278,6 +4343,59 @@ intptr_t GetVariableOffset(compat::Interpreter& I, Decl* D,
   return 0;
 }
 
+// Called when Undo or UnloadLibrary may free the decls and types which the
+// caches of II are keyed on, or the JIT-compiled code and the globals whose
+// addresses they hold. A decl created later can reuse the address of a freed
+// one, so nothing of what was cached is kept: both operations are rare.
+// State that outlives the call -- live closures, the ObjectOps of Boxes, and
+// handed-out type ids -- is retired instead of freed.
+static void forgetUnloadedCode(InterpreterInfo& II) {
+  II.WrapperStore.clear();
+  II.DtorWrapperStore.clear();
+  II.VariableOffsets.clear();
+  II.TemplateInstantiations.clear();
+  II.VTableLayouts.clear();
+  II.VTableGroups.clear();
+  II.DispatchThunks.clear();
+  II.ObjPrinters.clear();
+  II.ObjPrintersByName.clear();
+  II.ContiguousViewExtractors.clear();
+  II.EvalObjectOps.clear();
+
+  II.TypeIds.clear();
+  for (size_t id = 1; id < II.TypeIdTable.size(); ++id) {
+    II.TypeIdTable[id] = InterpreterInfo::TypeIdEntry();
+    II.TypeIdTable[id].IsFinal = true;
+  }
+
+  for (InterpreterInfo::ClosurePool& Pool : II.ClosurePools)
+    Pool.Retired = true;
+  II.FreeClosures.clear();
+}
+
+intptr_t GetVariableOffset(compat::Interpreter& I, Decl* D,
+                           CXXRecordDecl* BaseCXXRD) {
+  if (!D)
+    return 0;
+
+  // The offset of a field depends on the record it is accessed through;
+  // the address of a static data member does not.
+  const Decl* Through = nullptr;
+  if (BaseCXXRD && llvm::isa<FieldDecl>(D))
+    Through = BaseCXXRD->getCanonicalDecl();
+  auto& Cache = getInterpInfo(&I).VariableOffsets;
+  auto It = Cache.find({D, Through});
+  if (It != Cache.end())
+    return It->second;
+
+  intptr_t Offset = computeVariableOffset(I, D, BaseCXXRD);
+  // A null address means the symbol could not be resolved (yet), so it is
+  // looked up again next time.
+  if (Offset || llvm::isa<FieldDecl>(D))
+    Cache[{D, Through}] = Offset;
+  return Offset;
+}
+
 intptr_t GetVariableOffset(ConstDeclRef var, ConstDeclRef parent) {
   INTEROP_TRACE(var, parent);
   // The internal overload may trigger JIT materialization — logically const.
@@ -3287,6 +4405,74 @@ intptr_t GetVariableOffset(ConstDeclRef var, ConstDeclRef parent) {
   return INTEROP_RETURN(GetVariableOffset(getInterp(), D, RD));
 }
 
+// Appends the instance fields of RD, laid out at BaseOffset within the most
+// derived object, after those of its non-virtual bases. Members of anonymous
+// structs and unions are flattened into their enclosing record. Virtual
+// bases are laid out by the caller, which knows the most derived class.
+static void collectFieldLayout(const ASTContext& C, const RecordDecl* RD,
+                               intptr_t BaseOffset,
+                               std::vector<FieldLayoutEntry>& fields) {
+  const ASTRecordLayout& Layout = C.getASTRecordLayout(RD);
+  if (const auto* CXXRD = llvm::dyn_cast<CXXRecordDecl>(RD)) {
+    for (const CXXBaseSpecifier& Base : CXXRD->bases()) {
+      if (Base.isVirtual())
+        continue;
+      const CXXRecordDecl* BaseRD = Base.getType()->getAsCXXRecordDecl();
+      collectFieldLayout(
+          C, BaseRD,
+          BaseOffset + Layout.getBaseClassOffset(BaseRD).getQuantity(),
+          fields);
+    }
+  }
+  for (FieldDecl* FD : RD->fields()) {
+    if (FD->isUnnamedBitField())
+      continue;
+    intptr_t Offset =
+        BaseOffset +
+        C.toCharUnitsFromBits(Layout.getFieldOffset(FD->getFieldIndex()))
+            .getQuantity();
+    if (FD->isAnonymousStructOrUnion()) {
+      if (const auto* RT = FD->getType()->getAs<RecordType>()) {
+        collectFieldLayout(C, RT->getDecl()->getDefinition(), Offset, fields);
+        continue;
+      }
+    }
+    FieldLayoutEntry Entry;
+    Entry.m_Field = FD;
+    Entry.m_Offset = Offset;
+    fields.push_back(Entry);
+  }
+}
+
+void GetFieldLayout(ConstDeclRef DRef, std::vector<FieldLayoutEntry>& fields) {
+  INTEROP_TRACE(DRef, INTEROP_OUT(fields));
+  const auto* RD = llvm::dyn_cast_or_null<CXXRecordDecl>(unwrap<Decl>(DRef));
+  if (!RD || !IsComplete(DRef))
+    return INTEROP_VOID_RETURN();
+  RD = RD->getDefinition();
+  if (RD->isInvalidDecl() || RD->isDependentType())
+    return INTEROP_VOID_RETURN();
+
+  ASTContext& C = getASTContext();
+  size_t First = fields.size();
+  collectFieldLayout(C, RD, 0, fields);
+  const ASTRecordLayout& Layout = C.getASTRecordLayout(RD);
+  for (const CXXBaseSpecifier& VBase : RD->vbases()) {
+    const CXXRecordDecl* VBaseRD = VBase.getType()->getAsCXXRecordDecl();
+    collectFieldLayout(C, VBaseRD,
+                       Layout.getVBaseClassOffset(VBaseRD).getQuantity(),
+                       fields);
+  }
+
+  // Seed the GetVariableOffset cache so attribute access through RD is a
+  // lookup from now on.
+  auto& Cache = getInterpInfo().VariableOffsets;
+  const Decl* Through = RD->getCanonicalDecl();
+  for (size_t i = First, e = fields.size(); i < e; ++i)
+    Cache[{unwrap<Decl>(fields[i].m_Field), Through}] = fields[i].m_Offset;
+  return INTEROP_VOID_RETURN();
+}
+
 // Check if the Access Specifier of the variable matches the provided value.
 bool CheckVariableAccess(ConstDeclRef var, AccessSpecifier AS) {
   const auto* D = unwrap<Decl>(var);
@@ -3377,6 +4563,99 @@ bool IsSameType(ConstTypeRef type_a, ConstTypeRef type_b) {
   return INTEROP_RETURN(getASTContext().hasSameType(QT1, QT2));
 }
 
+static Cpp::Box::Kind classifyByQualType(clang::QualType QT);
+
+// Box::Kind recorded in the type id table. Unlike classifyByQualType this
+// accepts any canonical type: builtins outside the Box X-macro set (and
+// `void`) get their own tags instead of tripping the unreachable.
+static Box::Kind getTypeIdBuiltinKind(QualType QT) {
+  if (QT->isVoidType())
+    return Box::K_Void;
+  const auto* BT = QT->getAs<BuiltinType>();
+  if (!BT)
+    return Box::K_PtrOrObj;
+  switch (BT->getKind()) {
+  case BuiltinType::Bool:
+  case BuiltinType::Char_S:
+  case BuiltinType::Char_U:
+  case BuiltinType::SChar:
+  case BuiltinType::UChar:
+  case BuiltinType::Short:
+  case BuiltinType::UShort:
+  case BuiltinType::Int:
+  case BuiltinType::UInt:
+  case BuiltinType::Long:
+  case BuiltinType::ULong:
+  case BuiltinType::LongLong:
+  case BuiltinType::ULongLong:
+  case BuiltinType::Float:
+  case BuiltinType::Double:
+  case BuiltinType::LongDouble:
+    return classifyByQualType(QT);
+  default:
+    return Box::K_Unspecified;
+  }
+}
+
+// Fills the cached properties of the canonical type QT.
+// \returns false if QT is (still) incomplete and the size and alignment
+// could not be computed.
+static bool computeTypeIdInfo(QualType QT, TypeIdInfo& Info) {
+  ASTContext& C = getASTContext();
+  Info.m_BuiltinKind = getTypeIdBuiltinKind(QT);
+  Info.m_PointerDepth = 0;
+  QualType Pointee = QT;
+  while (const auto* PT = Pointee->getAs<PointerType>()) {
+    ++Info.m_PointerDepth;
+    Pointee = PT->getPointeeType();
+  }
+  if (QT->isDependentType() || QT->isFunctionType() ||
+      !getSema().isCompleteType(SourceLocation(), QT))
+    return false;
+  Info.m_Size = C.getTypeSizeInChars(QT).getQuantity();
+  Info.m_Align = C.getTypeAlignInChars(QT).getQuantity();
+  Info.m_IsPOD = QT.isPODType(C);
+  return true;
+}
+
+size_t GetTypeId(ConstTypeRef type) {
+  INTEROP_TRACE(type);
+  if (!type)
+    return INTEROP_RETURN(0);
+  QualType QT = QualType::getFromOpaquePtr(type.data).getCanonicalType();
+  InterpreterInfo& II = getInterpInfo();
+  if (II.TypeIdTable.empty())
+    II.TypeIdTable.emplace_back(); // id 0: the null type.
+  auto [It, Inserted] =
+      II.TypeIds.try_emplace(QT.getAsOpaquePtr(), II.TypeIdTable.size());
+  if (Inserted) {
+    InterpreterInfo::TypeIdEntry Entry;
+    Entry.Type = QT;
+    Entry.IsFinal = computeTypeIdInfo(QT, Entry.Info);
+    II.TypeIdTable.push_back(Entry);
+  }
+  return INTEROP_RETURN(It->second);
+}
+
+TypeRef GetTypeFromId(size_t id) {
+  INTEROP_TRACE(id);
+  InterpreterInfo& II = getInterpInfo();
+  if (id == 0 || id >= II.TypeIdTable.size())
+    return INTEROP_RETURN(nullptr);
+  return INTEROP_RETURN(II.TypeIdTable[id].Type.getAsOpaquePtr());
+}
+
+TypeIdInfo GetTypeIdInfo(size_t id) {
+  INTEROP_TRACE(id);
+  InterpreterInfo& II = getInterpInfo();
+  if (id == 0 || id >= II.TypeIdTable.size())
+    return INTEROP_RETURN(TypeIdInfo{});
+  InterpreterInfo::TypeIdEntry& Entry = II.TypeIdTable[id];
+  if (!Entry.IsFinal)
+    Entry.IsFinal = computeTypeIdInfo(Entry.Type, Entry.Info);
+  return INTEROP_RETURN(Entry.Info);
+}
+
 bool IsPointerType(ConstTypeRef TyRef) {
   INTEROP_TRACE(TyRef);
   QualType QT = QualType::getFromOpaquePtr(TyRef.data);
@@ -5548,6 +6827,19 @@ static Cpp::Box::Kind classifyByQualType(clang::QualType QT) {
   return Cpp::Box::K_PtrOrObj;
 }
 
+// Whether a K_PtrOrObj result of type QT is a class object Box can hold in
+// its inline buffer: the copy there must stand in for the object, so it has
+// to be trivially copyable and need no destructor.
+static bool fitsBoxInline(clang::QualType QT) {
+  const auto* RD = QT->getAsCXXRecordDecl();
+  if (!RD || !RD->hasDefinition() || !RD->isTriviallyCopyable() ||
+      !RD->hasTrivialDestructor())
+    return false;
+  ASTContext& C = getASTContext();
+  return C.getTypeSizeInChars(QT).getQuantity() <= Cpp::Box::kInlineSize &&
+         C.getTypeAlignInChars(QT).getQuantity() <= alignof(long double);
+}
+
 Box Evaluate(const char* code) {
   INTEROP_TRACE(code);
   compat::Value V;
@@ -5566,7 +6858,14 @@ Box Evaluate(const char* code) {
     CPP_BOX_BUILTIN_TYPES
 #undef X
   case Cpp::Box::K_PtrOrObj:
+    if (fitsBoxInline(QT))
+      return INTEROP_RETURN(Cpp::Box::CreateInline(
+          V.getPtr(),
+          static_cast<unsigned>(
+              getASTContext().getTypeSizeInChars(QT).getQuantity()),
+          qt));
     return INTEROP_RETURN(compat::MakeValueBox(V, qt));
+  case Cpp::Box::K_InlineObj:
   case Cpp::Box::K_Char_U:
   case Cpp::Box::K_Void:
   case Cpp::Box::K_Unspecified:
@@ -5577,6 +6876,299 @@ Box Evaluate(const char* code) {
   llvm_unreachable("classifyByQualType returned an unhandled Kind");
 }
 
+// Whether EvaluateInto can materialize a value of canonical type V itself;
+// everything else goes through Evaluate.
+static bool evaluatesDirectly(clang::QualType V) {
+  if (V->isVoidType() || V->isAnyPointerType() || V->isNullPtrType())
+    return true;
+  if (const auto* ET = V->getAs<clang::EnumType>())
+    V = ET->getDecl()->getIntegerType();
+  if (V.isNull())
+    return false;
+  if (V->isBuiltinType())
+    return getTypeIdBuiltinKind(V) != Cpp::Box::K_Unspecified;
+  const auto* RD = V->getAsCXXRecordDecl();
+  return RD && RD->hasDefinition();
+}
+
+// Whether caller-provided storage can hold an object of type V.
+static bool fitsStorage(ASTContext& C, QualType V, void* storage,
+                        size_t size) {
+  auto Size = static_cast<size_t>(C.getTypeSizeInChars(V).getQuantity());
+  auto Align = static_cast<uintptr_t>(C.getTypeAlignInChars(V).getQuantity());
+  return Size <= size && reinterpret_cast<uintptr_t>(storage) % Align == 0;
+}
+
+Box EvaluateInto(const char* expr, void* storage, size_t storage_size) {
+  INTEROP_TRACE(expr, storage, storage_size);
+  if (!expr)
+    return INTEROP_RETURN(Box{});
+  // A single unit aliases the type of the expression and defines the
+  // function evaluating it, bool(void* out, int mode). The mode, chosen
+  // below once the type is known, says what to write to out; the function
+  // returns false, without evaluating the expression, if the type does not
+  // support that mode.
+  enum { kScalar, kPointer, kInline, kInPlace, kHeld, kVoid } Mode;
+  static unsigned long long Serial = 0;
+  std::string Name = "__cppinterop_eval" + std::to_string(Serial++);
+  std::string Fn = Name + "_fn";
+  std::string E = std::string("(") + expr + ")";
+  std::string Code =
+      "#ifndef __CPPINTEROP_EVAL_HOLDER\n"
+      "#define __CPPINTEROP_EVAL_HOLDER\n"
+      "#include <new>\n"
+      "#include <type_traits>\n"
+      "namespace __cppinterop_eval {\n"
+      "// obj comes first, so a pointer to it is a pointer to the holder.\n"
+      "template <class T> struct Holder { T obj; unsigned rc; };\n"
+      "template <class T> void retain(void* p) noexcept {\n"
+      "  __atomic_fetch_add(&static_cast<Holder<T>*>(p)->rc, 1u,\n"
+      "                     __ATOMIC_RELAXED);\n"
+      "}\n"
+      "template <class T> void release(void* p) noexcept {\n"
+      "  auto* h = static_cast<Holder<T>*>(p);\n"
+      "  if (__atomic_fetch_sub(&h->rc, 1u, __ATOMIC_ACQ_REL) == 1)\n"
+      "    delete h;\n"
+      "}\n"
+      "// Class objects: a prvalue f() initializes the object directly.\n"
+      "template <class V, class F>\n"
+      "auto object(F f, void* out, int mode, int)\n"
+      "    -> decltype(::new (out) V(f()), bool()) {\n"
+      "  if (mode == " +
+      std::to_string(kInline) +
+      ") {\n"
+      "    if constexpr (std::is_trivially_copyable<V>::value) {\n"
+      "      V v = f();\n"
+      "      __builtin_memcpy(out, &v, sizeof(v));\n"
+      "      return true;\n"
+      "    }\n"
+      "    return false;\n"
+      "  }\n"
+      "  if (mode == " +
+      std::to_string(kInPlace) +
+      ") {\n"
+      "    ::new (out) V(f());\n"
+      "    return true;\n"
+      "  }\n"
+      "  // out receives {object, retain, release}.\n"
+      "  void** o = static_cast<void**>(out);\n"
+      "  o[0] = &(new Holder<V>{f(), 1u})->obj;\n"
+      "  o[1] = (void*)&retain<V>;\n"
+      "  o[2] = (void*)&release<V>;\n"
+      "  return true;\n"
+      "}\n"
+      "template <class V, class F> bool object(F, void*, int, long) {\n"
+      "  return false;\n"
+      "}\n"
+      "template <class V, class F> bool write(F f, void* out, int mode) {\n"
+      "  if constexpr (std::is_void<V>::value) {\n"
+      "    f();\n"
+      "    return true;\n"
+      "  } else if constexpr (std::is_pointer<V>::value ||\n"
+      "                       std::is_null_pointer<V>::value) {\n"
+      "    *static_cast<void**>(out) = (void*)f();\n"
+      "    return true;\n"
+      "  } else if constexpr (std::is_arithmetic<V>::value ||\n"
+      "                       std::is_enum<V>::value) {\n"
+      "    *static_cast<V*>(out) = f();\n"
+      "    return true;\n"
+      "  } else if constexpr (std::is_class<V>::value) {\n"
+      "    return object<V>(f, out, mode, 0);\n"
+      "  } else {\n"
+      "    return false;\n"
+      "  }\n"
+      "}\n"
+      "}\n"
+      "#endif\n"
+      "namespace " +
+      Name + " { using V = __remove_cvref(decltype(" + E + ")); }\n" +
+      "__attribute__((used)) extern \"C\" bool " + Fn +
+      "(void* out, int mode) {\n"
+      "  return __cppinterop_eval::write<" +
+      Name + "::V>([]() -> decltype(auto) { return " + E +
+      "; }, out, mode);\n"
+      "}\n";
+  auto& I = getInterp();
+  void* Addr = I.compileFunction(Fn, Code, /*ifUnique=*/false,
+                                 /*withAccessControl=*/true);
+  if (!Addr)
+    return INTEROP_RETURN(Box{});
+  const auto* TD = llvm::dyn_cast_or_null<TypedefNameDecl>(
+      unwrap<Decl>(GetNamed("V", GetNamed(Name))));
+  if (!TD)
+    return INTEROP_RETURN(Box{});
+  ASTContext& C = getASTContext();
+  QualType QT = TD->getUnderlyingType();
+  QualType V = QT.getCanonicalType();
+  void* qt = QT.getAsOpaquePtr();
+  // The expression has not run yet, so handing it to Evaluate runs it once.
+  if (!evaluatesDirectly(V))
+    return INTEROP_RETURN(Evaluate(expr));
+
+  if (V->isVoidType())
+    Mode = kVoid;
+  else if (V->isAnyPointerType() || V->isNullPtrType())
+    Mode = kPointer;
+  else if (!V->isRecordType())
+    Mode = kScalar;
+  else if (fitsBoxInline(V))
+    Mode = kInline;
+  else if (storage && fitsStorage(C, V, storage, storage_size))
+    Mode = kInPlace;
+  else
+    Mode = kHeld;
+  auto* Eval = VTableOverlay::BitCastFn<bool (*)(void*, int)>(Addr);
+
+  switch (Mode) {
+  case kVoid:
+    Eval(nullptr, Mode);
+    return INTEROP_RETURN(Box{});
+  case kPointer: {
+    // Non-owning: the pointee is not the Box's to release.
+    void* P = nullptr;
+    Eval(&P, Mode);
+    return INTEROP_RETURN(Box::AdoptObject(P, nullptr, qt));
+  }
+  case kScalar: {
+    QualType S = V;
+    if (const auto* ET = V->getAs<clang::EnumType>())
+      S = ET->getDecl()->getIntegerType();
+    switch (classifyByQualType(S)) {
+#define X(type, name)                                                          \
+  case Cpp::Box::K_##name: {                                                   \
+    type R{};                                                                  \
+    Eval(&R, Mode);                                                            \
+    return INTEROP_RETURN(Cpp::Box::Create<type>(R, qt));                      \
+  }
+      CPP_BOX_BUILTIN_TYPES
+#undef X
+    default:
+      llvm_unreachable("evaluatesDirectly admits only Box fundamentals");
+    }
+  }
+  case kInline: {
+    bool Written = false;
+    Box B = Box::ConstructInline(
+        [&](void* dst) { Written = Eval(dst, Mode); }, qt);
+    return INTEROP_RETURN(Written ? B : Evaluate(expr));
+  }
+  case kInPlace:
+    // The caller owns the object and destroys it, e.g. with Destruct.
+    if (!Eval(storage, Mode))
+      return INTEROP_RETURN(Evaluate(expr));
+    return INTEROP_RETURN(Box::AdoptObject(storage, nullptr, qt));
+  case kHeld: {
+    void* Out[3] = {};
+    if (!Eval(Out, Mode))
+      return INTEROP_RETURN(Evaluate(expr));
+    auto& II = getInterpInfo();
+    Box::ObjectOps*& Ops = II.EvalObjectOps[V.getAsOpaquePtr()];
+    if (!Ops) {
+      Ops = &II.EvalObjectOpsStorage.emplace_back();
+      Ops->retain = VTableOverlay::BitCastFn<void (*)(void*) noexcept>(Out[1]);
+      Ops->release =
+          VTableOverlay::BitCastFn<void (*)(void*) noexcept>(Out[2]);
+    }
+    return INTEROP_RETURN(Box::AdoptObject(Out[0], Ops, qt));
+  }
+  }
+  llvm_unreachable("unhandled EvaluateInto mode");
+}
+
+// Box kind of a BoxColumn element of canonical type V: a fundamental Box
+// carries, with enums counting as their underlying integer type.
+static Box::Kind columnKind(QualType V) {
+  if (const auto* ET = V->getAs<clang::EnumType>())
+    V = ET->getDecl()->getIntegerType();
+  if (V.isNull() || !V->isBuiltinType())
+    return Box::K_Unspecified;
+  Box::Kind K = getTypeIdBuiltinKind(V);
+  return K == Box::K_Void ? Box::K_Unspecified : K;
+}
+
+// Compile Code, which must alias the element type as Name_t and define
+// extern "C" void Name_fn(const void* in, void* out, size_t n), then run the
+// function to fill a column of n elements.
+static BoxColumn runBatch(const std::string& Name, const std::string& Code,
+                          const void* In, size_t N) {
+  BoxColumn Col;
+  void* Addr = getInterp().compileFunction(Name + "_fn", Code,
+                                           /*ifUnique=*/false,
+                                           /*withAccessControl=*/true);
+  if (!Addr)
+    return Col;
+  const auto* TD = llvm::dyn_cast_or_null<TypedefNameDecl>(
+      unwrap<Decl>(GetNamed(Name + "_t")));
+  if (!TD)
+    return Col;
+  QualType QT = TD->getUnderlyingType();
+  Box::Kind K = columnKind(QT.getCanonicalType());
+  if (K == Box::K_Unspecified)
+    return Col;
+  Col.m_ElementSize = getASTContext().getTypeSizeInChars(QT).getQuantity();
+  Col.m_Data.resize(Col.m_ElementSize * N);
+  VTableOverlay::BitCastFn<void (*)(const void*, void*, size_t)>(Addr)(
+      In, Col.m_Data.data(), N);
+  Col.m_Kind = K;
+  Col.m_Type = QT.getAsOpaquePtr();
+  Col.m_Size = N;
+  return Col;
+}
+
+static std::string batchName() {
+  static unsigned long long Serial = 0;
+  return "__cppinterop_batch" + std::to_string(Serial++);
+}
+
+BoxColumn EvaluateBatch(const std::vector<std::string>& exprs) {
+  INTEROP_TRACE(exprs);
+  if (exprs.empty())
+    return INTEROP_RETURN(BoxColumn{});
+  // One function assigns every result to its element; the column takes the
+  // common type of all the expressions, so {"1", "2.5"} is a double column.
+  std::string Name = batchName();
+  std::string T = Name + "_t";
+  std::string Types;
+  for (const std::string& E : exprs)
+    Types += (Types.empty() ? "decltype((" : ", decltype((") + E + "))";
+  std::string Code = "#include <type_traits>\nusing " + T +
+                     " = std::common_type_t<" + Types + ">;\n" +
+                     "__attribute__((used)) extern \"C\" void " + Name +
+                     "_fn(const void*, void* out, __SIZE_TYPE__) {\n" + "  " +
+                     T + "* o = static_cast<" + T + "*>(out);\n";
+  for (size_t i = 0; i < exprs.size(); ++i)
+    Code += "  o[" + std::to_string(i) + "] = (" + exprs[i] + ");\n";
+  Code += "}\n";
+  return INTEROP_RETURN(runBatch(Name, Code, nullptr, exprs.size()));
+}
+
+BoxColumn EvaluateBatch(const char* expr, const char* var,
+                        const BoxColumn& inputs) {
+  INTEROP_TRACE(expr, var, inputs);
+  if (!expr || !var || inputs.m_Kind < 0 || !inputs.m_Type ||
+      inputs.m_Data.size() < inputs.m_Size * inputs.m_ElementSize)
+    return INTEROP_RETURN(BoxColumn{});
+  // The expression becomes the body of a function of var, called in a loop
+  // over the input column.
+  ASTContext& C = getASTContext();
+  std::string In;
+  get_type_as_string(QualType::getFromOpaquePtr(inputs.m_Type.data), In, C,
+                     PrintingPolicy(C.getPrintingPolicy()));
+  std::string Name = batchName();
+  std::string F = Name + "_f";
+  std::string Code =
+      "inline auto " + F + "(const " + In + "& " + var + ") { return (" +
+      expr + "); }\n" + "using " + Name + "_t = __remove_cvref(decltype(" + F +
+      "(*static_cast<const " + In + "*>(nullptr))));\n" +
+      "__attribute__((used)) extern \"C\" void " + Name +
+      "_fn(const void* in, void* out, __SIZE_TYPE__ n) {\n" + "  auto* i = " +
+      "static_cast<const " + In + "*>(in);\n" + "  auto* o = static_cast<" +
+      Name + "_t*>(out);\n" + "  for (__SIZE_TYPE__ k = 0; k < n; ++k)\n" +
+      "    o[k] = " + F + "(i[k]);\n" + "}\n";
+  return INTEROP_RETURN(
+      runBatch(Name, Code, inputs.m_Data.data(), inputs.m_Size));
+}
+
 std::string LookupLibrary(const char* lib_name) {
   INTEROP_TRACE(lib_name);
   return INTEROP_RETURN(
@@ -5591,9 +7183,29 @@ bool LoadLibrary(const char* lib_stem, bool lookup) {
   return INTEROP_RETURN(res == compat::Interpreter::kSuccess);
 }
 
+bool LoadLibraries(const std::vector<std::string>& lib_stems, bool lookup) {
+  INTEROP_TRACE(lib_stems, lookup);
+  compat::Interpreter& I = getInterp();
+#ifdef CPPINTEROP_USE_CLING
+  bool Loaded = true;
+  for (const std::string& lib_stem : lib_stems)
+    Loaded &= I.loadLibrary(lib_stem, lookup) ==
+              compat::Interpreter::kSuccess;
+  return INTEROP_RETURN(Loaded);
+#else
+  return INTEROP_RETURN(I.loadLibraries(lib_stems, lookup) ==
+                        compat::Interpreter::kSuccess);
+#endif
+}
+
 void UnloadLibrary(const char* lib_stem) {
   INTEROP_TRACE(lib_stem);
+  forgetUnloadedCode(getInterpInfo());
+#ifdef CPPINTEROP_USE_CLING
   getInterp().getDynamicLibraryManager()->unloadLibrary(lib_stem);
+#else
+  getInterp().unloadLibrary(lib_stem);
+#endif
   return INTEROP_VOID_RETURN();
 }
 
@@ -5605,6 +7217,112 @@ std::string SearchLibrariesForSymbol(const char* mangled_name,
       DLM->searchLibrariesForSymbol(mangled_name, search_system));
 }
 
+std::vector<std::string>
+SearchLibrariesForSymbols(const std::vector<std::string>& mangled_names,
+                          bool search_system /*true*/) {
+  INTEROP_TRACE(mangled_names, search_system);
+  auto* DLM = getInterp().getDynamicLibraryManager();
+#ifdef CPPINTEROP_USE_CLING
+  std::vector<std::string> Found;
+  for (const std::string& Name : mangled_names)
+    Found.push_back(DLM->searchLibrariesForSymbol(Name, search_system));
+  return INTEROP_RETURN(Found);
+#else
+  std::vector<llvm::StringRef> Names(mangled_names.begin(),
+                                     mangled_names.end());
+  return INTEROP_RETURN(DLM->searchLibrariesForSymbols(Names, search_system));
+#endif
+}
+
+void UseLibrarySymbolIndex(bool enable) {
+  INTEROP_TRACE(enable);
+#ifndef CPPINTEROP_USE_CLING
+  getInterp().getDynamicLibraryManager()->setUseSymbolIndex(enable);
+#endif
+  return INTEROP_VOID_RETURN();
+}
+
+void SetLibraryMappingBudget(size_t bytes) {
+  INTEROP_TRACE(bytes);
+#ifndef CPPINTEROP_USE_CLING
+  getInterp().getDynamicLibraryManager()->setMappingBudget(bytes);
+#endif
+  return INTEROP_VOID_RETURN();
+}
+
+void SetLibraryIndexDirectory(const char* dir, bool symbol_hashes) {
+  INTEROP_TRACE(dir, symbol_hashes);
+#ifndef CPPINTEROP_USE_CLING
+  getInterp().getDynamicLibraryManager()->setIndexDirectory(dir ? dir : "",
+                                                            symbol_hashes);
+#endif
+  return INTEROP_VOID_RETURN();
+}
+
+bool SetLibraryAutoLoading(bool enable) {
+  INTEROP_TRACE(enable);
+#ifdef CPPINTEROP_USE_CLING
+  // Cling resolves missing symbols through its own callbacks.
+  return INTEROP_RETURN(!enable);
+#else
+  return INTEROP_RETURN(getInterp().setLibraryAutoLoading(enable));
+#endif
+}
+
+void GetAutoLoadedLibraries(std::vector<std::string>& libraries,
+                            std::vector<std::string>& symbols) {
+  INTEROP_TRACE(INTEROP_OUT(libraries), INTEROP_OUT(symbols));
+#ifndef CPPINTEROP_USE_CLING
+  for (const auto& Loaded :
+       getInterp().getDynamicLibraryManager()->getAutoLoadedLibraries()) {
+    libraries.push_back(Loaded.Library);
+    symbols.push_back(Loaded.Symbol);
+  }
+#endif
+  return INTEROP_VOID_RETURN();
+}
+
+bool SetLibrarySearchPathWatching(bool enable) {
+  INTEROP_TRACE(enable);
+#ifdef CPPINTEROP_USE_CLING
+  return INTEROP_RETURN(!enable);
+#else
+  return INTEROP_RETURN(
+      getInterp().getDynamicLibraryManager()->setWatchSearchPaths(enable));
+#endif
+}
+
+size_t GetLibraryRescansAvoided() {
+  INTEROP_TRACE();
+#ifdef CPPINTEROP_USE_CLING
+  return INTEROP_RETURN(0);
+#else
+  return INTEROP_RETURN(
+      getInterp().getDynamicLibraryManager()->getRescansAvoided());
+#endif
+}
+
+void GetLibrarySearchStats(std::vector<std::string>& names,
+                           std::vector<uint64_t>& values) {
+  INTEROP_TRACE(INTEROP_OUT(names), INTEROP_OUT(values));
+#ifndef CPPINTEROP_USE_CLING
+  getInterp().getDynamicLibraryManager()->getSearchStats().forEach(
+      [&](const char* Name, uint64_t Value) {
+        names.push_back(Name);
+        values.push_back(Value);
+      });
+#endif
+  return INTEROP_VOID_RETURN();
+}
+
+void ResetLibrarySearchStats() {
+  INTEROP_TRACE();
+#ifndef CPPINTEROP_USE_CLING
+  getInterp().getDynamicLibraryManager()->resetSearchStats();
+#endif
+  return INTEROP_VOID_RETURN();
+}
+
 bool InsertOrReplaceJitSymbol(compat::Interpreter& I,
                               const char* linker_mangled_name,
                               uint64_t address) {
@@ -5691,9 +7409,172 @@ bool InsertOrReplaceJitSymbol(const char* linker_mangled_name,
       InsertOrReplaceJitSymbol(getInterp(), linker_mangled_name, address));
 }
 
+using ObjPrinter = InterpreterInfo::ObjPrinter;
+
+// Compile the printer of the type spelled TyRef, or reuse the one of its
+// canonical type; a null printer if the spelling does not name an object
+// type or the printer does not compile.
+static ObjPrinter compileObjPrinter(const char* TyRef) {
+  static unsigned long long Serial = 0;
+  std::string Name = "__cppinterop_print" + std::to_string(Serial++);
+  std::string Alias = "using " + Name + "_t = " + TyRef + ";";
+  auto& I = getInterp();
+  if (Declare(I, Alias.c_str(), /*silent=*/true))
+    return {};
+  const auto* TD = llvm::dyn_cast_or_null<TypedefNameDecl>(
+      unwrap<Decl>(GetNamed(Name + "_t")));
+  if (!TD)
+    return {};
+  QualType QT = TD->getUnderlyingType().getCanonicalType();
+  if (QT->isReferenceType() || QT->isVoidType() || QT->isFunctionType() ||
+      QT->isIncompleteType())
+    return {};
+  auto& II = getInterpInfo();
+  auto Cached = II.ObjPrinters.find(QT.getAsOpaquePtr());
+  if (Cached != II.ObjPrinters.end())
+    return Cached->second;
+#ifdef CPPINTEROP_USE_CLING
+  // Cling's own value printer, as used by Interpreter::toString.
+  std::string Code = "#include \"cling/Interpreter/RuntimePrintValue.h\"\n";
+  std::string Body = "  out += cling::printValue(static_cast<const " + Name +
+                     "_t*>(p));\n";
+#else
+  // Ranges print as { a, b }, streamable types through operator<<, and
+  // anything else as its address.
+  std::string Code = R"(#ifndef __CPPINTEROP_OBJ_PRINTER
+#define __CPPINTEROP_OBJ_PRINTER
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+namespace __cppinterop_print {
+template <int N> struct rank : rank<N - 1> {};
+template <> struct rank<0> {};
+template <class T> void print(std::string& o, const T& v);
+inline void address(std::string& o, const void* p) {
+  char b[32];
+  std::snprintf(b, sizeof(b), "%p", p);
+  o += b;
+}
+template <class T> void put(std::string& o, const T& v, rank<0>) {
+  o += '@';
+  address(o, std::addressof(v));
+}
+template <class T>
+auto put(std::string& o, const T& v, rank<1>)
+    -> decltype(std::declval<std::ostream&>() << v, void()) {
+  std::ostringstream s;
+  s << v;
+  o += s.str();
+}
+template <class T>
+auto put(std::string& o, const T& v, rank<2>)
+    -> decltype(std::begin(v), std::end(v), void()) {
+  const char* sep = "{ ";
+  for (const auto& e : v) {
+    o += sep;
+    sep = ", ";
+    print(o, e);
+  }
+  o += *sep == '{' ? "{}" : " }";
+}
+template <class T> void put(std::string& o, T* const& v, rank<3>) {
+  address(o, (const void*)v);
+}
+template <class T, std::enable_if_t<std::is_same<T, bool>::value, int> = 0>
+void put(std::string& o, const T& v, rank<4>) {
+  o += v ? "true" : "false";
+}
+template <class T, std::enable_if_t<std::is_same<T, char>::value, int> = 0>
+void put(std::string& o, const T& v, rank<4>) {
+  o += '\'';
+  o += v;
+  o += '\'';
+}
+template <class T,
+          std::enable_if_t<std::is_same<T, std::string>::value, int> = 0>
+void put(std::string& o, const T& v, rank<4>) {
+  o += '"';
+  o += v;
+  o += '"';
+}
+template <class T> void print(std::string& o, const T& v) {
+  put(o, v, rank<4>{});
+}
+} // namespace __cppinterop_print
+#endif
+)";
+  std::string Body = "  __cppinterop_print::print(out, *static_cast<const " +
+                     Name + "_t*>(p));\n";
+#endif
+  Code += "__attribute__((used)) extern \"C\" void " + Name +
+          "(const void* p, std::string& out) {\n" + Body + "}\n";
+  ObjPrinter Printer;
+  Printer.Fn = I.compileFunction(Name, Code, /*ifUnique=*/false,
+                                 /*withAccessControl=*/false);
+  if (Printer.Fn)
+    Printer.Size = getASTContext().getTypeSizeInChars(QT).getQuantity();
+  II.ObjPrinters[QT.getAsOpaquePtr()] = Printer;
+  return Printer;
+}
+
+// Get the cached printer of the type spelled TyRef, compiling it on first
+// use. Every spelling of a type shares the printer of its canonical type.
+// Failures are cached as null printers too, so that a spelling which does
+// not name a printable type is parsed only once.
+static ObjPrinter getObjPrinter(const char* TyRef) {
+  auto& II = getInterpInfo();
+  auto ByName = II.ObjPrintersByName.find(TyRef);
+  if (ByName != II.ObjPrintersByName.end())
+    return ByName->second;
+  ObjPrinter Printer = compileObjPrinter(TyRef);
+  II.ObjPrintersByName[TyRef] = Printer;
+  return Printer;
+}
+
+using ObjPrinterFn = void (*)(const void*, std::string&);
+
 std::string ObjToString(const char* TyRef, void* obj) {
   INTEROP_TRACE(TyRef, obj);
-  return INTEROP_RETURN(getInterp().toString(TyRef, obj));
+  if (!TyRef || !obj)
+    return INTEROP_RETURN(std::string());
+  ObjPrinter Printer = getObjPrinter(TyRef);
+  if (!Printer.Fn) {
+#ifdef CPPINTEROP_USE_CLING
+    return INTEROP_RETURN(getInterp().toString(TyRef, obj));
+#else
+    // clang-repl has no value printer to fall back on.
+    return INTEROP_RETURN(std::string());
+#endif
+  }
+  std::string Out;
+  VTableOverlay::BitCastFn<ObjPrinterFn>(Printer.Fn)(obj, Out);
+  return INTEROP_RETURN(Out);
+}
+
+std::string ObjToStringMany(const char* TyRef, const void* objs, size_t count,
+                            size_t stride) {
+  INTEROP_TRACE(TyRef, objs, count, stride);
+  if (!TyRef || !objs || !count)
+    return INTEROP_RETURN(std::string());
+  ObjPrinter Printer = getObjPrinter(TyRef);
+  if (!Printer.Fn)
+    return INTEROP_RETURN(std::string());
+  if (!stride)
+    stride = Printer.Size;
+  auto Print = VTableOverlay::BitCastFn<ObjPrinterFn>(Printer.Fn);
+  std::string Out;
+  const auto* Obj = static_cast<const char*>(objs);
+  for (size_t i = 0; i < count; ++i, Obj += stride) {
+    if (i)
+      Out += '\n';
+    Print(Obj, Out);
+  }
+  return INTEROP_RETURN(Out);
 }
 
 static Decl* InstantiateTemplate(TemplateDecl* TemplateD,
@@ -5769,9 +7650,16 @@ Decl* InstantiateTemplate(TemplateDecl* TemplateD,
   return InstantiateTemplate(TemplateD, TLI, S, instantiate_body);
 }
 
-DeclRef InstantiateTemplate(compat::Interpreter& I, DeclRef tmpl,
-                            const TemplateArgInfo* template_args,
-                            size_t template_args_size, bool instantiate_body) {
+// Instantiates TmplD with the given arguments, consulting the
+// per-interpreter memo keyed on the canonical template and its canonical
+// argument list first. When OpenTransaction is false the caller already
+// holds a transaction (see InstantiateTemplates).
+static Decl* instantiateTemplateMemoized(compat::Interpreter& I,
+                                         TemplateDecl* TmplD,
+                                         const TemplateArgInfo* template_args,
+                                         size_t template_args_size,
+                                         bool instantiate_body,
+                                         bool OpenTransaction) {
   auto& S = I.getSema();
   auto& C = S.getASTContext();
 
@@ -5790,10 +7678,42 @@ DeclRef InstantiateTemplate(compat::Interpreter& I, DeclRef tmpl,
     }
   }
 
-  auto* TmplD = unwrap<TemplateDecl>(tmpl);
+  llvm::FoldingSetNodeID Key;
+  Key.AddPointer(TmplD->getCanonicalDecl());
+  for (const TemplateArgument& TA : TemplateArgs)
+    C.getCanonicalTemplateArgument(TA).Profile(Key, C);
+
+  auto& Memo = getInterpInfo(&I).TemplateInstantiations;
+  auto It = Memo.find(Key);
+  // A class which could not be completed last time is retried below.
+  if (It != Memo.end()) {
+    Decl* D = It->second;
+    const auto* RD = dyn_cast<CXXRecordDecl>(D);
+    if (!RD || RD->hasDefinition()) {
+      if (instantiate_body && isa<FunctionDecl>(D) &&
+          !cast<FunctionDecl>(D)->isDefined())
+        InstantiateFunctionDefinition(D);
+      return D;
+    }
+  }
+
   // We will create a new decl, push a transaction.
-  compat::SynthesizingCodeRAII RAII(&getInterp());
-  return InstantiateTemplate(TmplD, TemplateArgs, S, instantiate_body);
+  std::optional<compat::SynthesizingCodeRAII> RAII;
+  if (OpenTransaction)
+    RAII.emplace(&getInterp());
+  Decl* D = InstantiateTemplate(TmplD, TemplateArgs, S, instantiate_body);
+  if (D)
+    Memo[Key] = D;
+  return D;
+}
+
+DeclRef InstantiateTemplate(compat::Interpreter& I, DeclRef tmpl,
+                            const TemplateArgInfo* template_args,
+                            size_t template_args_size, bool instantiate_body) {
+  return instantiateTemplateMemoized(I, unwrap<TemplateDecl>(tmpl),
+                                     template_args, template_args_size,
+                                     instantiate_body,
+                                     /*OpenTransaction=*/true);
 }
 
 DeclRef InstantiateTemplate(DeclRef tmpl, const TemplateArgInfo* template_args,
@@ -5814,6 +7734,28 @@ DeclRef InstantiateTemplate(DeclRef tmpl,
                           template_args.size(), instantiate_body));
 }
 
+void InstantiateTemplates(const std::vector<TemplateInstantiation>& requests,
+                          std::vector<DeclRef>& instances,
+                          bool instantiate_body) {
+  INTEROP_TRACE(requests, INTEROP_OUT(instances), instantiate_body);
+  compat::Interpreter& I = getInterp();
+  instances.reserve(instances.size() + requests.size());
+  // All misses share a single transaction instead of pushing one each.
+  compat::SynthesizingCodeRAII RAII(&I);
+  for (const TemplateInstantiation& R : requests) {
+    auto* TmplD =
+        llvm::dyn_cast_or_null<TemplateDecl>(unwrap<Decl>(R.m_Template));
+    if (!TmplD) {
+      instances.push_back(nullptr);
+      continue;
+    }
+    instances.push_back(instantiateTemplateMemoized(
+        I, TmplD, R.m_Args.data(), R.m_Args.size(), instantiate_body,
+        /*OpenTransaction=*/false));
+  }
+  return INTEROP_VOID_RETURN();
+}
+
 void GetClassTemplateArgs(ConstDeclRef templ_instance,
                           std::vector<TemplateArgInfo>& args) {
   INTEROP_TRACE(templ_instance, INTEROP_OUT(args));
@@ -6320,6 +8262,7 @@ void CodeComplete(std::vector<std::string>& Results, const char* code,
 int Undo(unsigned N) {
   INTEROP_TRACE(N);
   compat::SynthesizingCodeRAII RAII(&getInterp());
+  forgetUnloadedCode(getInterpInfo());
 #ifdef CPPINTEROP_USE_CLING
   getInterp().unload(N);
   return INTEROP_RETURN(compat::Interpreter::kSuccess);
@@ -6328,4 +8271,573 @@ int Undo(unsigned N) {
 #endif
 }
 
+// --- Reflection database ---
+//
+// The file is a header followed by 8-byte aligned arrays of the fixed-size
+// records below. Strings are offsets into a NUL-terminated string table
+// whose first entry is "". Scopes are stored breadth-first so that the
+// direct children of a scope are contiguous; a name-sorted index of the
+// scopes supports lookup by qualified name.
+namespace {
+constexpr char kRDBMagic[8] = "CPPIRDB";
+constexpr uint32_t kRDBVersion = 1;
+
+struct RDBHeader {
+  char Magic[8];
+  uint32_t Version;
+  uint32_t PointerSize;
+  uint32_t NumScopes;
+  uint32_t NumMethods;
+  uint32_t NumFields;
+  uint32_t NumEnumerators;
+  uint32_t StrTabSize;
+  uint32_t Pad;
+  uint64_t ScopesOffset;
+  uint64_t SortedScopesOffset;
+  uint64_t MethodsOffset;
+  uint64_t FieldsOffset;
+  uint64_t EnumeratorsOffset;
+  uint64_t StrTabOffset;
+};
+
+struct RDBScope {
+  uint32_t Name;
+  uint32_t Parent; // 1-based id; 0 for the root.
+  uint32_t Kind;   // ReflectionDBScopeKind.
+  uint32_t FirstChild;
+  uint32_t NumChildren;
+  uint32_t FirstMethod;
+  uint32_t NumMethods;
+  uint32_t FirstField;
+  uint32_t NumFields;
+  uint32_t FirstEnumerator;
+  uint32_t NumEnumerators;
+  uint32_t Pad;
+  uint64_t Size;
+};
+
+struct RDBMethod {
+  uint32_t Name;
+  uint32_t Signature;
+  uint32_t MangledName;
+  uint32_t NumArgs;
+  uint32_t Flags;
+  uint32_t Pad;
+};
+
+struct RDBField {
+  uint32_t Name;
+  uint32_t Type;
+  uint32_t MangledName;
+  uint32_t Flags;
+  int64_t Offset;
+};
+
+struct RDBEnumerator {
+  uint32_t Name;
+  uint32_t Pad;
+  int64_t Value;
+};
+
+static_assert(sizeof(RDBHeader) == 88, "On-disk layout changed");
+static_assert(sizeof(RDBScope) == 56, "On-disk layout changed");
+static_assert(sizeof(RDBMethod) == 24, "On-disk layout changed");
+static_assert(sizeof(RDBField) == 24, "On-disk layout changed");
+static_assert(sizeof(RDBEnumerator) == 16, "On-disk layout changed");
+
+class RDBWriter {
+  llvm::StringMap<uint32_t> m_StrIndex;
+  std::string m_StrTab = std::string(1, '\0');
+  // m_Pending[i] is the declaration described by Scopes[i]; null for the
+  // root.
+  std::vector<const Decl*> m_Pending;
+  llvm::SmallPtrSet<const Decl*, 32> m_Seen;
+  // Set when a string did not fit the 32-bit offsets of the format; the
+  // database is then not written rather than written with wrong strings.
+  bool m_Overflow = false;
+
+public:
+  std::vector<RDBScope> Scopes;
+  std::vector<RDBMethod> Methods;
+  std::vector<RDBField> Fields;
+  std::vector<RDBEnumerator> Enumerators;
+
+  uint32_t addString(llvm::StringRef S) {
+    if (S.empty())
+      return 0;
+    if (m_StrTab.size() + S.size() >= std::numeric_limits<uint32_t>::max()) {
+      m_Overflow = true;
+      return 0;
+    }
+    auto R = m_StrIndex.try_emplace(S, m_StrTab.size());
+    if (R.second) {
+      m_StrTab.append(S.data(), S.size());
+      m_StrTab.push_back('\0');
+    }
+    return R.first->second;
+  }
+
+  llvm::StringRef getString(uint32_t Offset) const {
+    return m_StrTab.c_str() + Offset;
+  }
+
+  const std::string& getStringTable() const { return m_StrTab; }
+
+  const Decl* getDecl(size_t Index) const { return m_Pending[Index]; }
+
+  void addScope(const Decl* D, ReflectionDBScopeKind Kind, uint32_t Parent) {
+    RDBScope S = {};
+    S.Kind = Kind;
+    S.Parent = Parent;
+    if (D) {
+      S.Name = addString(GetCompleteNameImpl(D, /*qualified=*/true));
+      ASTContext& C = getASTContext();
+      if (const auto* RD = llvm::dyn_cast<RecordDecl>(D))
+        S.Size = C.getASTRecordLayout(RD).getSize().getQuantity();
+      else if (const auto* ED = llvm::dyn_cast<EnumDecl>(D))
+        S.Size = C.getTypeSizeInChars(C.getTypeDeclType(ED)).getQuantity();
+    }
+    Scopes.push_back(S);
+    m_Pending.push_back(D);
+  }
+
+  // Appends the namespaces, classes and enums declared in DC as children
+  // of the scope at index Parent. Reopened namespaces are merged.
+  void addChildren(const DeclContext* DC, uint32_t Parent) {
+    for (const Decl* D : DC->decls()) {
+      if (const auto* LSD = llvm::dyn_cast<LinkageSpecDecl>(D)) {
+        addChildren(LSD, Parent);
+        continue;
+      }
+      ReflectionDBScopeKind Kind;
+      if (const auto* NS = llvm::dyn_cast<NamespaceDecl>(D)) {
+        if (NS->isAnonymousNamespace())
+          continue;
+        D = NS->getCanonicalDecl();
+        Kind = kRDBNamespace;
+      } else if (const auto* RD = llvm::dyn_cast<CXXRecordDecl>(D)) {
+        if (RD->getDeclName().isEmpty() || RD->isInjectedClassName() ||
+            RD->isLambda() || !RD->hasDefinition())
+          continue;
+        RD = RD->getDefinition();
+        if (RD->isInvalidDecl() || RD->isDependentType())
+          continue;
+        D = RD;
+        Kind = kRDBClass;
+      } else if (const auto* ED = llvm::dyn_cast<EnumDecl>(D)) {
+        if (ED->getDeclName().isEmpty() || !ED->getDefinition())
+          continue;
+        ED = ED->getDefinition();
+        if (ED->isInvalidDecl() || ED->isDependentType())
+          continue;
+        D = ED;
+        Kind = kRDBEnum;
+      } else {
+        continue;
+      }
+      if (m_Seen.insert(D->getCanonicalDecl()).second)
+        addScope(D, Kind, Parent + 1);
+    }
+  }
+
+  void addNamespace(const NamespaceDecl* NS) {
+    if (m_Seen.insert(NS->getCanonicalDecl()).second)
+      addScope(NS->getCanonicalDecl(), kRDBNamespace, /*Parent=*/1);
+  }
+
+  void addMembers(const CXXRecordDecl* RD, RDBScope& S) {
+    S.FirstMethod = Methods.size();
+    std::vector<FuncRef> MethodRefs;
+    GetClassDecls<CXXMethodDecl>(RD, MethodRefs);
+    for (FuncRef M : MethodRefs) {
+      const auto* MD = llvm::dyn_cast<CXXMethodDecl>(
+          UnwrapUsingShadowToFunction(unwrap<Decl>(M)));
+      if (!MD)
+        continue;
+      RDBMethod R = {};
+      R.Name = addString(GetCompleteNameImpl(MD, /*qualified=*/false));
+      R.Signature = addString(GetFunctionSignature(MD));
+      R.NumArgs = MD->getNumParams();
+      if (MD->isStatic())
+        R.Flags |= kRDBStatic;
+      if (MD->isVirtual())
+        R.Flags |= kRDBVirtual;
+      if (MD->isConst())
+        R.Flags |= kRDBConst;
+      if (!MD->isDeleted() && !MD->isPureVirtual()) {
+        GlobalDecl GD(MD);
+        if (const auto* CD = llvm::dyn_cast<CXXConstructorDecl>(MD))
+          GD = GlobalDecl(CD, Ctor_Complete);
+        else if (const auto* DD = llvm::dyn_cast<CXXDestructorDecl>(MD))
+          GD = GlobalDecl(DD, Dtor_Complete);
+        std::string MangledName;
+        compat::maybeMangleDeclName(GD, MangledName);
+        R.MangledName = addString(MangledName);
+      }
+      if (llvm::isa<CXXConstructorDecl>(MD))
+        R.Flags |= kRDBConstructor;
+      else if (llvm::isa<CXXDestructorDecl>(MD))
+        R.Flags |= kRDBDestructor;
+      Methods.push_back(R);
+    }
+    S.NumMethods = Methods.size() - S.FirstMethod;
+
+    S.FirstField = Fields.size();
+    std::vector<FieldLayoutEntry> Layout;
+    GetFieldLayout(RD, Layout);
+    for (const FieldLayoutEntry& E : Layout) {
+      const auto* FD = unwrap<FieldDecl>(E.m_Field);
+      RDBField R = {};
+      R.Name = addString(FD->getName());
+      R.Type = addString(GetTypeAsString(FD->getType().getAsOpaquePtr()));
+      R.Offset = E.m_Offset;
+      if (FD->getType().isConstQualified())
+        R.Flags |= kRDBConst;
+      Fields.push_back(R);
+    }
+    std::vector<DeclRef> Statics;
+    GetClassDecls<VarDecl>(RD, Statics);
+    for (DeclRef Ref : Statics) {
+      const Decl* D = unwrap<Decl>(Ref);
+      if (const auto* USD = llvm::dyn_cast<UsingShadowDecl>(D))
+        D = USD->getTargetDecl();
+      const auto* VD = llvm::dyn_cast<VarDecl>(D);
+      if (!VD)
+        continue;
+      RDBField R = {};
+      R.Name = addString(VD->getName());
+      R.Type = addString(GetTypeAsString(VD->getType().getAsOpaquePtr()));
+      std::string MangledName;
+      compat::maybeMangleDeclName(GlobalDecl(VD), MangledName);
+      R.MangledName = addString(MangledName);
+      R.Flags = kRDBStatic;
+      if (VD->getType().isConstQualified())
+        R.Flags |= kRDBConst;
+      Fields.push_back(R);
+    }
+    S.NumFields = Fields.size() - S.FirstField;
+  }
+
+  void addEnumerators(const EnumDecl* ED, RDBScope& S) {
+    S.FirstEnumerator = Enumerators.size();
+    for (const EnumConstantDecl* ECD : ED->enumerators()) {
+      RDBEnumerator R = {};
+      R.Name = addString(ECD->getName());
+      R.Value = ECD->getInitVal().getExtValue();
+      Enumerators.push_back(R);
+    }
+    S.NumEnumerators = Enumerators.size() - S.FirstEnumerator;
+  }
+
+  // Visits the scopes breadth-first so that the children of each scope are
+  // appended contiguously.
+  void expand(bool ExportGlobal) {
+    for (size_t i = 0; i < Scopes.size(); ++i) {
+      const Decl* D = m_Pending[i];
+      uint32_t FirstChild = Scopes.size();
+      if (!D) {
+        // The root's named namespaces were added up front.
+        FirstChild = 1;
+        if (ExportGlobal)
+          addChildren(getASTContext().getTranslationUnitDecl(), i);
+      } else if (const auto* NS = llvm::dyn_cast<NamespaceDecl>(D)) {
+        // collectAllContexts is non-const but logically read-only here.
+        auto* DC = const_cast<NamespaceDecl*>(NS)->getPrimaryContext();
+        llvm::SmallVector<DeclContext*, 4> DCs;
+        DC->collectAllContexts(DCs);
+        for (const DeclContext* DC : DCs)
+          addChildren(DC, i);
+      } else if (const auto* RD = llvm::dyn_cast<CXXRecordDecl>(D)) {
+        addChildren(RD, i);
+        addMembers(RD, Scopes[i]);
+      } else if (const auto* ED = llvm::dyn_cast<EnumDecl>(D)) {
+        addEnumerators(ED, Scopes[i]);
+      }
+      Scopes[i].FirstChild = FirstChild;
+      Scopes[i].NumChildren = Scopes.size() - FirstChild;
+    }
+  }
+
+  bool write(const char* Path) const {
+    // Counts and indices are 32-bit on disk as well.
+    const size_t Max = std::numeric_limits<uint32_t>::max();
+    if (m_Overflow || Scopes.size() > Max || Methods.size() > Max ||
+        Fields.size() > Max || Enumerators.size() > Max)
+      return false;
+
+    std::vector<uint32_t> Sorted(Scopes.size());
+    for (size_t i = 0, e = Sorted.size(); i < e; ++i)
+      Sorted[i] = i;
+    llvm::sort(Sorted, [this](uint32_t A, uint32_t B) {
+      return getString(Scopes[A].Name) < getString(Scopes[B].Name);
+    });
+
+    RDBHeader H = {};
+    std::memcpy(H.Magic, kRDBMagic, sizeof(H.Magic));
+    H.Version = kRDBVersion;
+    H.PointerSize = sizeof(void*);
+    H.NumScopes = Scopes.size();
+    H.NumMethods = Methods.size();
+    H.NumFields = Fields.size();
+    H.NumEnumerators = Enumerators.size();
+    H.StrTabSize = m_StrTab.size();
+    uint64_t Offset = sizeof(RDBHeader);
+    auto Place = [&Offset](uint64_t Size) {
+      uint64_t Start = llvm::alignTo(Offset, 8);
+      Offset = Start + Size;
+      return Start;
+    };
+    H.ScopesOffset = Place(Scopes.size() * sizeof(RDBScope));
+    H.SortedScopesOffset = Place(Sorted.size() * sizeof(uint32_t));
+    H.MethodsOffset = Place(Methods.size() * sizeof(RDBMethod));
+    H.FieldsOffset = Place(Fields.size() * sizeof(RDBField));
+    H.EnumeratorsOffset = Place(Enumerators.size() * sizeof(RDBEnumerator));
+    H.StrTabOffset = Place(m_StrTab.size());
+
+    std::error_code EC;
+    llvm::raw_fd_ostream OS(Path, EC, llvm::sys::fs::OF_None);
+    if (EC)
+      return false;
+    auto Emit = [&OS](uint64_t At, const void* Data, size_t Size) {
+      OS.write_zeros(At - OS.tell());
+      OS.write(static_cast<const char*>(Data), Size);
+    };
+    Emit(0, &H, sizeof(H));
+    Emit(H.ScopesOffset, Scopes.data(), Scopes.size() * sizeof(RDBScope));
+    Emit(H.SortedScopesOffset, Sorted.data(), Sorted.size() * sizeof(uint32_t));
+    Emit(H.MethodsOffset, Methods.data(), Methods.size() * sizeof(RDBMethod));
+    Emit(H.FieldsOffset, Fields.data(), Fields.size() * sizeof(RDBField));
+    Emit(H.EnumeratorsOffset, Enumerators.data(),
+         Enumerators.size() * sizeof(RDBEnumerator));
+    Emit(H.StrTabOffset, m_StrTab.data(), m_StrTab.size());
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      llvm::sys::fs::remove(Path);
+      return false;
+    }
+    return true;
+  }
+};
+} // namespace
+
+struct ReflectionDatabase {
+  std::unique_ptr<llvm::MemoryBuffer> Buffer;
+  llvm::ArrayRef<RDBScope> Scopes;
+  llvm::ArrayRef<uint32_t> SortedScopes;
+  llvm::ArrayRef<RDBMethod> Methods;
+  llvm::ArrayRef<RDBField> Fields;
+  llvm::ArrayRef<RDBEnumerator> Enumerators;
+  llvm::StringRef StrTab;
+
+  const char* getString(uint32_t Offset) const {
+    return Offset < StrTab.size() ? StrTab.data() + Offset : "";
+  }
+
+  const RDBScope* getScope(size_t Id) const {
+    if (!Id || Id > Scopes.size())
+      return nullptr;
+    return &Scopes[Id - 1];
+  }
+
+  // Returns the [First, First + Num) slice of A, or an empty range if the
+  // record refers past the end of its section.
+  template <typename T>
+  static llvm::ArrayRef<T> slice(llvm::ArrayRef<T> A, uint32_t First,
+                                 uint32_t Num) {
+    if (uint64_t(First) + Num > A.size())
+      return {};
+    return A.slice(First, Num);
+  }
+};
+
+bool ExportReflectionDatabase(const std::vector<std::string>& namespaces,
+                              const char* path) {
+  INTEROP_TRACE(namespaces, path);
+  if (!path)
+    return INTEROP_RETURN(false);
+
+  RDBWriter W;
+  W.addScope(nullptr, kRDBRoot, /*Parent=*/0);
+  bool ExportGlobal = namespaces.empty();
+  for (const std::string& Name : namespaces) {
+    if (Name.empty()) {
+      ExportGlobal = true;
+      continue;
+    }
+    const auto* NS = llvm::dyn_cast_or_null<NamespaceDecl>(
+        unwrap<Decl>(GetScopeFromCompleteName(Name)));
+    if (!NS)
+      return INTEROP_RETURN(false);
+    W.addNamespace(NS);
+  }
+  W.expand(ExportGlobal);
+  return INTEROP_RETURN(W.write(path));
+}
+
+ReflectionDatabase* OpenReflectionDatabase(const char* path) {
+  INTEROP_TRACE(path);
+  if (!path)
+    return INTEROP_RETURN(nullptr);
+  auto BufOrErr = llvm::MemoryBuffer::getFile(
+      path, /*IsText=*/false, /*RequiresNullTerminator=*/false,
+      /*IsVolatile=*/false, llvm::Align(8));
+  if (!BufOrErr)
+    return INTEROP_RETURN(nullptr);
+
+  std::unique_ptr<llvm::MemoryBuffer> Buf = std::move(*BufOrErr);
+  const char* Start = Buf->getBufferStart();
+  uint64_t FileSize = Buf->getBufferSize();
+  if (FileSize < sizeof(RDBHeader))
+    return INTEROP_RETURN(nullptr);
+  RDBHeader H;
+  std::memcpy(&H, Start, sizeof(H));
+  if (std::memcmp(H.Magic, kRDBMagic, sizeof(H.Magic)) != 0 ||
+      H.Version != kRDBVersion || H.PointerSize != sizeof(void*))
+    return INTEROP_RETURN(nullptr);
+
+  bool Valid = true;
+  auto Section = [&](uint64_t Offset, uint64_t Count, auto* Tag) {
+    using T = std::remove_pointer_t<decltype(Tag)>;
+    if (Offset % alignof(T) != 0 || Offset > FileSize ||
+        Count > (FileSize - Offset) / sizeof(T)) {
+      Valid = false;
+      return llvm::ArrayRef<T>();
+    }
+    return llvm::ArrayRef<T>(reinterpret_cast<const T*>(Start + Offset),
+                             Count);
+  };
+
+  auto DB = std::make_unique<ReflectionDatabase>();
+  DB->Scopes = Section(H.ScopesOffset, H.NumScopes, (RDBScope*)nullptr);
+  DB->SortedScopes =
+      Section(H.SortedScopesOffset, H.NumScopes, (uint32_t*)nullptr);
+  DB->Methods = Section(H.MethodsOffset, H.NumMethods, (RDBMethod*)nullptr);
+  DB->Fields = Section(H.FieldsOffset, H.NumFields, (RDBField*)nullptr);
+  DB->Enumerators =
+      Section(H.EnumeratorsOffset, H.NumEnumerators, (RDBEnumerator*)nullptr);
+  llvm::ArrayRef<char> StrTab =
+      Section(H.StrTabOffset, H.StrTabSize, (char*)nullptr);
+  // Every string must be NUL-terminated within the table.
+  if (!Valid || DB->Scopes.empty() || StrTab.empty() || StrTab.back() != '\0')
+    return INTEROP_RETURN(nullptr);
+  for (uint32_t Index : DB->SortedScopes)
+    if (Index >= DB->Scopes.size())
+      return INTEROP_RETURN(nullptr);
+  DB->StrTab = llvm::StringRef(StrTab.data(), StrTab.size());
+  DB->Buffer = std::move(Buf);
+  return INTEROP_RETURN(DB.release());
+}
+
+void CloseReflectionDatabase(ReflectionDatabase* db) {
+  INTEROP_TRACE(db);
+  delete db;
+  return INTEROP_VOID_RETURN();
+}
+
+size_t ReflectionDBGetScope(const ReflectionDatabase* db,
+                            const char* qualified_name) {
+  INTEROP_TRACE(db, qualified_name);
+  if (!db || !qualified_name)
+    return INTEROP_RETURN(0);
+  llvm::StringRef Name(qualified_name);
+  auto It = llvm::partition_point(db->SortedScopes, [&](uint32_t Index) {
+    return db->getString(db->Scopes[Index].Name) < Name;
+  });
+  if (It == db->SortedScopes.end() ||
+      db->getString(db->Scopes[*It].Name) != Name)
+    return INTEROP_RETURN(0);
+  return INTEROP_RETURN(*It + 1);
+}
+
+ReflectionDBScope ReflectionDBGetScopeInfo(const ReflectionDatabase* db,
+                                           size_t scope) {
+  INTEROP_TRACE(db, scope);
+  ReflectionDBScope Info;
+  const RDBScope* S = db ? db->getScope(scope) : nullptr;
+  if (!S)
+    return INTEROP_RETURN(Info);
+  Info.m_Name = db->getString(S->Name);
+  Info.m_Parent = S->Parent;
+  Info.m_Kind = static_cast<ReflectionDBScopeKind>(S->Kind);
+  Info.m_Size = S->Size;
+  return INTEROP_RETURN(Info);
+}
+
+void ReflectionDBGetSubScopes(const ReflectionDatabase* db, size_t scope,
+                              std::vector<size_t>& subscopes) {
+  INTEROP_TRACE(db, scope, INTEROP_OUT(subscopes));
+  const RDBScope* S = db ? db->getScope(scope) : nullptr;
+  if (!S || uint64_t(S->FirstChild) + S->NumChildren > db->Scopes.size())
+    return INTEROP_VOID_RETURN();
+  for (uint32_t i = 0; i < S->NumChildren; ++i)
+    subscopes.push_back(S->FirstChild + i + 1);
+  return INTEROP_VOID_RETURN();
+}
+
+void ReflectionDBGetClassMethods(const ReflectionDatabase* db, size_t scope,
+                                 std::vector<ReflectionDBMethod>& methods) {
+  INTEROP_TRACE(db, scope, INTEROP_OUT(methods));
+  const RDBScope* S = db ? db->getScope(scope) : nullptr;
+  if (!S)
+    return INTEROP_VOID_RETURN();
+  for (const RDBMethod& R :
+       ReflectionDatabase::slice(db->Methods, S->FirstMethod, S->NumMethods)) {
+    ReflectionDBMethod M;
+    M.m_Name = db->getString(R.Name);
+    M.m_Signature = db->getString(R.Signature);
+    M.m_MangledName = db->getString(R.MangledName);
+    M.m_NumArgs = R.NumArgs;
+    M.m_Flags = R.Flags;
+    methods.push_back(M);
+  }
+  return INTEROP_VOID_RETURN();
+}
+
+void ReflectionDBGetDatamembers(const ReflectionDatabase* db, size_t scope,
+                                std::vector<ReflectionDBField>& fields) {
+  INTEROP_TRACE(db, scope, INTEROP_OUT(fields));
+  const RDBScope* S = db ? db->getScope(scope) : nullptr;
+  if (!S)
+    return INTEROP_VOID_RETURN();
+  for (const RDBField& R :
+       ReflectionDatabase::slice(db->Fields, S->FirstField, S->NumFields)) {
+    ReflectionDBField F;
+    F.m_Name = db->getString(R.Name);
+    F.m_Type = db->getString(R.Type);
+    F.m_MangledName = db->getString(R.MangledName);
+    F.m_Offset = R.Offset;
+    F.m_Flags = R.Flags;
+    fields.push_back(F);
+  }
+  return INTEROP_VOID_RETURN();
+}
+
+void ReflectionDBGetEnumerators(
+    const ReflectionDatabase* db, size_t scope,
+    std::vector<ReflectionDBEnumerator>& enumerators) {
+  INTEROP_TRACE(db, scope, INTEROP_OUT(enumerators));
+  const RDBScope* S = db ? db->getScope(scope) : nullptr;
+  if (!S)
+    return INTEROP_VOID_RETURN();
+  for (const RDBEnumerator& R : ReflectionDatabase::slice(
+           db->Enumerators, S->FirstEnumerator, S->NumEnumerators)) {
+    ReflectionDBEnumerator E;
+    E.m_Name = db->getString(R.Name);
+    E.m_Value = R.Value;
+    enumerators.push_back(E);
+  }
+  return INTEROP_VOID_RETURN();
+}
+
+DeclRef ReflectionDBResolveScope(const ReflectionDatabase* db, size_t scope) {
+  INTEROP_TRACE(db, scope);
+  const RDBScope* S = db ? db->getScope(scope) : nullptr;
+  if (!S)
+    return INTEROP_RETURN(nullptr);
+  if (S->Kind == kRDBRoot)
+    return INTEROP_RETURN(getASTContext().getTranslationUnitDecl());
+  return INTEROP_RETURN(GetScopeFromCompleteName(db->getString(S->Name)));
+}
+
 } // namespace Cpp
@@ -29,9 +29,12 @@
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ExecutionEngine/Orc/AbsoluteSymbols.h"
 #include "llvm/ExecutionEngine/Orc/LLJIT.h"
 #include "llvm/Support/Compiler.h"
+#include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/raw_ostream.h"
@@ -42,8 +45,6 @@
 #include <unistd.h>
 #endif
 #if defined(_WIN32) && (defined(_M_IX86) || defined(__i386__))
-#include "llvm/ExecutionEngine/Orc/AbsoluteSymbols.h"
-#include "llvm/Support/DynamicLibrary.h"
 #include <deque>
 #endif
 #include <algorithm>
@@ -205,6 +206,98 @@ private:
 };
 #endif // _WIN32 && i386
 
+/// Resolves the symbols which JIT'd code references but no loaded library
+/// defines by loading the not-yet-loaded library on the search paths which
+/// does. The symbol search of the DynamicLibraryManager picks the library,
+/// which is then loaded through the manager like Cpp::LoadLibrary would, so
+/// libraries are only pulled in once code refers to them. The manager records
+/// the symbol which triggered each load, and the generator the symbols it
+/// defined from each library, which forgetLibrary removes again when the
+/// library is unloaded. Inactive unless the manager has automatic loading
+/// enabled.
+class AutoLoadLibraryGenerator : public llvm::orc::DefinitionGenerator {
+public:
+  AutoLoadLibraryGenerator(DynamicLibraryManager& DLM, char GlobalPrefix)
+      : m_DLM(DLM), m_GlobalPrefix(GlobalPrefix) {}
+
+  llvm::Error
+  tryToGenerate(llvm::orc::LookupState& LS, llvm::orc::LookupKind K,
+                llvm::orc::JITDylib& JD,
+                llvm::orc::JITDylibLookupFlags JDLookupFlags,
+                const llvm::orc::SymbolLookupSet& LookupSet) override {
+    if (!m_DLM.autoLoadLibraries())
+      return llvm::Error::success();
+
+    std::lock_guard<std::mutex> Lock(m_Mutex);
+    llvm::orc::SymbolMap NewSymbols;
+    for (const auto& KV : LookupSet) {
+      // A missing weak reference is not an error; do not load for it.
+      if (KV.second == llvm::orc::SymbolLookupFlags::WeaklyReferencedSymbol)
+        continue;
+      llvm::StringRef Name = *KV.first;
+      // ORC's own symbols are defined by its platform, later in the order.
+      if (Name.starts_with("__lljit") || Name.starts_with("__orc_rt"))
+        continue;
+      llvm::StringRef CName = Name;
+      if (m_GlobalPrefix && !CName.consume_front(llvm::StringRef(
+                                &m_GlobalPrefix, 1)))
+        continue;
+      // Symbols of the loaded libraries are left to the process generator.
+      std::string DLName = CName.str();
+      if (llvm::sys::DynamicLibrary::SearchForAddressOfSymbol(DLName))
+        continue;
+
+      std::string Library =
+          m_DLM.searchLibrariesForSymbol(Name, /*searchSystem=*/true);
+      // Canonicalize like Interpreter::loadLibrary, so that unloading the
+      // library by its name finds it.
+      if (!Library.empty()) {
+        std::string Canonical = m_DLM.lookupLibrary(Library);
+        if (!Canonical.empty())
+          Library = std::move(Canonical);
+      }
+      if (Library.empty() ||
+          m_DLM.loadLibrary(Library, /*permanent=*/false,
+                            /*resolved=*/true) !=
+              DynamicLibraryManager::kLoadLibSuccess)
+        continue;
+      m_DLM.addAutoLoadedLibrary(Library, Name);
+
+      if (void* Addr =
+              llvm::sys::DynamicLibrary::SearchForAddressOfSymbol(DLName)) {
+        NewSymbols[KV.first] = {llvm::orc::ExecutorAddr::fromPtr(Addr),
+                                llvm::JITSymbolFlags::Exported};
+        m_Defined[Library].push_back(KV.first);
+      }
+    }
+    if (NewSymbols.empty())
+      return llvm::Error::success();
+    return JD.define(llvm::orc::absoluteSymbols(std::move(NewSymbols)));
+  }
+
+  /// Removes the symbols defined in JD from Library, a path as the manager
+  /// canonicalizes it, before the library is unloaded: they would point
+  /// into unmapped memory, and a later reference must load it anew.
+  void forgetLibrary(llvm::orc::JITDylib& JD, llvm::StringRef Library) {
+    std::lock_guard<std::mutex> Lock(m_Mutex);
+    auto It = m_Defined.find(Library);
+    if (It == m_Defined.end())
+      return;
+    llvm::orc::SymbolNameSet Names(It->second.begin(), It->second.end());
+    m_Defined.erase(It);
+    if (auto Err = JD.remove(Names))
+      llvm::logAllUnhandledErrors(std::move(Err), llvm::errs(),
+                                  "Failed to remove auto-loaded symbols: ");
+  }
+
+private:
+  DynamicLibraryManager& m_DLM;
+  char m_GlobalPrefix;
+  std::mutex m_Mutex;
+  // The symbols defined from each auto-loaded library.
+  llvm::StringMap<std::vector<llvm::orc::SymbolStringPtr>> m_Defined;
+};
+
 /// CppInterOp Interpreter
 ///
 class Interpreter {
@@ -260,6 +353,8 @@ private:
   mutable std::unique_ptr<DynamicLibraryManager> sDLM;
   mutable std::once_flag sDLMInit;
   bool outOfProcess;
+  // Owned by the main JITDylib once added.
+  AutoLoadLibraryGenerator* m_AutoLoadGenerator = nullptr;
 
 public:
   Interpreter(std::unique_ptr<clang::Interpreter> CI,
@@ -621,6 +716,70 @@ public:
     return kMoreInputExpected;
   }
 
+  CompilationResult loadLibraries(const std::vector<std::string>& filenames,
+                                  bool lookup) {
+    llvm::Triple triple(getCompilerInstance()->getTargetOpts().Triple);
+    if (triple.isWasm()) {
+      CompilationResult Result = kSuccess;
+      for (const std::string& filename : filenames)
+        if (loadLibrary(filename, lookup) != kSuccess)
+          Result = kFailure;
+      return Result;
+    }
+
+    DynamicLibraryManager* DLM = getDynamicLibraryManager();
+    CompilationResult Result = kSuccess;
+    std::vector<std::string> libraries;
+    for (const std::string& filename : filenames) {
+      std::string library = lookup ? DLM->lookupLibrary(filename) : filename;
+      if (library.empty())
+        Result = kFailure;
+      else
+        libraries.push_back(std::move(library));
+    }
+    for (DynamicLibraryManager::LoadLibResult R :
+         DLM->loadLibraries(libraries, /*permanent*/ false))
+      if (R != DynamicLibraryManager::kLoadLibSuccess &&
+          R != DynamicLibraryManager::kLoadLibAlreadyLoaded)
+        Result = kFailure;
+    return Result;
+  }
+
+  ///\brief Makes references of JIT'd code to symbols which no loaded library
+  /// defines load the library on the search paths which does.
+  ///
+  ///\returns false if libraries cannot be loaded into the executor.
+  ///
+  bool setLibraryAutoLoading(bool Enable) {
+    llvm::Triple triple(getCompilerInstance()->getTargetOpts().Triple);
+    if (isOutOfProcess() || triple.isWasm())
+      return !Enable;
+
+    DynamicLibraryManager* DLM = getDynamicLibraryManager();
+    DLM->setAutoLoadLibraries(Enable);
+    if (Enable && !m_AutoLoadGenerator) {
+      llvm::orc::LLJIT* Jit = getExecutionEngine();
+      m_AutoLoadGenerator = &Jit->getMainJITDylib().addGenerator(
+          std::make_unique<AutoLoadLibraryGenerator>(
+              *DLM, Jit->getDataLayout().getGlobalPrefix()));
+    }
+    return true;
+  }
+
+  ///\brief Unloads the library lib_stem names, after removing the symbols
+  /// which automatic loading defined from it.
+  ///
+  void unloadLibrary(llvm::StringRef lib_stem) {
+    DynamicLibraryManager* DLM = getDynamicLibraryManager();
+    if (m_AutoLoadGenerator) {
+      std::string Library = DLM->lookupLibrary(lib_stem);
+      if (!Library.empty())
+        m_AutoLoadGenerator->forgetLibrary(
+            getExecutionEngine()->getMainJITDylib(), Library);
+    }
+    DLM->unloadLibrary(lib_stem);
+  }
+
   std::string toString(const char* type, void* obj) {
     assert(0 && "toString is not implemented!");
     std::string ret;
@@ -0,0 +1,168 @@
+//===--- DyldBloomFilter.h - bloom filters of the symbol search -*- C++ -*-===//
+//
+// Part of the compiler-research project, under the Apache License v2.0 with
+// LLVM Exceptions.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The bloom filters with which the shared library symbol search
+// (DynamicLibraryManagerSymbol.cpp) rules out libraries without reading their
+// symbol tables. Not part of the public API; kept in a header so that the
+// filter benchmark can measure the same code.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CPPINTEROP_DYLD_BLOOM_FILTER_H
+#define CPPINTEROP_DYLD_BLOOM_FILTER_H
+
+#include "llvm/ADT/StringRef.h"
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace CppInternal {
+
+/// The hash of the GNU dynamic linker (.gnu.hash), which the filters share
+/// with the ELF images.
+inline uint32_t GNUHash(llvm::StringRef S) {
+  uint32_t H = 5381;
+  for (uint8_t C : S)
+    H = (H << 5) + H + C;
+  return H;
+}
+
+/// A split block bloom filter: a symbol sets one bit in each of the eight
+/// 64-bit words of a single 64-byte, cache-line aligned block. A probe touches
+/// one cache line and its eight word tests are independent, so the compiler
+/// turns them into vector shifts and compares. At 10 bits per symbol the
+/// false-positive rate is about 1%.
+struct BloomFilter {
+  struct alignas(64) Block {
+    uint64_t Words[8];
+  };
+
+  /// The bit each of the words of a block must have set for a hash.
+  struct Mask {
+    uint64_t Words[8];
+  };
+
+  static constexpr unsigned kBitsPerSymbol = 10;
+
+  bool m_IsInitialized = false;
+  uint32_t m_SymbolsCount = 0;
+  std::vector<Block> m_Blocks;
+
+  static uint32_t GetNumBlocks(uint32_t SymbolsCount) {
+    return (uint64_t(SymbolsCount) * kBitsPerSymbol + 511) / 512;
+  }
+
+  static Mask GetMask(uint32_t Hash) {
+    static constexpr uint32_t Salts[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU,
+                                          0xa2b7289dU, 0x705495c7U, 0x2df1424bU,
+                                          0x9efc4947U, 0x5c6bfb31U};
+    // The block index takes the high bits of the hash; decorrelate the bit
+    // positions from it.
+    const uint32_t Key = Hash * 0x9E3779B1U;
+    Mask M;
+    for (unsigned I = 0; I < 8; ++I)
+      M.Words[I] = 1ULL << ((Key * Salts[I]) >> 26);
+    return M;
+  }
+
+  static uint32_t GetBlockIndex(uint32_t Hash, uint32_t NumBlocks) {
+    return (uint64_t(Hash) * NumBlocks) >> 32;
+  }
+
+  static bool TestBlock(const Block& B, const Mask& M) {
+    // No early exit: the eight tests compile to one vector compare.
+    uint64_t Missing = 0;
+    for (unsigned I = 0; I < 8; ++I)
+      Missing |= M.Words[I] & ~B.Words[I];
+    return !Missing;
+  }
+
+  bool TestHash(uint32_t Hash) const {
+    assert(m_IsInitialized && !m_Blocks.empty() && "Not yet initialized!");
+    return TestBlock(m_Blocks[GetBlockIndex(Hash, m_Blocks.size())],
+                     GetMask(Hash));
+  }
+
+  void AddHash(uint32_t Hash) {
+    assert(m_IsInitialized && !m_Blocks.empty() && "Not yet initialized!");
+    Block& B = m_Blocks[GetBlockIndex(Hash, m_Blocks.size())];
+    const Mask M = GetMask(Hash);
+    for (unsigned I = 0; I < 8; ++I)
+      B.Words[I] |= M.Words[I];
+  }
+
+  void ResizeTable(uint32_t newSymbolsCount) {
+    assert(m_SymbolsCount == 0 && "Not supported yet!");
+    m_SymbolsCount = newSymbolsCount;
+    m_Blocks.assign(GetNumBlocks(m_SymbolsCount), Block{});
+  }
+
+  /// The filter as words, in the layout of the persistent index.
+  const uint64_t* words() const { return m_Blocks.front().Words; }
+  uint64_t* words() { return m_Blocks.front().Words; }
+  size_t numWords() const { return m_Blocks.size() * 8; }
+};
+
+/// The bloom filters of a list of libraries laid out back to back, so that
+/// one hash is tested against all of them in a single pass: the mask is
+/// computed once, and the filters are walked through two parallel arrays of
+/// block offsets and counts.
+class BloomFilterSet {
+  std::vector<BloomFilter::Block> m_Blocks;
+  std::vector<uint32_t> m_FirstBlock;
+  std::vector<uint32_t> m_NumBlocks;
+
+public:
+  void clear() {
+    m_Blocks.clear();
+    m_FirstBlock.clear();
+    m_NumBlocks.clear();
+  }
+
+  /// Appends \p Filter, or if it is null a filter which never rules out.
+  void Add(const BloomFilter* Filter) {
+    m_FirstBlock.push_back(m_Blocks.size());
+    if (!Filter || !Filter->m_IsInitialized) {
+      BloomFilter::Block All;
+      for (uint64_t& W : All.Words)
+        W = ~0ULL;
+      m_Blocks.push_back(All);
+    } else if (Filter->m_Blocks.empty()) {
+      // No symbols: a cleared block rules out every hash.
+      m_Blocks.push_back(BloomFilter::Block{});
+    } else {
+      m_Blocks.insert(m_Blocks.end(), Filter->m_Blocks.begin(),
+                      Filter->m_Blocks.end());
+    }
+    m_NumBlocks.push_back(m_Blocks.size() - m_FirstBlock.back());
+  }
+
+  size_t size() const { return m_FirstBlock.size(); }
+
+  /// Stores in \p Candidates the indices, in order, of the filters which may
+  /// contain \p Hash.
+  void Probe(uint32_t Hash, std::vector<uint32_t>& Candidates) const {
+    const BloomFilter::Mask M = BloomFilter::GetMask(Hash);
+    const size_t N = size();
+    Candidates.resize(N);
+    size_t Found = 0;
+    for (size_t I = 0; I < N; ++I) {
+      const BloomFilter::Block& B =
+          m_Blocks[m_FirstBlock[I] +
+                   BloomFilter::GetBlockIndex(Hash, m_NumBlocks[I])];
+      Candidates[Found] = I;
+      Found += BloomFilter::TestBlock(B, M);
+    }
+    Candidates.resize(Found);
+  }
+};
+
+} // namespace CppInternal
+
+#endif // CPPINTEROP_DYLD_BLOOM_FILTER_H
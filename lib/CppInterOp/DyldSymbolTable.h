@@ -0,0 +1,129 @@
+//===--- DyldSymbolTable.h - symbol tables of the library search-*- C++ -*-===//
+//
+// Part of the compiler-research project, under the Apache License v2.0 with
+// LLVM Exceptions.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The per-library symbol tables with which the shared library symbol search
+// (DynamicLibraryManagerSymbol.cpp) confirms what the bloom filters let
+// through. Not part of the public API; kept in a header so that the symbol
+// table benchmark can measure the same code.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CPPINTEROP_DYLD_SYMBOL_TABLE_H
+#define CPPINTEROP_DYLD_SYMBOL_TABLE_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace CppInternal {
+
+/// The exact symbol table of a library in eight bytes per symbol: the GNU
+/// hash of each name and the offset of the name in the library image, sorted
+/// by hash. The names themselves stay in the string tables of the image, so
+/// a lookup which finds its hash compares the name against the image.
+/// A string set of the same symbols costs the names plus an entry and a
+/// bucket each, several times more for typical mangled names.
+class CompactSymbolTable {
+  struct Entry {
+    uint32_t Hash;
+    uint32_t Offset;
+    bool operator<(const Entry& Other) const {
+      return Hash < Other.Hash ||
+             (Hash == Other.Hash && Offset < Other.Offset);
+    }
+  };
+
+  std::vector<Entry> m_Entries;
+
+  auto EqualRange(uint32_t Hash) const {
+    return std::equal_range(
+        m_Entries.begin(), m_Entries.end(), Entry{Hash, 0},
+        [](const Entry& A, const Entry& B) { return A.Hash < B.Hash; });
+  }
+
+public:
+  /// Records \p Names, with their GNU hashes in \p Hashes, which must point
+  /// into \p Image.
+  ///\returns false, leaving the table empty, if a name is not a
+  /// NUL-terminated string inside the first 4GB of the image.
+  bool Build(llvm::StringRef Image, llvm::ArrayRef<llvm::StringRef> Names,
+             llvm::ArrayRef<uint32_t> Hashes) {
+    assert(Names.size() == Hashes.size() && "One hash per name!");
+    m_Entries.clear();
+    m_Entries.reserve(Names.size());
+    const char* Begin = Image.data();
+    const char* End = Image.data() + Image.size();
+    for (size_t I = 0, E = Names.size(); I < E; ++I) {
+      const char* Name = Names[I].data();
+      if (Name < Begin || Name + Names[I].size() >= End ||
+          Name[Names[I].size()] != '\0' ||
+          size_t(Name - Begin) > std::numeric_limits<uint32_t>::max()) {
+        m_Entries.clear();
+        m_Entries.shrink_to_fit();
+        return false;
+      }
+      m_Entries.push_back(Entry{Hashes[I], uint32_t(Name - Begin)});
+    }
+    std::sort(m_Entries.begin(), m_Entries.end());
+    // The same name may be listed twice, e.g. by .symtab and .dynsym.
+    m_Entries.erase(std::unique(m_Entries.begin(), m_Entries.end(),
+                                [](const Entry& A, const Entry& B) {
+                                  return A.Hash == B.Hash &&
+                                         A.Offset == B.Offset;
+                                }),
+                    m_Entries.end());
+    m_Entries.shrink_to_fit();
+    return true;
+  }
+
+  bool empty() const { return m_Entries.empty(); }
+  size_t size() const { return m_Entries.size(); }
+  size_t getMemorySize() const { return m_Entries.capacity() * sizeof(Entry); }
+
+  ///\returns true if a symbol with \p Hash may be in the table; only a
+  /// comparison against the image tells if it is the one looked for.
+  bool MayContain(uint32_t Hash) const {
+    auto Range = EqualRange(Hash);
+    return Range.first != Range.second;
+  }
+
+  ///\returns true if \p Name, with the GNU hash \p Hash, is in the table.
+  /// \p Image is the image of the library the table was built from. Offsets
+  /// beyond it, if the file changed since, do not match.
+  bool Contains(llvm::StringRef Name, uint32_t Hash,
+                llvm::StringRef Image) const {
+    auto Range = EqualRange(Hash);
+    for (auto I = Range.first; I != Range.second; ++I) {
+      const size_t Offset = I->Offset;
+      if (Offset + Name.size() >= Image.size())
+        continue;
+      const char* Candidate = Image.data() + Offset;
+      if (Candidate[Name.size()] == '\0' &&
+          !std::memcmp(Candidate, Name.data(), Name.size()))
+        return true;
+    }
+    return false;
+  }
+
+  /// Appends the distinct hashes of the symbols, in ascending order.
+  void AppendHashes(std::vector<uint32_t>& Out) const {
+    for (size_t I = 0, E = m_Entries.size(); I < E; ++I)
+      if (!I || m_Entries[I - 1].Hash != m_Entries[I].Hash)
+        Out.push_back(m_Entries[I].Hash);
+  }
+};
+
+} // namespace CppInternal
+
+#endif // CPPINTEROP_DYLD_SYMBOL_TABLE_H
@@ -11,6 +11,7 @@
 #include "Compatibility.h"
 #include "Paths.h"
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/BinaryFormat/Magic.h"
 #include "llvm/Support/Debug.h"
@@ -412,6 +413,9 @@ void DynamicLibraryManager::unloadLibrary(StringRef libStem) {
 
   m_DyLibs.erase(dyLibHandle);
   m_LoadedLibraries.erase(canonicalLoadedLib);
+  llvm::erase_if(m_AutoLoadedLibraries, [&](const AutoLoadedLibrary& L) {
+    return L.Library == canonicalLoadedLib;
+  });
 #undef DEBUG_TYPE
 }
 
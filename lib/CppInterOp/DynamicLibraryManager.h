@@ -17,6 +17,10 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Path.h"
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 namespace CppInternal {
 class Dyld;
 class InterpreterCallbacks;
@@ -51,6 +55,104 @@ public:
   };
   using SearchPathInfos = llvm::SmallVector<SearchPathInfo, 32>;
 
+  /// A library loaded because JIT'd code referred to one of its symbols.
+  struct AutoLoadedLibrary {
+    /// The full path of the library.
+    ///
+    std::string Library;
+
+    /// The symbol which triggered the load, as the JIT names it.
+    ///
+    std::string Symbol;
+  };
+
+  /// What searchLibrariesForSymbol did, per layer of the search. Times are
+  /// in nanoseconds. A filter "passes" a library when it cannot rule it out,
+  /// and "hits" when the library then turns out to define the symbol, so
+  /// Passed - Hits are its false positives. The search keeps them as
+  /// atomics, which it updates concurrently, and hands out plain copies.
+  template <typename Counter> struct SearchCounters {
+    Counter Searches{};
+    Counter SearchNs{};
+    /// Scans of the search paths (or restores of their persistent index).
+    Counter Scans{};
+    Counter ScanNs{};
+    Counter ScannedLibraries{};
+    /// Library images opened, for the scan as well as the search.
+    Counter ObjectOpens{};
+    Counter ObjectOpenNs{};
+    /// The .gnu.hash bloom filters of ELF libraries.
+    Counter GnuHashProbes{};
+    Counter GnuHashPassed{};
+    Counter GnuHashHits{};
+    /// The bloom filters of all libraries probed together.
+    Counter FilterSetProbes{};
+    Counter FilterSetPassed{};
+    Counter FilterSetHits{};
+    /// The bloom filter of a single library.
+    Counter BloomBuilds{};
+    Counter BloomBuildNs{};
+    Counter BloomProbes{};
+    Counter BloomPassed{};
+    Counter BloomHits{};
+    /// The reverse index from symbol hashes to libraries.
+    Counter SymbolIndexLookups{};
+    Counter SymbolIndexCandidates{};
+    Counter SymbolIndexHits{};
+    /// The exact per-library symbol tables.
+    Counter HashTableBuilds{};
+    Counter HashTableBuildNs{};
+    /// Bytes of the tables built, as hashes and offsets into the images.
+    /// Like the other counters it only grows; tables since dropped, e.g.
+    /// of removed libraries, are still counted.
+    Counter HashTableBytesBuilt{};
+    Counter HashTableLookups{};
+    Counter HashTableHits{};
+    /// Linear walks over the symbols of a library.
+    Counter SymbolIterations{};
+    Counter SymbolIterationNs{};
+    Counter SymbolIterationHits{};
+
+    /// Calls \p F with the name and value of each counter.
+    template <typename Fn> void forEach(Fn F) const { visit(*this, F); }
+    template <typename Fn> void forEach(Fn F) { visit(*this, F); }
+
+  private:
+    template <typename Self, typename Fn> static void visit(Self& S, Fn& F) {
+      F("searches", S.Searches);
+      F("search_ns", S.SearchNs);
+      F("scans", S.Scans);
+      F("scan_ns", S.ScanNs);
+      F("scanned_libraries", S.ScannedLibraries);
+      F("object_opens", S.ObjectOpens);
+      F("object_open_ns", S.ObjectOpenNs);
+      F("gnu_hash_probes", S.GnuHashProbes);
+      F("gnu_hash_passed", S.GnuHashPassed);
+      F("gnu_hash_hits", S.GnuHashHits);
+      F("filter_set_probes", S.FilterSetProbes);
+      F("filter_set_passed", S.FilterSetPassed);
+      F("filter_set_hits", S.FilterSetHits);
+      F("bloom_builds", S.BloomBuilds);
+      F("bloom_build_ns", S.BloomBuildNs);
+      F("bloom_probes", S.BloomProbes);
+      F("bloom_passed", S.BloomPassed);
+      F("bloom_hits", S.BloomHits);
+      F("symbol_index_lookups", S.SymbolIndexLookups);
+      F("symbol_index_candidates", S.SymbolIndexCandidates);
+      F("symbol_index_hits", S.SymbolIndexHits);
+      F("hash_table_builds", S.HashTableBuilds);
+      F("hash_table_build_ns", S.HashTableBuildNs);
+      F("hash_table_bytes_built", S.HashTableBytesBuilt);
+      F("hash_table_lookups", S.HashTableLookups);
+      F("hash_table_hits", S.HashTableHits);
+      F("symbol_iterations", S.SymbolIterations);
+      F("symbol_iteration_ns", S.SymbolIterationNs);
+      F("symbol_iteration_hits", S.SymbolIterationHits);
+    }
+  };
+  /// A snapshot of the counters.
+  using SearchStats = SearchCounters<uint64_t>;
+
 private:
   typedef void* DyLibHandle;
   typedef llvm::DenseMap<DyLibHandle, std::string> DyLibs;
@@ -67,6 +169,33 @@ private:
 
   Dyld* m_Dyld = nullptr;
 
+  ///\brief Upper bound, in bytes, of the library images which the symbol
+  /// search keeps mapped between queries.
+  ///
+  size_t m_MappingBudget = 256 * 1024 * 1024;
+
+  ///\brief Directory of the persistent symbol search indexes; empty if they
+  /// are disabled.
+  ///
+  std::string m_IndexDirectory;
+  bool m_IndexSymbolHashes = false;
+
+  ///\brief Whether the symbol search consults a reverse index from symbol
+  /// hashes to libraries instead of walking every library.
+  ///
+  bool m_UseSymbolIndex = false;
+
+  ///\brief Whether JIT'd code referring to a symbol of a not-yet-loaded
+  /// library loads it.
+  ///
+  bool m_AutoLoadLibraries = false;
+  std::vector<AutoLoadedLibrary> m_AutoLoadedLibraries;
+
+  ///\brief Whether the symbol search watches the scanned directories and
+  /// applies the changes to them instead of keeping its first scan.
+  ///
+  bool m_WatchSearchPaths = false;
+
   ///\brief Concatenates current include paths and the system include paths
   /// and performs a lookup for the filename.
   /// See more information for RPATH and RUNPATH:
@@ -171,6 +300,20 @@ public:
   LoadLibResult loadLibrary(llvm::StringRef, bool permanent,
                             bool resolved = false);
 
+  ///\brief Loads the shared libraries Libs, each like loadLibrary with a
+  /// resolved path. Their dependency graph is read first, and the files of
+  /// each of its levels are read ahead in parallel, so that the dynamic
+  /// loader finds them in the page cache. Each library is then loaded after
+  /// the ones of Libs it depends on.
+  ///
+  ///\param [in] Libs - The resolved paths of the libraries to load.
+  ///\param [in] permanent - If false, the files can be unloaded later.
+  ///
+  ///\returns the result of loading each of Libs, in order.
+  ///
+  std::vector<LoadLibResult> loadLibraries(llvm::ArrayRef<std::string> Libs,
+                                           bool permanent);
+
   void unloadLibrary(llvm::StringRef libStem);
 
   ///\brief Returns true if the file was a dynamic library and it was already
@@ -197,6 +340,96 @@ public:
   std::string searchLibrariesForSymbol(llvm::StringRef mangledName,
                                        bool searchSystem = true) const;
 
+  ///\brief Finds the first not-yet-loaded shared object for each symbol,
+  /// paying the per-search bookkeeping once for the whole batch.
+  ///
+  ///\param[in] mangledNames - the mangled names to look for.
+  ///\param[in] searchSystem - whether to descend into system libraries.
+  ///
+  ///\returns the library name for each symbol, empty if it was not found.
+  ///
+  std::vector<std::string>
+  searchLibrariesForSymbols(llvm::ArrayRef<llvm::StringRef> mangledNames,
+                            bool searchSystem = true) const;
+
+  ///\brief Makes the symbol search build a reverse index from the hashes of
+  /// the exported symbols to the libraries exporting them, the first time a
+  /// set of libraries is searched. Each lookup then only confirms the few
+  /// libraries sharing the hash of the symbol.
+  ///
+  void setUseSymbolIndex(bool Use) { m_UseSymbolIndex = Use; }
+  bool useSymbolIndex() const { return m_UseSymbolIndex; }
+
+  ///\brief Makes unresolved symbols of JIT'd code load the library defining
+  /// them. The interpreter installs the JIT hook; this only switches it.
+  ///
+  void setAutoLoadLibraries(bool AutoLoad) { m_AutoLoadLibraries = AutoLoad; }
+  bool autoLoadLibraries() const { return m_AutoLoadLibraries; }
+
+  ///\brief Records that Library was loaded to resolve Symbol.
+  ///
+  void addAutoLoadedLibrary(llvm::StringRef Library, llvm::StringRef Symbol) {
+    m_AutoLoadedLibraries.push_back({Library.str(), Symbol.str()});
+  }
+
+  ///\brief The libraries loaded to resolve symbols of JIT'd code and not
+  /// unloaded since, in load order, each with the symbol which triggered the
+  /// load.
+  ///
+  const std::vector<AutoLoadedLibrary>& getAutoLoadedLibraries() const {
+    return m_AutoLoadedLibraries;
+  }
+
+  ///\brief Makes searchLibrariesForSymbol watch the directories it scanned
+  /// (inotify) and, before each search, register or forget only the
+  /// libraries which were created, replaced or removed there since.
+  ///
+  ///\returns false if watching is not supported on this platform.
+  ///
+  bool setWatchSearchPaths(bool Watch);
+  bool watchSearchPaths() const { return m_WatchSearchPaths; }
+
+  ///\brief Returns how many times searchLibrariesForSymbol applied changes
+  /// seen by the directory watches, each of which would otherwise need a
+  /// rescan to be noticed.
+  ///
+  size_t getRescansAvoided() const;
+
+  ///\brief Returns what searchLibrariesForSymbol did so far, per layer.
+  ///
+  SearchStats getSearchStats() const;
+  void resetSearchStats();
+
+  ///\brief Returns how many bytes of library images searchLibrariesForSymbol
+  /// may keep mapped between queries.
+  ///
+  size_t getMappingBudget() const { return m_MappingBudget; }
+
+  ///\brief Bounds the library images kept mapped by searchLibrariesForSymbol.
+  /// The least recently queried images are unmapped first; 0 unmaps each
+  /// image as soon as another one is needed.
+  ///
+  ///\param[in] Bytes - the total size of the images which may stay mapped.
+  ///
+  void setMappingBudget(size_t Bytes);
+
+  ///\brief Makes searchLibrariesForSymbol keep a persistent index of the
+  /// libraries found on the search paths and of their bloom filters in Dir,
+  /// one file per set of search paths. A later process restores the index
+  /// instead of scanning if no recorded library or directory changed.
+  /// Takes effect for the scans which have not happened yet.
+  ///
+  ///\param[in] Dir - the index directory; empty disables the index.
+  ///\param[in] WithSymbolHashes - also record the hashes of the exported
+  ///            symbols, which rules out false positives of the filters.
+  ///
+  void setIndexDirectory(llvm::StringRef Dir, bool WithSymbolHashes = false) {
+    m_IndexDirectory = Dir.str();
+    m_IndexSymbolHashes = WithSymbolHashes;
+  }
+  const std::string& getIndexDirectory() const { return m_IndexDirectory; }
+  bool indexSymbolHashes() const { return m_IndexSymbolHashes; }
+
   void dump(llvm::raw_ostream* S = nullptr) const;
 
   /// On a success returns to full path to a shared object that holds the
@@ -9,10 +9,15 @@
 //------------------------------------------------------------------------------
 
 #include "DynamicLibraryManager.h"
+#include "DyldBloomFilter.h"
+#include "DyldSymbolTable.h"
 #include "Paths.h"
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/StringSet.h"
@@ -20,6 +25,7 @@
 #include "llvm/Object/COFF.h"
 #include "llvm/Object/ELF.h"
 #include "llvm/Object/ELFObjectFile.h"
+#include "llvm/Object/BuildID.h"
 #include "llvm/Object/MachO.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/Debug.h"
@@ -27,22 +33,37 @@
 #include "llvm/Support/Error.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/WithColor.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <limits>
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_set>
 #include <vector>
 
 #ifdef LLVM_ON_UNIX
 #include <dlfcn.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #endif // LLVM_ON_UNIX
 
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif // __linux__
+
 #ifdef __APPLE__
 #include <mach-o/dyld.h>
 #include <sys/stat.h>
@@ -65,67 +86,39 @@ namespace {
 using BasePath = std::string;
 using namespace llvm;
 
-// This is a GNU implementation of hash used in bloom filter!
-static uint32_t GNUHash(StringRef S) {
-  uint32_t H = 5381;
-  for (uint8_t C : S)
-    H = (H << 5) + H + C;
-  return H;
-}
-
-constexpr uint32_t log2u(std::uint32_t n) {
-  return (n > 1) ? 1 + log2u(n >> 1) : 0;
-}
-
-struct BloomFilter {
-
-  // https://hur.st/bloomfilter
-  //
-  // n = ceil(m / (-k / log(1 - exp(log(p) / k))))
-  // p = pow(1 - exp(-k / (m / n)), k)
-  // m = ceil((n * log(p)) / log(1 / pow(2, log(2))));
-  // k = round((m / n) * log(2));
-  //
-  // n = symbolsCount
-  // p = 0.02
-  // k = 2 (k1=GNUHash and k2=GNUHash >> bloomShift)
-  // m = ceil((symbolsCount * log(p)) / log(1 / pow(2, log(2))));
-  // bloomShift = min(5 for bits=32 or 6 for bits=64, log2(symbolsCount))
-  // bloomSize = ceil((-1.44 * n * log2f(p)) / bits)
-
-  const int m_Bits = 8 * sizeof(uint64_t);
-  const float m_P = 0.02f;
+using CppInternal::BloomFilter;
+using CppInternal::BloomFilterSet;
+using CppInternal::GNUHash;
 
+/// The bloom filter of an ELF library's .gnu.hash section, copied out of the
+/// image so that a negative lookup reads neither the file nor its mapping.
+///
+/// Bloom filter is a stochastic data structure which can tell us if a symbol
+/// name does not exist in a library with 100% certainty. If it tells us it
+/// exists this may not be true:
+/// https://blogs.oracle.com/solaris/gnu-hash-elf-sections-v2
+///
+/// ELF has this optimization in the new linkers by default, It is stored in the
+/// gnu.hash section of the object file.
+struct ElfGnuHashFilter {
   bool m_IsInitialized = false;
-  uint32_t m_SymbolsCount = 0;
-  uint32_t m_BloomSize = 0;
-  uint32_t m_BloomShift = 0;
-  std::vector<uint64_t> m_BloomTable;
-
-  bool TestHash(uint32_t hash) const {
-    // This function is superhot. No branches here, breaks inlining and makes
-    // overall performance around 4x slower.
-    assert(m_IsInitialized && "Not yet initialized!");
-    uint32_t hash2 = hash >> m_BloomShift;
-    uint32_t n = (hash >> log2u(m_Bits)) % m_BloomSize;
-    uint64_t mask = ((1ULL << (hash % m_Bits)) | (1ULL << (hash2 % m_Bits)));
-    return (mask & m_BloomTable[n]) == mask;
-  }
-
-  void AddHash(uint32_t hash) {
+  // The platform bitness of the library -- either 64 or 32.
+  uint32_t m_Bits = 0;
+  uint32_t m_Shift2 = 0;
+  // Empty if the library has no usable .gnu.hash section.
+  std::vector<uint64_t> m_Words;
+
+  ///\returns true if the symbol may be in the library.
+  bool MayExist(uint32_t hash) const {
     assert(m_IsInitialized && "Not yet initialized!");
-    uint32_t hash2 = hash >> m_BloomShift;
-    uint32_t n = (hash >> log2u(m_Bits)) % m_BloomSize;
-    uint64_t mask = ((1ULL << (hash % m_Bits)) | (1ULL << (hash2 % m_Bits)));
-    m_BloomTable[n] |= mask;
-  }
+    // We need to search if the library doesn't have .gnu.hash section!
+    if (m_Words.empty())
+      return true;
 
-  void ResizeTable(uint32_t newSymbolsCount) {
-    assert(m_SymbolsCount == 0 && "Not supported yet!");
-    m_SymbolsCount = newSymbolsCount;
-    m_BloomSize = ceil((-1.44f * m_SymbolsCount * log2f(m_P)) / m_Bits);
-    m_BloomShift = std::min(6u, log2u(m_SymbolsCount));
-    m_BloomTable.resize(m_BloomSize);
+    uint32_t hash2 = hash >> m_Shift2;
+    uint32_t n = (hash / m_Bits) % m_Words.size();
+    uint64_t bitmask = ((1ULL << (hash % m_Bits)) | (1ULL << (hash2 % m_Bits)));
+    return (bitmask & m_Words[n]) == bitmask;
   }
 };
 
@@ -141,7 +134,21 @@ struct LibraryPath {
   const BasePath& m_Path;
   std::string m_LibName;
   BloomFilter m_Filter;
+  ElfGnuHashFilter m_GnuHash;
+  // The symbols of the library, compactly as offsets into its image. Names
+  // which could not be located in the image are copied into m_Symbols
+  // instead.
+  CompactSymbolTable m_SymbolTable;
   StringSet<> m_Symbols;
+  // False until m_SymbolTable or m_Symbols holds the symbols of the library.
+  // Libraries restored from a persistent index get their filters but no
+  // symbol table.
+  bool m_SymbolsLoaded = false;
+  // The sorted GNU hashes of the symbols, if the persistent index the library
+  // was restored from recorded them. Points into the mapped index.
+  ArrayRef<uint32_t> m_SymbolHashes;
+  // The hex build-id of the image the filters were built from, if any.
+  std::string m_BuildId;
   // std::vector<const LibraryPath*> m_LibDeps;
 
   LibraryPath(const BasePath& Path, const std::string& LibName)
@@ -158,11 +165,36 @@ struct LibraryPath {
     return Vec.str().str();
   }
 
-  void AddBloom(StringRef symbol) { m_Filter.AddHash(GNUHash(symbol)); }
+  void AddBloom(uint32_t hash) { m_Filter.AddHash(hash); }
+
+  /// Records \p Symbols, with their GNU hashes in \p Hashes, as the symbol
+  /// table of the library. \p Image is the image they were read from.
+  ///\returns the bytes the table takes.
+  size_t SetSymbols(StringRef Image, ArrayRef<StringRef> Symbols,
+                    ArrayRef<uint32_t> Hashes) {
+    m_SymbolsLoaded = true;
+    if (m_SymbolTable.Build(Image, Symbols, Hashes))
+      return m_SymbolTable.getMemorySize();
+    // An entry per name and a bucket with the full hash per slot.
+    size_t Size = 0;
+    for (StringRef S : Symbols)
+      if (m_Symbols.insert(S).second)
+        Size += sizeof(StringMapEntryBase) + S.size() + 1;
+    return Size +
+           m_Symbols.getNumBuckets() * (sizeof(void*) + sizeof(unsigned));
+  }
 
-  StringRef AddSymbol(const std::string& symbol) {
-    auto it = m_Symbols.insert(symbol);
-    return it.first->getKey();
+  /// Appends the distinct GNU hashes of the symbol table, in ascending order.
+  void AppendSymbolHashes(std::vector<uint32_t>& Out) const {
+    if (m_Symbols.empty()) {
+      m_SymbolTable.AppendHashes(Out);
+      return;
+    }
+    const size_t First = Out.size();
+    for (const auto& S : m_Symbols)
+      Out.push_back(GNUHash(S.getKey()));
+    std::sort(Out.begin() + First, Out.end());
+    Out.erase(std::unique(Out.begin() + First, Out.end()), Out.end());
   }
 
   bool hasBloomFilter() const { return m_Filter.m_IsInitialized; }
@@ -187,8 +219,16 @@ struct LibraryPath {
     return m_Filter.TestHash(hash);
   }
 
-  bool ExistSymbol(StringRef symbol) const {
-    return m_Symbols.find(symbol) != m_Symbols.end();
+  ///\returns true if ExistSymbol needs the image of the library to tell if
+  /// a symbol with \p hash is there.
+  bool NeedsImageToConfirm(uint32_t hash) const {
+    return m_Symbols.empty() && m_SymbolTable.MayContain(hash);
+  }
+
+  bool ExistSymbol(StringRef symbol, uint32_t hash, StringRef Image) const {
+    if (!m_Symbols.empty())
+      return m_Symbols.find(symbol) != m_Symbols.end();
+    return m_SymbolTable.Contains(symbol, hash, Image);
   }
 };
 
@@ -221,12 +261,24 @@ public:
   }
 
   const LibraryPath* RegisterLib(const LibraryPath& Lib) {
+    return RegisterLibAt(Lib, m_Libs.size());
+  }
+
+  /// Registers \p Lib at \p Pos in the search order instead of last.
+  const LibraryPath* RegisterLibAt(const LibraryPath& Lib, size_t Pos) {
     auto it = m_LibsH.insert(Lib);
     assert(it.second && "Already registered!");
-    m_Libs.push_back(&*it.first);
+    m_Libs.insert(m_Libs.begin() + std::min(Pos, m_Libs.size()), &*it.first);
     return &*it.first;
   }
 
+  ///\returns the position of \p Lib in the search order, or size() if it is
+  /// not registered.
+  size_t GetPosition(const LibraryPath& Lib) const {
+    const LibraryPath* Registered = GetRegisteredLib(Lib);
+    return std::find(m_Libs.begin(), m_Libs.end(), Registered) - m_Libs.begin();
+  }
+
   void UnregisterLib(const LibraryPath& Lib) {
     auto found = m_LibsH.find(Lib);
     if (found == m_LibsH.end())
@@ -244,40 +296,153 @@ public:
   const std::vector<const LibraryPath*>& GetLibraries() const { return m_Libs; }
 };
 
+/// A reverse index from the GNU hash of every symbol exported by the scanned
+/// libraries to the libraries exporting a symbol with that hash. The distinct
+/// hashes live in an open-addressing table whose slots point at runs of
+/// library ids, sorted in search order. A lookup is one probe sequence; the
+/// candidates it returns still need to be confirmed by name.
+class SymbolHashIndex {
+  struct Slot {
+    uint32_t Hash;
+    uint32_t Begin;
+    uint32_t Count; // 0 for an empty slot.
+  };
+
+  std::vector<Slot> m_Slots;
+  std::vector<uint32_t> m_LibIds;
+  // Library ids to libraries; null once a library is forgotten.
+  std::vector<const LibraryPath*> m_Libs;
+  size_t m_NumUser = 0;
+  size_t m_NumHashes = 0;
+  bool m_WithSystem = false;
+
+  static size_t Mix(uint32_t Hash) {
+    // GNU hashes of similar names differ mostly in their low bits.
+    return (uint64_t(Hash) * 0x9E3779B97F4A7C15ull) >> 32;
+  }
+
+public:
+  /// Indexes \p Libs, of which the first \p NumUser are user libraries and
+  /// the rest the system ones if \p WithSystem; \p Hashes[i] are the symbol
+  /// hashes of \p Libs[i].
+  void Build(std::vector<const LibraryPath*> Libs, size_t NumUser,
+             bool WithSystem,
+             const std::vector<std::vector<uint32_t>>& Hashes) {
+    std::vector<std::pair<uint32_t, uint32_t>> Pairs;
+    size_t Total = 0;
+    for (const std::vector<uint32_t>& H : Hashes)
+      Total += H.size();
+    Pairs.reserve(Total);
+    for (uint32_t Id = 0; Id < Hashes.size(); ++Id)
+      for (uint32_t H : Hashes[Id])
+        Pairs.emplace_back(H, Id);
+    llvm::sort(Pairs);
+    Pairs.erase(std::unique(Pairs.begin(), Pairs.end()), Pairs.end());
+
+    m_NumHashes = 0;
+    for (size_t I = 0; I < Pairs.size(); ++I)
+      if (!I || Pairs[I].first != Pairs[I - 1].first)
+        ++m_NumHashes;
+
+    // Keep the load factor at or below one half.
+    m_Slots.assign(llvm::NextPowerOf2(2 * m_NumHashes), Slot{0, 0, 0});
+    m_LibIds.resize(Pairs.size());
+    const size_t Mask = m_Slots.size() - 1;
+    for (size_t I = 0; I < Pairs.size();) {
+      const uint32_t Hash = Pairs[I].first;
+      const uint32_t Begin = I;
+      for (; I < Pairs.size() && Pairs[I].first == Hash; ++I)
+        m_LibIds[I] = Pairs[I].second;
+      size_t Pos = Mix(Hash) & Mask;
+      while (m_Slots[Pos].Count)
+        Pos = (Pos + 1) & Mask;
+      m_Slots[Pos] = Slot{Hash, Begin, static_cast<uint32_t>(I - Begin)};
+    }
+    m_Libs = std::move(Libs);
+    m_NumUser = NumUser;
+    m_WithSystem = WithSystem;
+  }
+
+  /// The ids of the libraries which may contain a symbol with \p Hash, in
+  /// search order.
+  ArrayRef<uint32_t> Lookup(uint32_t Hash) const {
+    if (m_Slots.empty())
+      return {};
+    const size_t Mask = m_Slots.size() - 1;
+    for (size_t Pos = Mix(Hash) & Mask; m_Slots[Pos].Count;
+         Pos = (Pos + 1) & Mask)
+      if (m_Slots[Pos].Hash == Hash)
+        return ArrayRef<uint32_t>(m_LibIds).slice(m_Slots[Pos].Begin,
+                                                  m_Slots[Pos].Count);
+    return {};
+  }
+
+  const LibraryPath* GetLibrary(uint32_t Id) const { return m_Libs[Id]; }
+
+  /// Drops \p Lib, which is about to be unregistered, from the results.
+  void Forget(const LibraryPath* Lib) {
+    auto It = std::find(m_Libs.begin(), m_Libs.end(), Lib);
+    if (It != m_Libs.end())
+      *It = nullptr;
+  }
+
+  size_t NumUser() const { return m_NumUser; }
+  bool HasSystem() const { return m_WithSystem; }
+  size_t size() const { return m_NumHashes; }
+};
+
+// The caches below are shared by the threads of a parallel library scan. The
+// locks are not held across the system calls; two threads may then both miss
+// and the first insertion wins. StringMap entries do not move on rehashing, so
+// references into them stay valid after the lock is released, until
+// invalidate_path_caches drops them.
+static StringMap<std::pair<std::string, int>> realpath_cache;
+static std::mutex realpath_mutex;
+
 #ifndef _WIN32
+static StringMap<mode_t> lstat_cache;
+static std::mutex lstat_mutex;
+static StringMap<std::string> readlink_cache;
+static std::mutex readlink_mutex;
+
 // Cached version of system function lstat
 static inline mode_t cached_lstat(const char* path) {
-  static StringMap<mode_t> lstat_cache;
 
   // If already cached - return cached result
-  auto it = lstat_cache.find(path);
-  if (it != lstat_cache.end())
-    return it->second;
+  {
+    std::lock_guard<std::mutex> Lock(lstat_mutex);
+    auto it = lstat_cache.find(path);
+    if (it != lstat_cache.end())
+      return it->second;
+  }
 
   // If result not in cache - call system function and cache result
   struct stat buf;
   mode_t st_mode = (lstat(path, &buf) == -1) ? 0 : buf.st_mode;
+  std::lock_guard<std::mutex> Lock(lstat_mutex);
   lstat_cache.insert(std::pair<StringRef, mode_t>(path, st_mode));
   return st_mode;
 }
 
 // Cached version of system function readlink
 static inline StringRef cached_readlink(const char* pathname) {
-  static StringMap<std::string> readlink_cache;
 
   // If already cached - return cached result
-  auto it = readlink_cache.find(pathname);
-  if (it != readlink_cache.end())
-    return StringRef(it->second);
+  {
+    std::lock_guard<std::mutex> Lock(readlink_mutex);
+    auto it = readlink_cache.find(pathname);
+    if (it != readlink_cache.end())
+      return StringRef(it->second);
+  }
 
   // If result not in cache - call system function and cache result
   char buf[PATH_MAX];
   ssize_t len;
-  if ((len = readlink(pathname, buf, sizeof(buf))) != -1) {
+  if ((len = readlink(pathname, buf, sizeof(buf) - 1)) != -1) {
     buf[len] = '\0';
-    std::string s(buf);
-    readlink_cache.insert(std::pair<StringRef, std::string>(pathname, s));
-    return readlink_cache[pathname];
+    std::lock_guard<std::mutex> Lock(readlink_mutex);
+    auto it = readlink_cache.try_emplace(pathname, buf).first;
+    return StringRef(it->second);
   }
   return "";
 }
@@ -298,11 +463,11 @@ std::string cached_realpath(StringRef path, StringRef base_path = "",
   }
 
   // If already cached - return cached result
-  static StringMap<std::pair<std::string, int>> cache;
   bool relative_path = llvm::sys::path::is_relative(path);
   if (!relative_path) {
-    auto it = cache.find(path);
-    if (it != cache.end()) {
+    std::lock_guard<std::mutex> Lock(realpath_mutex);
+    auto it = realpath_cache.find(path);
+    if (it != realpath_cache.end()) {
       errno = it->second.second;
       return it->second.first;
     }
@@ -322,14 +487,18 @@ std::string cached_realpath(StringRef path, StringRef base_path = "",
     } else {
       if (path[0] == '~' &&
           (path.size() == 1 || llvm::sys::path::is_separator(path[1]))) {
-        static SmallString<128> home;
-        if (home.str().empty())
+        static const SmallString<128> home = [] {
+          SmallString<128> home;
           llvm::sys::path::home_directory(home);
+          return home;
+        }();
         StringRef(home).split(p, sep, /*MaxSplit*/ -1, /*KeepEmpty*/ false);
       } else if (base_path.empty()) {
-        static SmallString<256> current_path;
-        if (current_path.str().empty())
+        static const SmallString<256> current_path = [] {
+          SmallString<256> current_path;
           llvm::sys::fs::current_path(current_path);
+          return current_path;
+        }();
         StringRef(current_path)
             .split(p, sep, /*MaxSplit*/ -1, /*KeepEmpty*/ false);
       } else {
@@ -365,7 +534,8 @@ std::string cached_realpath(StringRef path, StringRef base_path = "",
         result = cached_realpath(symlink, "", true, symlooplevel - 1);
       }
     } else if (st_mode == 0) {
-      cache.insert(std::pair<StringRef, std::pair<std::string, int>>(
+      std::lock_guard<std::mutex> Lock(realpath_mutex);
+      realpath_cache.insert(std::pair<StringRef, std::pair<std::string, int>>(
           path, std::pair<std::string, int>("", ENOENT)));
       errno = ENOENT;
       return "";
@@ -374,11 +544,50 @@ std::string cached_realpath(StringRef path, StringRef base_path = "",
 #else
   llvm::sys::fs::real_path(path, result);
 #endif
-  cache.insert(std::pair<StringRef, std::pair<std::string, int>>(
-      path, std::pair<std::string, int>(result.str().str(), errno)));
+  int saved_errno = errno;
+  std::lock_guard<std::mutex> Lock(realpath_mutex);
+  realpath_cache.insert(std::pair<StringRef, std::pair<std::string, int>>(
+      path, std::pair<std::string, int>(result.str().str(), saved_errno)));
+  errno = saved_errno;
   return result.str().str();
 }
 
+/// Drops the cached lstat, readlink and realpath results of \p path and of
+/// the paths below it, and the realpath results which resolve into them.
+/// Must not race with a scan: it invalidates the references handed out.
+static void invalidate_path_caches(StringRef path) {
+  auto Affects = [path](StringRef Other) {
+    // An empty path drops everything.
+    return path.empty() ||
+           (Other.consume_front(path) &&
+            (Other.empty() || llvm::sys::path::is_separator(Other.front())));
+  };
+  auto EraseIf = [](auto& Cache, auto Pred) {
+    for (auto It = Cache.begin(), End = Cache.end(); It != End;) {
+      auto Cur = It++;
+      if (Pred(*Cur))
+        Cache.erase(Cur);
+    }
+  };
+  {
+    std::lock_guard<std::mutex> Lock(realpath_mutex);
+    EraseIf(realpath_cache, [&](const auto& E) {
+      return Affects(E.getKey()) || Affects(E.getValue().first);
+    });
+  }
+#ifndef _WIN32
+  {
+    std::lock_guard<std::mutex> Lock(lstat_mutex);
+    EraseIf(lstat_cache, [&](const auto& E) { return Affects(E.getKey()); });
+  }
+  {
+    std::lock_guard<std::mutex> Lock(readlink_mutex);
+    EraseIf(readlink_cache,
+            [&](const auto& E) { return Affects(E.getKey()); });
+  }
+#endif
+}
+
 using namespace llvm;
 using namespace llvm::object;
 
@@ -420,40 +629,204 @@ static StringRef GetGnuHashSection(llvm::object::ObjectFile* file) {
   return "";
 }
 
-/// Bloom filter is a stochastic data structure which can tell us if a symbol
-/// name does not exist in a library with 100% certainty. If it tells us it
-/// exists this may not be true:
-/// https://blogs.oracle.com/solaris/gnu-hash-elf-sections-v2
-///
-/// ELF has this optimization in the new linkers by default, It is stored in the
-/// gnu.hash section of the object file.
-///
-///\returns true if the symbol may be in the library.
-static bool MayExistInElfObjectFile(llvm::object::ObjectFile* soFile,
-                                    uint32_t hash) {
+/// Copies the bloom filter words of the .gnu.hash section of \p soFile into
+/// \p Filter.
+static void ReadElfGnuHashFilter(llvm::object::ObjectFile* soFile,
+                                 ElfGnuHashFilter& Filter) {
   assert(soFile->isELF() && "Not ELF");
-
-  // Compute the platform bitness -- either 64 or 32.
-  const unsigned bits = 8 * soFile->getBytesInAddress();
+  Filter.m_IsInitialized = true;
+  Filter.m_Bits = 8 * soFile->getBytesInAddress();
+  Filter.m_Words.clear();
 
   StringRef contents = GetGnuHashSection(soFile);
   if (contents.size() < 16)
-    // We need to search if the library doesn't have .gnu.hash section!
-    return true;
+    return;
   const char* hashContent = contents.data();
 
   // See https://flapenguin.me/2017/05/10/elf-lookup-dt-gnu-hash/ for .gnu.hash
   // table layout.
   uint32_t maskWords = *reinterpret_cast<const uint32_t*>(hashContent + 8);
-  uint32_t shift2 = *reinterpret_cast<const uint32_t*>(hashContent + 12);
-  uint32_t hash2 = hash >> shift2;
-  uint32_t n = (hash / bits) % maskWords;
+  Filter.m_Shift2 = *reinterpret_cast<const uint32_t*>(hashContent + 12);
+  const size_t wordSize = Filter.m_Bits / 8;
+  if (!maskWords || contents.size() < 16 + maskWords * wordSize)
+    return;
 
   const char* bloomfilter = hashContent + 16;
-  const char* hash_pos = bloomfilter + n * (bits / 8); // * (Bits / 8)
-  uint64_t word = *reinterpret_cast<const uint64_t*>(hash_pos);
-  uint64_t bitmask = ((1ULL << (hash % bits)) | (1ULL << (hash2 % bits)));
-  return (bitmask & word) == bitmask;
+  Filter.m_Words.resize(maskWords);
+  for (uint32_t i = 0; i < maskWords; ++i) {
+    const char* hash_pos = bloomfilter + i * wordSize;
+    if (wordSize == 8)
+      Filter.m_Words[i] = *reinterpret_cast<const uint64_t*>(hash_pos);
+    else
+      Filter.m_Words[i] = *reinterpret_cast<const uint32_t*>(hash_pos);
+  }
+}
+
+// The persistent Dyld index: the libraries found by one scan of a set of
+// search paths together with their filters, so that the next process can skip
+// the scan and the symbol table reads.
+//
+// The file is a header followed by 8-byte aligned arrays of the fixed-size
+// records below. Strings are offsets into a NUL-terminated string table whose
+// first entry is "". The libraries are stored in registration order, which is
+// the order in which they are searched.
+constexpr char kDyldIndexMagic[8] = "CPPIDLI";
+// Version 2 stores the blocked bloom filters, version 3 the search paths
+// which were absent.
+constexpr uint32_t kDyldIndexVersion = 3;
+
+struct DyldIndexHeader {
+  char Magic[8];
+  uint32_t Version;
+  uint32_t PointerSize;
+  uint32_t NumDirs;
+  uint32_t NumLibs;
+  uint32_t NumWords;
+  uint32_t NumHashes;
+  uint32_t StrTabSize;
+  uint32_t Pad;
+  uint64_t DirsOffset;
+  uint64_t LibsOffset;
+  uint64_t WordsOffset;
+  uint64_t HashesOffset;
+  uint64_t StrTabOffset;
+};
+
+// A search path, as configured. Adding or removing a library changes the
+// mtime of its directory; a path which was no directory is recorded as
+// absent, so that the index is stale once it becomes one.
+struct DyldIndexDir {
+  uint32_t Path;
+  uint32_t Absent;
+  uint64_t MTime;
+};
+
+struct DyldIndexLib {
+  uint32_t Dir;
+  uint32_t Name;
+  uint32_t BuildId;
+  uint32_t SymbolsCount; // Sizes the bloom filter, see BloomFilter.
+  uint64_t Size;
+  uint64_t MTime;
+  uint32_t FirstBloomWord;
+  uint32_t NumBloomWords;
+  uint32_t FirstGnuWord;
+  uint32_t NumGnuWords;
+  uint32_t GnuBits;
+  uint32_t GnuShift2;
+  uint32_t FirstHash;
+  uint32_t NumHashes;
+};
+
+static_assert(sizeof(DyldIndexHeader) == 80, "On-disk layout changed");
+static_assert(sizeof(DyldIndexDir) == 16, "On-disk layout changed");
+static_assert(sizeof(DyldIndexLib) == 72, "On-disk layout changed");
+
+/// A validated view of a mapped index file.
+struct DyldIndex {
+  std::unique_ptr<llvm::MemoryBuffer> Buffer;
+  ArrayRef<DyldIndexDir> Dirs;
+  ArrayRef<DyldIndexLib> Libs;
+  ArrayRef<uint64_t> Words;
+  ArrayRef<uint32_t> Hashes;
+  StringRef StrTab;
+
+  const char* getString(uint32_t Offset) const {
+    return Offset < StrTab.size() ? StrTab.data() + Offset : "";
+  }
+
+  std::string getFullName(const DyldIndexLib& L) const {
+    SmallString<512> Vec(getString(L.Dir));
+    llvm::sys::path::append(Vec, getString(L.Name));
+    return Vec.str().str();
+  }
+
+  /// Maps \p Path and checks that every record lies within the file.
+  ///\returns null if the file is missing, truncated or of another version.
+  static std::unique_ptr<DyldIndex> open(StringRef Path) {
+    auto BufOrErr = llvm::MemoryBuffer::getFile(
+        Path, /*IsText=*/false, /*RequiresNullTerminator=*/false,
+        /*IsVolatile=*/false, llvm::Align(8));
+    if (!BufOrErr)
+      return nullptr;
+
+    std::unique_ptr<llvm::MemoryBuffer> Buf = std::move(*BufOrErr);
+    const char* Start = Buf->getBufferStart();
+    uint64_t FileSize = Buf->getBufferSize();
+    if (FileSize < sizeof(DyldIndexHeader))
+      return nullptr;
+    DyldIndexHeader H;
+    std::memcpy(&H, Start, sizeof(H));
+    if (std::memcmp(H.Magic, kDyldIndexMagic, sizeof(H.Magic)) != 0 ||
+        H.Version != kDyldIndexVersion || H.PointerSize != sizeof(void*))
+      return nullptr;
+
+    bool Valid = true;
+    auto Section = [&](uint64_t Offset, uint64_t Count, auto* Tag) {
+      using T = std::remove_pointer_t<decltype(Tag)>;
+      if (Offset % alignof(T) != 0 || Offset > FileSize ||
+          Count > (FileSize - Offset) / sizeof(T)) {
+        Valid = false;
+        return ArrayRef<T>();
+      }
+      return ArrayRef<T>(reinterpret_cast<const T*>(Start + Offset), Count);
+    };
+
+    auto Index = std::make_unique<DyldIndex>();
+    Index->Dirs = Section(H.DirsOffset, H.NumDirs, (DyldIndexDir*)nullptr);
+    Index->Libs = Section(H.LibsOffset, H.NumLibs, (DyldIndexLib*)nullptr);
+    Index->Words = Section(H.WordsOffset, H.NumWords, (uint64_t*)nullptr);
+    Index->Hashes = Section(H.HashesOffset, H.NumHashes, (uint32_t*)nullptr);
+    ArrayRef<char> StrTab =
+        Section(H.StrTabOffset, H.StrTabSize, (char*)nullptr);
+    // Every string must be NUL-terminated within the table.
+    if (!Valid || StrTab.empty() || StrTab.back() != '\0')
+      return nullptr;
+    for (const DyldIndexLib& L : Index->Libs)
+      if (uint64_t(L.FirstBloomWord) + L.NumBloomWords > Index->Words.size() ||
+          uint64_t(L.FirstGnuWord) + L.NumGnuWords > Index->Words.size() ||
+          uint64_t(L.FirstHash) + L.NumHashes > Index->Hashes.size() ||
+          (L.NumGnuWords && L.GnuBits != 32 && L.GnuBits != 64) || !fits(L))
+        return nullptr;
+    Index->StrTab = StringRef(StrTab.data(), StrTab.size());
+    Index->Buffer = std::move(Buf);
+    return Index;
+  }
+
+  /// Whether the bloom filter of \p L has the size this build gives it.
+  static bool fits(const DyldIndexLib& L) {
+    return uint64_t(BloomFilter::GetNumBlocks(L.SymbolsCount)) * 8 ==
+           L.NumBloomWords;
+  }
+
+  /// Gives \p Lib, which has no filters yet, the filters recorded in \p L.
+  void restore(LibraryPath& Lib, const DyldIndexLib& L) const {
+    assert(fits(L) && "Bloom filter sized differently");
+    Lib.InitializeBloomFilter(L.SymbolsCount);
+    ArrayRef<uint64_t> Bloom = Words.slice(L.FirstBloomWord, L.NumBloomWords);
+    if (!Bloom.empty())
+      std::copy(Bloom.begin(), Bloom.end(), Lib.m_Filter.words());
+
+    Lib.m_GnuHash.m_IsInitialized = true;
+    Lib.m_GnuHash.m_Bits = L.GnuBits;
+    Lib.m_GnuHash.m_Shift2 = L.GnuShift2;
+    ArrayRef<uint64_t> Gnu = Words.slice(L.FirstGnuWord, L.NumGnuWords);
+    Lib.m_GnuHash.m_Words.assign(Gnu.begin(), Gnu.end());
+
+    Lib.m_SymbolHashes = Hashes.slice(L.FirstHash, L.NumHashes);
+    Lib.m_BuildId = getString(L.BuildId);
+  }
+};
+
+/// Returns the size and modification time of \p Path, or false if it cannot
+/// be stat'ed.
+static bool GetFileStamp(const Twine& Path, uint64_t& Size, uint64_t& MTime) {
+  llvm::sys::fs::file_status Status;
+  if (llvm::sys::fs::status(Path, Status))
+    return false;
+  Size = Status.getSize();
+  MTime = Status.getLastModificationTime().time_since_epoch().count();
+  return true;
 }
 
 } // namespace
@@ -522,10 +895,47 @@ class Dyld {
   /// useless iterations.
   LibraryPaths m_QueriedLibraries;
 
+  /// A library image opened for symbol lookup. Images stay mapped between
+  /// queries so that a search over many libraries does not reopen and reparse
+  /// each of them every time.
+  struct MappedLibrary {
+    const LibraryPath* m_Lib;
+    llvm::object::OwningBinary<llvm::object::ObjectFile> m_Binary;
+    size_t m_Size;
+  };
+  /// The mapped images, most recently used first. Their total size is kept
+  /// under DynamicLibraryManager::getMappingBudget().
+  mutable std::list<MappedLibrary> m_MappedLibs;
+  mutable llvm::DenseMap<const LibraryPath*, std::list<MappedLibrary>::iterator>
+      m_MappedLibsIndex;
+  mutable size_t m_MappedBytes = 0;
+
+  /// Returns the parsed image of \p Lib, mapping it on a cache miss. The
+  /// result stays valid until the next call, which may evict it.
+  llvm::object::ObjectFile* GetObjectFile(const LibraryPath* Lib) const;
+
+  /// Unmaps the image of \p Lib. Must be called before its LibraryPath is
+  /// unregistered because the cache is keyed by address.
+  void ReleaseObjectFile(const LibraryPath* Lib) const;
+
   using PermanentlyIgnoreCallbackProto = std::function<bool(StringRef)>;
   const PermanentlyIgnoreCallbackProto m_ShouldPermanentlyIgnoreCallback;
   const StringRef m_ExecutableFormat;
 
+  /// What ScanForLibraries learns from reading a library file.
+  struct ScannedLibrary {
+    bool Ignored = false;
+    bool Readable = true;
+    bool IsPIEExecutable = false;
+    std::vector<std::string> Deps;
+    std::vector<std::string> RPath;
+    std::vector<std::string> RunPath;
+  };
+
+  /// Reads the file of a library for ScanForLibraries: whether it is ignored
+  /// and which libraries it depends on. Safe to call concurrently.
+  ScannedLibrary ReadLibraryInfo(StringRef FileName) const;
+
   /// Scan for shared objects which are not yet loaded. They are a our symbol
   /// resolution candidate sources.
   /// NOTE: We only scan not loaded shared objects.
@@ -533,10 +943,52 @@ class Dyld {
   ///            locations for shared objects.
   void ScanForLibraries(bool searchSystemLibraries = false);
 
+  /// Scans for libraries like ScanForLibraries. If an index directory is set
+  /// in the DynamicLibraryManager, the libraries and their filters are
+  /// restored from the index of the current search paths when nothing
+  /// changed on disk; otherwise the scan result is written back to it.
+  void ScanOrRestoreLibraries(bool searchSystemLibraries);
+
+  ///\returns the index file for the current user or system search paths.
+  std::string GetIndexPath(bool searchSystemLibraries) const;
+
+  /// Registers the libraries of \p Index if every recorded directory and
+  /// library still has the recorded modification time and size.
+  ///\returns false, registering nothing, if the index is stale.
+  bool RestoreFromIndex(const DyldIndex& Index, bool searchSystemLibraries);
+
+  /// Builds the filters of every scanned library, reusing those of \p Old
+  /// for unchanged libraries, and writes them to \p IndexPath.
+  void UpdateIndex(StringRef IndexPath, bool searchSystemLibraries,
+                   const DyldIndex* Old);
+
+  /// The indexes the libraries were restored from, for user and system
+  /// libraries. LibraryPath::m_SymbolHashes point into them.
+  std::unique_ptr<DyldIndex> m_Indexes[2];
+
+  /// Collects the names of the symbols of a library which are not flagged
+  /// with \p IgnoreSymbolFlags.
+  ///\returns the number of collected symbols.
+  uint32_t ReadSymbols(llvm::object::ObjectFile* BinObjFile,
+                       unsigned IgnoreSymbolFlags,
+                       std::list<llvm::StringRef>& symbols) const;
+
   /// Builds a bloom filter lookup optimization.
   void BuildBloomFilter(LibraryPath* Lib, llvm::object::ObjectFile* BinObjFile,
                         unsigned IgnoreSymbolFlags = 0) const;
 
+  /// Builds, concurrently, the filters which ContainsSymbol would build when
+  /// looking for a symbol with GNU hash \p Hash in every library of \p Libs:
+  /// the .gnu.hash filter of each library, and the bloom filter of those
+  /// which may contain the symbol.
+  void BuildFilters(const LibraryPaths& Libs, uint32_t Hash,
+                    unsigned IgnoreSymbolFlags) const;
+
+  /// Fills the symbol hash table of a library whose bloom filter was restored
+  /// from an index.
+  void BuildSymbolTable(LibraryPath* Lib, llvm::object::ObjectFile* BinObjFile,
+                        unsigned IgnoreSymbolFlags = 0) const;
+
   /// Looks up symbols from a an object file, representing the library.
   ///\param[in] Lib - full path to the library.
   ///\param[in] mangledName - the mangled name to look for.
@@ -548,6 +1000,101 @@ class Dyld {
   bool ShouldPermanentlyIgnore(StringRef FileName) const;
   void dumpDebugInfo() const;
 
+  /// Scans the user or system libraries if that has not happened yet.
+  void ScanOnce(bool searchSystemLibraries);
+
+  /// Scans the user libraries if needed and forgets the libraries which were
+  /// loaded since the last search.
+  void PrepareSearch();
+
+  /// Finds the first library containing \p mangledName, after PrepareSearch.
+  std::string LookupSymbol(StringRef mangledName, bool searchSystem);
+
+  /// The reverse index used instead of walking the libraries if the
+  /// DynamicLibraryManager asks for it. Rebuilt after a scan registered new
+  /// libraries.
+  SymbolHashIndex m_SymbolIndex;
+  bool m_SymbolIndexDirty = true;
+
+  void BuildSymbolIndex(bool searchSystem);
+  std::string LookupSymbolInIndex(StringRef mangledName, bool searchSystem);
+
+  /// The bloom filters of the user or system libraries laid out for probing
+  /// all of them at once, with the libraries in search order. Rebuilt when
+  /// m_FilterGeneration moved on.
+  struct FilterSet {
+    BloomFilterSet m_Filters;
+    std::vector<const LibraryPath*> m_Libs;
+    uint64_t m_Generation = ~0ULL;
+  };
+  FilterSet m_FilterSets[2];
+  // Bumped whenever a library or a bloom filter is added or removed; the
+  // filters are built concurrently by BuildFilters.
+  mutable std::atomic<uint64_t> m_FilterGeneration{0};
+  std::vector<uint32_t> m_Candidates;
+
+  const FilterSet& GetFilterSet(bool searchSystemLibraries);
+
+  /// What the search did, per layer. The filters are also built
+  /// concurrently, hence the atomics; the counters are independent of each
+  /// other, so relaxed updates suffice.
+  using SearchStats =
+      DynamicLibraryManager::SearchCounters<std::atomic<uint64_t>>;
+  using StatField = std::atomic<uint64_t> SearchStats::*;
+  mutable SearchStats m_Stats;
+
+  void Count(StatField Field, uint64_t N = 1) const {
+    (m_Stats.*Field).fetch_add(N, std::memory_order_relaxed);
+  }
+
+  /// Adds the nanoseconds until it goes out of scope to a counter.
+  class StatTimer {
+    const Dyld& m_Dyld;
+    StatField m_Field;
+    std::chrono::steady_clock::time_point m_Start;
+
+  public:
+    StatTimer(const Dyld& D, StatField Field)
+        : m_Dyld(D), m_Field(Field), m_Start(std::chrono::steady_clock::now()) {
+    }
+    ~StatTimer() {
+      m_Dyld.Count(m_Field,
+                   std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - m_Start)
+                       .count());
+    }
+  };
+
+  /// Maps and parses the image of a library, counting and timing it.
+  llvm::Expected<llvm::object::OwningBinary<llvm::object::ObjectFile>>
+  OpenObjectFile(StringRef FileName) const {
+    Count(&SearchStats::ObjectOpens);
+    StatTimer Timer(*this, &SearchStats::ObjectOpenNs);
+    return llvm::object::ObjectFile::createObjectFile(FileName);
+  }
+
+  /// The inotify watches on the scanned directories, if the
+  /// DynamicLibraryManager asks to watch them (Linux only). Changes to the
+  /// libraries in them are applied to m_Libraries and m_SysLibraries before
+  /// the next search instead of going unnoticed.
+  struct WatchedDir {
+    std::string Path;
+    bool System;
+  };
+  int m_WatchFd = -1;
+  std::map<int, WatchedDir> m_WatchedDirs;
+  bool m_Watching[2] = {false, false};
+  size_t m_RescansAvoided = 0;
+
+  /// Unregisters \p Lib, wherever it is registered, and drops what the search
+  /// keeps about it.
+  void ForgetLibrary(const LibraryPath& Lib);
+  void WatchDirectories(bool searchSystemLibraries);
+  void UpdateWatches();
+  void ApplyWatchEvents();
+  size_t ScanOrderPosition(const LibraryPath& Lib, bool searchSystemLibraries);
+  void ApplyChange(StringRef Path, bool searchSystemLibraries);
+
 public:
   Dyld(const DynamicLibraryManager& DLM,
        PermanentlyIgnoreCallbackProto shouldIgnore, StringRef execFormat)
@@ -555,12 +1102,100 @@ public:
         m_ShouldPermanentlyIgnoreCallback(shouldIgnore),
         m_ExecutableFormat(execFormat) {}
 
-  ~Dyld() {};
+  ~Dyld() {
+#ifdef __linux__
+    if (m_WatchFd != -1)
+      ::close(m_WatchFd);
+#endif
+  };
+
+  size_t getRescansAvoided() const { return m_RescansAvoided; }
+
+  DynamicLibraryManager::SearchStats getSearchStats() const {
+    llvm::SmallVector<uint64_t, 32> Values;
+    m_Stats.forEach([&Values](const char*, const std::atomic<uint64_t>& V) {
+      Values.push_back(V.load(std::memory_order_relaxed));
+    });
+    DynamicLibraryManager::SearchStats Snapshot;
+    const uint64_t* Value = Values.data();
+    Snapshot.forEach([&Value](const char*, uint64_t& V) { V = *Value++; });
+    return Snapshot;
+  }
+  void resetSearchStats() {
+    m_Stats.forEach([](const char*, std::atomic<uint64_t>& V) {
+      V.store(0, std::memory_order_relaxed);
+    });
+  }
 
   std::string searchLibrariesForSymbol(StringRef mangledName,
                                        bool searchSystem);
+
+  std::vector<std::string>
+  searchLibrariesForSymbols(ArrayRef<StringRef> mangledNames,
+                            bool searchSystem);
+
+  /// Unmaps the least recently used images until at most \p Budget bytes
+  /// stay mapped.
+  void TrimObjectFiles(size_t Budget) const;
+
+  /// Reads the dependency graph of \p Libs (their DT_NEEDED entries, found
+  /// through RPATH and RUNPATH like ScanForLibraries does) level by level,
+  /// reading ahead all the files of a level in parallel.
+  ///\returns \p Libs ordered so that each comes after the ones it depends
+  /// on, directly or through libraries which are not in \p Libs.
+  std::vector<std::string>
+  PrefetchDependencyGraph(ArrayRef<std::string> Libs) const;
 };
 
+ObjectFile* Dyld::GetObjectFile(const LibraryPath* Lib) const {
+#define DEBUG_TYPE "Dyld::GetObjectFile:"
+  auto Found = m_MappedLibsIndex.find(Lib);
+  if (Found != m_MappedLibsIndex.end()) {
+    m_MappedLibs.splice(m_MappedLibs.begin(), m_MappedLibs, Found->second);
+    return m_MappedLibs.front().m_Binary.getBinary();
+  }
+
+  const std::string library_filename = Lib->GetFullName();
+  auto ObjF = OpenObjectFile(library_filename);
+  if (llvm::Error Err = ObjF.takeError()) {
+    std::string Message;
+    handleAllErrors(std::move(Err), [&](llvm::ErrorInfoBase& EIB) {
+      Message += EIB.message() + "; ";
+    });
+    LLVM_DEBUG(dbgs() << "Dyld::GetObjectFile: Failed to read object file "
+                      << library_filename << " Errors: " << Message << "\n");
+    return nullptr;
+  }
+
+  size_t Size = ObjF->getBinary()->getData().size();
+  m_MappedLibs.push_front(MappedLibrary{Lib, std::move(*ObjF), Size});
+  m_MappedLibsIndex[Lib] = m_MappedLibs.begin();
+  m_MappedBytes += Size;
+
+  // Never evict the image we are about to hand out, even if it alone exceeds
+  // the budget.
+  const size_t Budget = m_DynamicLibraryManager.getMappingBudget();
+  while (m_MappedBytes > Budget && m_MappedLibs.size() > 1)
+    ReleaseObjectFile(m_MappedLibs.back().m_Lib);
+
+  return m_MappedLibs.front().m_Binary.getBinary();
+#undef DEBUG_TYPE
+}
+
+void Dyld::ReleaseObjectFile(const LibraryPath* Lib) const {
+  auto Found = m_MappedLibsIndex.find(Lib);
+  if (Found == m_MappedLibsIndex.end())
+    return;
+  m_MappedBytes -= Found->second->m_Size;
+  m_MappedLibs.erase(Found->second);
+  m_MappedLibsIndex.erase(Found);
+}
+
+void Dyld::TrimObjectFiles(size_t Budget) const {
+  while (m_MappedBytes > Budget && !m_MappedLibs.empty())
+    ReleaseObjectFile(m_MappedLibs.back().m_Lib);
+}
+
 std::string RPathToStr(SmallVector<StringRef, 2> V) {
   std::string result;
   for (auto item : V)
@@ -616,6 +1251,80 @@ void HandleDynTab(const ELFFile<ELFT>* Elf, StringRef FileName,
 #undef DEBUG_TYPE
 }
 
+Dyld::ScannedLibrary Dyld::ReadLibraryInfo(StringRef FileName) const {
+#define DEBUG_TYPE "Dyld:ScanForLibraries:"
+  ScannedLibrary Info;
+  if (ShouldPermanentlyIgnore(FileName)) {
+    LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries: PermanentlyIgnored "
+                      << FileName.str() << "\n");
+    Info.Ignored = true;
+    return Info;
+  }
+
+  // Handle lib dependencies
+  llvm::SmallVector<llvm::StringRef, 2> RPath;
+  llvm::SmallVector<llvm::StringRef, 2> RunPath;
+  std::vector<StringRef> Deps;
+  auto ObjFileOrErr = OpenObjectFile(FileName);
+  if (llvm::Error Err = ObjFileOrErr.takeError()) {
+    std::string Message;
+    handleAllErrors(std::move(Err), [&](llvm::ErrorInfoBase& EIB) {
+      Message += EIB.message() + "; ";
+    });
+    LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries: Failed to read object file "
+                      << FileName.str() << " Errors: " << Message << "\n");
+    Info.Readable = false;
+    return Info;
+  }
+  llvm::object::ObjectFile* BinObjF = ObjFileOrErr.get().getBinary();
+  if (BinObjF->isELF()) {
+    bool& isPIEExecutable = Info.IsPIEExecutable;
+
+    if (const auto* ELF = dyn_cast<ELF32LEObjectFile>(BinObjF))
+      HandleDynTab(&ELF->getELFFile(), FileName, RPath, RunPath, Deps,
+                   isPIEExecutable);
+    else if (const auto* ELF = dyn_cast<ELF32BEObjectFile>(BinObjF))
+      HandleDynTab(&ELF->getELFFile(), FileName, RPath, RunPath, Deps,
+                   isPIEExecutable);
+    else if (const auto* ELF = dyn_cast<ELF64LEObjectFile>(BinObjF))
+      HandleDynTab(&ELF->getELFFile(), FileName, RPath, RunPath, Deps,
+                   isPIEExecutable);
+    else if (const auto* ELF = dyn_cast<ELF64BEObjectFile>(BinObjF))
+      HandleDynTab(&ELF->getELFFile(), FileName, RPath, RunPath, Deps,
+                   isPIEExecutable);
+  } else if (BinObjF->isMachO()) {
+    MachOObjectFile* Obj = (MachOObjectFile*)BinObjF;
+    for (const auto& Command : Obj->load_commands()) {
+      if (Command.C.cmd == MachO::LC_LOAD_DYLIB) {
+        // Command.C.cmd == MachO::LC_ID_DYLIB ||
+        // Command.C.cmd == MachO::LC_LOAD_WEAK_DYLIB ||
+        // Command.C.cmd == MachO::LC_REEXPORT_DYLIB ||
+        // Command.C.cmd == MachO::LC_LAZY_LOAD_DYLIB ||
+        // Command.C.cmd == MachO::LC_LOAD_UPWARD_DYLIB ||
+        MachO::dylib_command dylibCmd = Obj->getDylibIDLoadCommand(Command);
+        Deps.push_back(StringRef(Command.Ptr + dylibCmd.dylib.name));
+      } else if (Command.C.cmd == MachO::LC_RPATH) {
+        MachO::rpath_command rpathCmd = Obj->getRpathCommand(Command);
+        SplitPaths(Command.Ptr + rpathCmd.path, RPath,
+                   utils::SplitMode::kAllowNonExistent,
+                   utils::platform::kEnvDelim, false);
+      }
+    }
+  } else if (BinObjF->isCOFF()) {
+    // TODO: COFF support
+  }
+
+  // The strings point into the image, which is unmapped on return.
+  for (StringRef R : RPath)
+    Info.RPath.push_back(R.str());
+  for (StringRef R : RunPath)
+    Info.RunPath.push_back(R.str());
+  for (StringRef D : Deps)
+    Info.Deps.push_back(D.str());
+  return Info;
+#undef DEBUG_TYPE
+}
+
 void Dyld::ScanForLibraries(bool searchSystemLibraries /* = false*/) {
 #define DEBUG_TYPE "Dyld:ScanForLibraries:"
 
@@ -628,247 +1337,222 @@ void Dyld::ScanForLibraries(bool searchSystemLibraries /* = false*/) {
     LLVM_DEBUG(dbgs() << ">>>" << Info.Path << ", "
                       << (Info.IsUser ? "user\n" : "system\n"));
 #endif
-  llvm::SmallSet<const BasePath*, 32> ScannedPaths;
 
+  // Examples which we should handle.
+  // File                      Real
+  // /lib/1/1.so               /lib/1/1.so  // file
+  // /lib/1/2.so->/lib/1/1.so  /lib/1/1.so  // file local link
+  // /lib/1/3.so->/lib/3/1.so  /lib/3/1.so  // file external link
+  // /lib/2->/lib/1                         // path link
+  // /lib/2/1.so               /lib/1/1.so  // path link, file
+  // /lib/2/2.so->/lib/1/1.so  /lib/1/1.so  // path link, file local link
+  // /lib/2/3.so->/lib/3/1.so  /lib/3/1.so  // path link, file external link
+  //
+  // /lib/3/1.so
+  // /lib/3/2.so->/system/lib/s.so
+  // /lib/3/3.so
+  // /system/lib/1.so
+  //
+  // libL.so NEEDED/RPATH libR.so    /lib/some-rpath/libR.so  //
+  // needed/dependedt library in libL.so RPATH/RUNPATH or other (in)direct
+  // dep
+  //
+  // Paths = /lib/1 : /lib/2 : /lib/3
+
+  // m_BasePaths = ["/lib/1", "/lib/3", "/system/lib"]
+  // m_*Libraries  = [<0,"1.so">, <1,"1.so">, <2,"s.so">, <1,"3.so">]
+
+  // The scan runs in three steps. Listing the directories and reading the
+  // files, which is where the time goes, happen concurrently. Registering the
+  // libraries replays the results sequentially in directory order, so that
+  // m_Libraries and m_SysLibraries keep the order of a sequential scan.
+  std::vector<std::string> Dirs;
+  llvm::SmallSet<const BasePath*, 32> ScannedPaths;
   for (const DynamicLibraryManager::SearchPathInfo& Info : searchPaths) {
-    if (Info.IsUser != searchSystemLibraries) {
-      // Examples which we should handle.
-      // File                      Real
-      // /lib/1/1.so               /lib/1/1.so  // file
-      // /lib/1/2.so->/lib/1/1.so  /lib/1/1.so  // file local link
-      // /lib/1/3.so->/lib/3/1.so  /lib/3/1.so  // file external link
-      // /lib/2->/lib/1                         // path link
-      // /lib/2/1.so               /lib/1/1.so  // path link, file
-      // /lib/2/2.so->/lib/1/1.so  /lib/1/1.so  // path link, file local link
-      // /lib/2/3.so->/lib/3/1.so  /lib/3/1.so  // path link, file external link
-      //
-      // /lib/3/1.so
-      // /lib/3/2.so->/system/lib/s.so
-      // /lib/3/3.so
-      // /system/lib/1.so
-      //
-      // libL.so NEEDED/RPATH libR.so    /lib/some-rpath/libR.so  //
-      // needed/dependedt library in libL.so RPATH/RUNPATH or other (in)direct
-      // dep
-      //
-      // Paths = /lib/1 : /lib/2 : /lib/3
+    if (Info.IsUser == searchSystemLibraries)
+      continue;
+    LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries Iter:" << Info.Path
+                      << " -> ");
+    std::string RealPath = cached_realpath(Info.Path);
 
-      // m_BasePaths = ["/lib/1", "/lib/3", "/system/lib"]
-      // m_*Libraries  = [<0,"1.so">, <1,"1.so">, <2,"s.so">, <1,"3.so">]
+    llvm::StringRef DirPath(RealPath);
+    LLVM_DEBUG(dbgs() << RealPath << "\n");
 
-      LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries Iter:" << Info.Path
-                        << " -> ");
-      std::string RealPath = cached_realpath(Info.Path);
+    if (!llvm::sys::fs::is_directory(DirPath) || DirPath.empty())
+      continue;
 
-      llvm::StringRef DirPath(RealPath);
-      LLVM_DEBUG(dbgs() << RealPath << "\n");
+    // Already searched?
+    const BasePath& ScannedBPath = m_BasePaths.RegisterBasePath(RealPath);
+    if (!ScannedPaths.insert(&ScannedBPath).second) {
+      LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries Already scanned: "
+                        << RealPath << "\n");
+      continue;
+    }
+    Dirs.push_back(RealPath);
+  }
 
-      if (!llvm::sys::fs::is_directory(DirPath) || DirPath.empty())
+  // FileName must be always full/absolute/resolved file name.
+  std::vector<std::vector<std::string>> DirFiles(Dirs.size());
+  llvm::parallelFor(0, Dirs.size(), [&](size_t I) {
+    llvm::StringRef DirPath = Dirs[I];
+    LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries: Iterator: " << DirPath
+                      << "\n");
+    std::error_code EC;
+    for (llvm::sys::fs::directory_iterator DirIt(DirPath, EC), DirEnd;
+         DirIt != DirEnd && !EC; DirIt.increment(EC)) {
+
+      LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries: Iterator >>> "
+                        << DirIt->path()
+                        << ", type=" << (short)(DirIt->type()) << "\n");
+
+      const llvm::sys::fs::file_type ft = DirIt->type();
+      if (ft == llvm::sys::fs::file_type::regular_file) {
+        DirFiles[I].push_back(DirIt->path());
+      } else if (ft == llvm::sys::fs::file_type::symlink_file) {
+        std::string DepFileName = cached_realpath(DirIt->path());
+        assert(!llvm::sys::fs::is_symlink_file(DepFileName));
+        if (!llvm::sys::fs::is_directory(DepFileName))
+          DirFiles[I].push_back(std::move(DepFileName));
+      }
+    }
+  });
+
+  // Read every library which is not registered yet.
+  std::vector<StringRef> Files;
+  StringMap<size_t> FileIndex;
+  for (const std::vector<std::string>& InDir : DirFiles)
+    for (const std::string& FileName : InDir) {
+      LibraryPath LibPath(
+          m_BasePaths.RegisterBasePath(
+              llvm::sys::path::parent_path(FileName).str()),
+          llvm::sys::path::filename(FileName).str());
+      if (m_SysLibraries.HasRegisteredLib(LibPath) ||
+          m_Libraries.HasRegisteredLib(LibPath) ||
+          !FileIndex.try_emplace(FileName, Files.size()).second)
         continue;
+      Files.push_back(FileName);
+    }
+  std::vector<ScannedLibrary> Infos(Files.size());
+  llvm::parallelFor(0, Files.size(),
+                    [&](size_t I) { Infos[I] = ReadLibraryInfo(Files[I]); });
+  // Dependencies outside of the search paths are read on demand.
+  StringMap<ScannedLibrary> DepInfos;
+
+  std::function<void(llvm::StringRef, unsigned)> HandleLib =
+      [&](llvm::StringRef FileName, unsigned level) {
+        LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries HandleLib:"
+                          << FileName.str() << ", level=" << level << " -> ");
+
+        llvm::StringRef FileRealPath = llvm::sys::path::parent_path(FileName);
+        llvm::StringRef FileRealName = llvm::sys::path::filename(FileName);
+        const BasePath& BaseP =
+            m_BasePaths.RegisterBasePath(FileRealPath.str());
+        LibraryPath LibPath(BaseP, FileRealName.str()); // bp, str
+
+        if (m_SysLibraries.GetRegisteredLib(LibPath) ||
+            m_Libraries.GetRegisteredLib(LibPath)) {
+          LLVM_DEBUG(dbgs() << "Already handled!!!\n");
+          return;
+        }
 
-      // Already searched?
-      const BasePath& ScannedBPath = m_BasePaths.RegisterBasePath(RealPath);
-      if (ScannedPaths.count(&ScannedBPath)) {
-        LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries Already scanned: "
-                          << RealPath << "\n");
-        continue;
-      }
+        const ScannedLibrary* Info;
+        auto Found = FileIndex.find(FileName);
+        if (Found != FileIndex.end()) {
+          Info = &Infos[Found->second];
+        } else {
+          auto Dep = DepInfos.find(FileName);
+          if (Dep == DepInfos.end())
+            Dep = DepInfos.try_emplace(FileName, ReadLibraryInfo(FileName))
+                      .first;
+          Info = &Dep->second;
+        }
 
-      // FileName must be always full/absolute/resolved file name.
-      std::function<void(llvm::StringRef, unsigned)> HandleLib =
-          [&](llvm::StringRef FileName, unsigned level) {
-            LLVM_DEBUG(dbgs()
-                       << "Dyld::ScanForLibraries HandleLib:" << FileName.str()
-                       << ", level=" << level << " -> ");
-
-            llvm::StringRef FileRealPath =
-                llvm::sys::path::parent_path(FileName);
-            llvm::StringRef FileRealName = llvm::sys::path::filename(FileName);
-            const BasePath& BaseP =
-                m_BasePaths.RegisterBasePath(FileRealPath.str());
-            LibraryPath LibPath(BaseP, FileRealName.str()); // bp, str
-
-            if (m_SysLibraries.GetRegisteredLib(LibPath) ||
-                m_Libraries.GetRegisteredLib(LibPath)) {
-              LLVM_DEBUG(dbgs() << "Already handled!!!\n");
-              return;
-            }
-
-            if (ShouldPermanentlyIgnore(FileName)) {
-              LLVM_DEBUG(dbgs() << "PermanentlyIgnored!!!\n");
-              return;
-            }
-
-            if (searchSystemLibraries)
-              m_SysLibraries.RegisterLib(LibPath);
-            else
-              m_Libraries.RegisterLib(LibPath);
-
-            // Handle lib dependencies
-            llvm::SmallVector<llvm::StringRef, 2> RPath;
-            llvm::SmallVector<llvm::StringRef, 2> RunPath;
-            std::vector<StringRef> Deps;
-            auto ObjFileOrErr =
-                llvm::object::ObjectFile::createObjectFile(FileName);
-            if (llvm::Error Err = ObjFileOrErr.takeError()) {
-              std::string Message;
-              handleAllErrors(std::move(Err), [&](llvm::ErrorInfoBase& EIB) {
-                Message += EIB.message() + "; ";
-              });
-              LLVM_DEBUG(
-                  dbgs()
-                  << "Dyld::ScanForLibraries: Failed to read object file "
-                  << FileName.str() << " Errors: " << Message << "\n");
-              return;
-            }
-            llvm::object::ObjectFile* BinObjF = ObjFileOrErr.get().getBinary();
-            if (BinObjF->isELF()) {
-              bool isPIEExecutable = false;
-
-              if (const auto* ELF = dyn_cast<ELF32LEObjectFile>(BinObjF))
-                HandleDynTab(&ELF->getELFFile(), FileName, RPath, RunPath, Deps,
-                             isPIEExecutable);
-              else if (const auto* ELF = dyn_cast<ELF32BEObjectFile>(BinObjF))
-                HandleDynTab(&ELF->getELFFile(), FileName, RPath, RunPath, Deps,
-                             isPIEExecutable);
-              else if (const auto* ELF = dyn_cast<ELF64LEObjectFile>(BinObjF))
-                HandleDynTab(&ELF->getELFFile(), FileName, RPath, RunPath, Deps,
-                             isPIEExecutable);
-              else if (const auto* ELF = dyn_cast<ELF64BEObjectFile>(BinObjF))
-                HandleDynTab(&ELF->getELFFile(), FileName, RPath, RunPath, Deps,
-                             isPIEExecutable);
-
-              if ((level == 0) && isPIEExecutable) {
-                if (searchSystemLibraries)
-                  m_SysLibraries.UnregisterLib(LibPath);
-                else
-                  m_Libraries.UnregisterLib(LibPath);
-                return;
-              }
-            } else if (BinObjF->isMachO()) {
-              MachOObjectFile* Obj = (MachOObjectFile*)BinObjF;
-              for (const auto& Command : Obj->load_commands()) {
-                if (Command.C.cmd == MachO::LC_LOAD_DYLIB) {
-                  // Command.C.cmd == MachO::LC_ID_DYLIB ||
-                  // Command.C.cmd == MachO::LC_LOAD_WEAK_DYLIB ||
-                  // Command.C.cmd == MachO::LC_REEXPORT_DYLIB ||
-                  // Command.C.cmd == MachO::LC_LAZY_LOAD_DYLIB ||
-                  // Command.C.cmd == MachO::LC_LOAD_UPWARD_DYLIB ||
-                  MachO::dylib_command dylibCmd =
-                      Obj->getDylibIDLoadCommand(Command);
-                  Deps.push_back(StringRef(Command.Ptr + dylibCmd.dylib.name));
-                } else if (Command.C.cmd == MachO::LC_RPATH) {
-                  MachO::rpath_command rpathCmd = Obj->getRpathCommand(Command);
-                  SplitPaths(Command.Ptr + rpathCmd.path, RPath,
-                             utils::SplitMode::kAllowNonExistent,
-                             utils::platform::kEnvDelim, false);
-                }
-              }
-            } else if (BinObjF->isCOFF()) {
-              // TODO: COFF support
-            }
-
-            LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries: Deps Info:\n");
-            LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries:   RPATH="
-                              << RPathToStr(RPath) << "\n");
-            LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries:   RUNPATH="
-                              << RPathToStr(RunPath) << "\n");
+        if (Info->Ignored) {
+          LLVM_DEBUG(dbgs() << "PermanentlyIgnored!!!\n");
+          return;
+        }
+
+        if ((level == 0) && Info->IsPIEExecutable)
+          return;
+
+        if (searchSystemLibraries)
+          m_SysLibraries.RegisterLib(LibPath);
+        else
+          m_Libraries.RegisterLib(LibPath);
+
+        if (!Info->Readable)
+          return;
+
+        llvm::SmallVector<llvm::StringRef, 2> RPath(Info->RPath.begin(),
+                                                    Info->RPath.end());
+        llvm::SmallVector<llvm::StringRef, 2> RunPath(Info->RunPath.begin(),
+                                                      Info->RunPath.end());
+
+        LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries: Deps Info:\n");
+        LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries:   RPATH="
+                          << RPathToStr(RPath) << "\n");
+        LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries:   RUNPATH="
+                          << RPathToStr(RunPath) << "\n");
 #ifndef NDEBUG
-            int x = 0;
-            for (StringRef dep : Deps)
-              LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries:   Deps[" << x++
-                                << "]=" << dep.str() << "\n");
+        int x = 0;
+        for (const std::string& dep : Info->Deps)
+          LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries:   Deps[" << x++
+                            << "]=" << dep << "\n");
 #endif
-            // Heuristics for workaround performance problems:
-            // (H1) If RPATH and RUNPATH == "" -> skip handling Deps
-            if (RPath.empty() && RunPath.empty()) {
-              LLVM_DEBUG(
-                  dbgs()
-                  << "Dyld::ScanForLibraries: Skip all deps by Heuristic1: "
-                  << FileName.str() << "\n");
-              return;
-            };
-            // (H2) If RPATH subset of LD_LIBRARY_PATH &&
-            //         RUNPATH subset of LD_LIBRARY_PATH  -> skip handling Deps
-            if (std::all_of(
-                    RPath.begin(), RPath.end(),
-                    [&](StringRef item) {
-                      return std::any_of(
-                          searchPaths.begin(), searchPaths.end(),
-                          [&](DynamicLibraryManager::SearchPathInfo item1) {
-                            return item == item1.Path;
-                          });
-                    }) &&
-                std::all_of(
-                    RunPath.begin(), RunPath.end(), [&](StringRef item) {
-                      return std::any_of(
-                          searchPaths.begin(), searchPaths.end(),
-                          [&](DynamicLibraryManager::SearchPathInfo item1) {
-                            return item == item1.Path;
-                          });
-                    })) {
-              LLVM_DEBUG(
-                  dbgs()
-                  << "Dyld::ScanForLibraries: Skip all deps by Heuristic2: "
-                  << FileName.str() << "\n");
-              return;
-            }
-
-            // Handle dependencies
-            for (StringRef dep : Deps) {
-              std::string dep_full = m_DynamicLibraryManager.lookupLibrary(
-                  dep, RPath, RunPath, FileName, false);
-              HandleLib(dep_full, level + 1);
-            }
-          };
-
-      LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries: Iterator: " << DirPath
-                        << "\n");
-      std::error_code EC;
-      for (llvm::sys::fs::directory_iterator DirIt(DirPath, EC), DirEnd;
-           DirIt != DirEnd && !EC; DirIt.increment(EC)) {
-
-        LLVM_DEBUG(dbgs() << "Dyld::ScanForLibraries: Iterator >>> "
-                          << DirIt->path()
-                          << ", type=" << (short)(DirIt->type()) << "\n");
-
-        const llvm::sys::fs::file_type ft = DirIt->type();
-        if (ft == llvm::sys::fs::file_type::regular_file) {
-          HandleLib(DirIt->path(), 0);
-        } else if (ft == llvm::sys::fs::file_type::symlink_file) {
-          std::string DepFileName_str = cached_realpath(DirIt->path());
-          llvm::StringRef DepFileName = DepFileName_str;
-          assert(!llvm::sys::fs::is_symlink_file(DepFileName));
-          if (!llvm::sys::fs::is_directory(DepFileName))
-            HandleLib(DepFileName, 0);
+        // Heuristics for workaround performance problems:
+        // (H1) If RPATH and RUNPATH == "" -> skip handling Deps
+        if (RPath.empty() && RunPath.empty()) {
+          LLVM_DEBUG(dbgs()
+                     << "Dyld::ScanForLibraries: Skip all deps by Heuristic1: "
+                     << FileName.str() << "\n");
+          return;
+        };
+        // (H2) If RPATH subset of LD_LIBRARY_PATH &&
+        //         RUNPATH subset of LD_LIBRARY_PATH  -> skip handling Deps
+        if (std::all_of(
+                RPath.begin(), RPath.end(),
+                [&](StringRef item) {
+                  return std::any_of(
+                      searchPaths.begin(), searchPaths.end(),
+                      [&](DynamicLibraryManager::SearchPathInfo item1) {
+                        return item == item1.Path;
+                      });
+                }) &&
+            std::all_of(RunPath.begin(), RunPath.end(), [&](StringRef item) {
+              return std::any_of(
+                  searchPaths.begin(), searchPaths.end(),
+                  [&](DynamicLibraryManager::SearchPathInfo item1) {
+                    return item == item1.Path;
+                  });
+            })) {
+          LLVM_DEBUG(dbgs()
+                     << "Dyld::ScanForLibraries: Skip all deps by Heuristic2: "
+                     << FileName.str() << "\n");
+          return;
         }
-      }
 
-      // Register the DirPath as fully scanned.
-      ScannedPaths.insert(&ScannedBPath);
-    }
-  }
+        // Handle dependencies
+        for (StringRef dep : Info->Deps) {
+          std::string dep_full = m_DynamicLibraryManager.lookupLibrary(
+              dep, RPath, RunPath, FileName, false);
+          HandleLib(dep_full, level + 1);
+        }
+      };
+
+  for (const std::vector<std::string>& InDir : DirFiles)
+    for (const std::string& FileName : InDir)
+      HandleLib(FileName, 0);
 #undef DEBUG_TYPE
 }
 
-void Dyld::BuildBloomFilter(LibraryPath* Lib,
-                            llvm::object::ObjectFile* BinObjFile,
-                            unsigned IgnoreSymbolFlags /*= 0*/) const {
-#define DEBUG_TYPE "Dyld::BuildBloomFilter:"
-  assert(m_UseBloomFilter && "Bloom filter is disabled");
-  assert(!Lib->hasBloomFilter() && "Already built!");
-
+uint32_t Dyld::ReadSymbols(llvm::object::ObjectFile* BinObjFile,
+                           unsigned IgnoreSymbolFlags,
+                           std::list<llvm::StringRef>& symbols) const {
+#define DEBUG_TYPE "Dyld::ReadSymbols:"
   using namespace llvm;
   using namespace llvm::object;
 
-  LLVM_DEBUG(
-      dbgs() << "Dyld::BuildBloomFilter: Start building Bloom filter for: "
-             << Lib->GetFullName() << "\n");
-
-  // If BloomFilter is empty then build it.
-  // Count Symbols and generate BloomFilter
   uint32_t SymbolsCount = 0;
-  std::list<llvm::StringRef> symbols;
   for (const llvm::object::SymbolRef& S : BinObjFile->symbols()) {
     uint32_t Flags = llvm::cantFail(S.getFlags());
     // Do not insert in the table symbols flagged to ignore.
@@ -886,7 +1570,7 @@ void Dyld::BuildBloomFilter(LibraryPath* Lib,
 
     llvm::Expected<llvm::StringRef> SymNameErr = S.getName();
     if (!SymNameErr) {
-      LLVM_DEBUG(dbgs() << "Dyld::BuildBloomFilter: Failed to read symbol "
+      LLVM_DEBUG(dbgs() << "Dyld::ReadSymbols: Failed to read symbol "
                         << SymNameErr.get() << "\n");
       continue;
     }
@@ -919,7 +1603,7 @@ void Dyld::BuildBloomFilter(LibraryPath* Lib,
 
       llvm::Expected<StringRef> SymNameErr = S.getName();
       if (!SymNameErr) {
-        LLVM_DEBUG(dbgs() << "Dyld::BuildBloomFilter: Failed to read symbol "
+        LLVM_DEBUG(dbgs() << "Dyld::ReadSymbols: Failed to read symbol "
                           << SymNameErr.get() << "\n");
         continue;
       }
@@ -950,7 +1634,7 @@ void Dyld::BuildBloomFilter(LibraryPath* Lib,
         handleAllErrors(std::move(Err), [&](llvm::ErrorInfoBase& EIB) {
           Message += EIB.message() + "; ";
         });
-        LLVM_DEBUG(dbgs() << "Dyld::BuildBloomFilter: Failed to read symbol "
+        LLVM_DEBUG(dbgs() << "Dyld::ReadSymbols: Failed to read symbol "
                           << Message << "\n");
         continue;
       }
@@ -962,7 +1646,34 @@ void Dyld::BuildBloomFilter(LibraryPath* Lib,
     }
   }
 
+  return SymbolsCount;
+#undef DEBUG_TYPE
+}
+
+void Dyld::BuildBloomFilter(LibraryPath* Lib,
+                            llvm::object::ObjectFile* BinObjFile,
+                            unsigned IgnoreSymbolFlags /*= 0*/) const {
+#define DEBUG_TYPE "Dyld::BuildBloomFilter:"
+  assert(m_UseBloomFilter && "Bloom filter is disabled");
+  assert(!Lib->hasBloomFilter() && "Already built!");
+
+  using namespace llvm;
+  using namespace llvm::object;
+
+  LLVM_DEBUG(
+      dbgs() << "Dyld::BuildBloomFilter: Start building Bloom filter for: "
+             << Lib->GetFullName() << "\n");
+  Count(&SearchStats::BloomBuilds);
+  StatTimer Timer(*this, &SearchStats::BloomBuildNs);
+
+  // If BloomFilter is empty then build it.
+  // Count Symbols and generate BloomFilter
+  std::list<llvm::StringRef> symbols;
+  uint32_t SymbolsCount = ReadSymbols(BinObjFile, IgnoreSymbolFlags, symbols);
+  Lib->m_SymbolsLoaded = m_UseHashTable;
+
   Lib->InitializeBloomFilter(SymbolsCount);
+  ++m_FilterGeneration;
 
   if (!SymbolsCount) {
     LLVM_DEBUG(dbgs() << "Dyld::BuildBloomFilter: No symbols!\n");
@@ -976,15 +1687,341 @@ void Dyld::BuildBloomFilter(LibraryPath* Lib,
                       << "- " << it << "\n");
 #endif
   // Generate BloomFilter
-  for (const auto& S : symbols) {
-    if (m_UseHashTable)
-      Lib->AddBloom(Lib->AddSymbol(S.str()));
+  std::vector<StringRef> Names(symbols.begin(), symbols.end());
+  std::vector<uint32_t> Hashes;
+  Hashes.reserve(Names.size());
+  for (StringRef S : Names) {
+    Hashes.push_back(GNUHash(S));
+    Lib->AddBloom(Hashes.back());
+  }
+  if (m_UseHashTable)
+    Count(&SearchStats::HashTableBytesBuilt,
+          Lib->SetSymbols(BinObjFile->getData(), Names, Hashes));
+#undef DEBUG_TYPE
+}
+
+void Dyld::BuildSymbolTable(LibraryPath* Lib,
+                            llvm::object::ObjectFile* BinObjFile,
+                            unsigned IgnoreSymbolFlags /*= 0*/) const {
+  assert(m_UseHashTable && "Hash table is disabled");
+  Count(&SearchStats::HashTableBuilds);
+  StatTimer Timer(*this, &SearchStats::HashTableBuildNs);
+  std::list<llvm::StringRef> symbols;
+  ReadSymbols(BinObjFile, IgnoreSymbolFlags, symbols);
+  std::vector<StringRef> Names(symbols.begin(), symbols.end());
+  std::vector<uint32_t> Hashes;
+  Hashes.reserve(Names.size());
+  for (StringRef S : Names)
+    Hashes.push_back(GNUHash(S));
+  Count(&SearchStats::HashTableBytesBuilt,
+        Lib->SetSymbols(BinObjFile->getData(), Names, Hashes));
+}
+
+/// The symbols which do not make a library a candidate for a search of user
+/// or system libraries.
+static unsigned GetIgnoreSymbolFlags(bool searchSystemLibraries) {
+  if (searchSystemLibraries)
+    return llvm::object::SymbolRef::SF_Undefined |
+           llvm::object::SymbolRef::SF_Weak;
+  return llvm::object::SymbolRef::SF_Undefined;
+}
+
+void Dyld::BuildFilters(const LibraryPaths& Libs, uint32_t Hash,
+                        unsigned IgnoreSymbolFlags) const {
+  std::vector<LibraryPath*> Pending;
+  for (const LibraryPath* P : Libs.GetLibraries())
+    if (!P->m_GnuHash.m_IsInitialized ||
+        (m_UseBloomFilter && !P->hasBloomFilter() &&
+         P->m_GnuHash.MayExist(Hash)))
+      Pending.push_back(const_cast<LibraryPath*>(P));
+  // A single library is left to ContainsSymbol, which can reuse its image.
+  if (Pending.size() < 2)
+    return;
+
+  // The image cache is not shared between threads: each task maps its
+  // library privately. The filters copy what they keep from the image.
+  llvm::parallelForEach(Pending, [&](LibraryPath* Lib) {
+    auto ObjF = OpenObjectFile(Lib->GetFullName());
+    if (!ObjF) {
+      llvm::consumeError(ObjF.takeError());
+      return;
+    }
+    llvm::object::ObjectFile* BinObjFile = ObjF->getBinary();
+    if (!Lib->m_GnuHash.m_IsInitialized) {
+      if (BinObjFile->isELF())
+        ReadElfGnuHashFilter(BinObjFile, Lib->m_GnuHash);
+      else
+        Lib->m_GnuHash.m_IsInitialized = true;
+    }
+    if (m_UseBloomFilter && !Lib->hasBloomFilter() &&
+        Lib->m_GnuHash.MayExist(Hash))
+      BuildBloomFilter(Lib, BinObjFile, IgnoreSymbolFlags);
+  });
+}
+
+std::string Dyld::GetIndexPath(bool searchSystemLibraries) const {
+  // One index per set of search paths: changing the paths selects another
+  // file instead of invalidating this one.
+  llvm::MD5 Hash;
+  Hash.update(m_ExecutableFormat);
+  for (const auto& Info : m_DynamicLibraryManager.getSearchPaths()) {
+    if (Info.IsUser == searchSystemLibraries)
+      continue;
+    Hash.update(Info.Path);
+    Hash.update(StringRef("", 1));
+  }
+  llvm::MD5::MD5Result Result;
+  Hash.final(Result);
+
+  SmallString<512> Path(m_DynamicLibraryManager.getIndexDirectory());
+  llvm::sys::path::append(Path, Twine(searchSystemLibraries ? "system-"
+                                                            : "user-") +
+                                    Result.digest().str() + ".dyldidx");
+  return Path.str().str();
+}
+
+bool Dyld::RestoreFromIndex(const DyldIndex& Index,
+                            bool searchSystemLibraries) {
+#define DEBUG_TYPE "Dyld::RestoreFromIndex:"
+  uint64_t Size, MTime;
+  for (const DyldIndexDir& D : Index.Dirs) {
+    StringRef Path = Index.getString(D.Path);
+    const bool Absent = !llvm::sys::fs::is_directory(Path) ||
+                        !GetFileStamp(Path, Size, MTime);
+    if (Absent != bool(D.Absent) || (!Absent && MTime != D.MTime)) {
+      LLVM_DEBUG(dbgs() << "Dyld::RestoreFromIndex: Changed directory "
+                        << Path << "\n");
+      // The scan which follows must not see what was cached of the old one.
+      invalidate_path_caches(Path);
+      return false;
+    }
+  }
+  for (const DyldIndexLib& L : Index.Libs)
+    if (!GetFileStamp(Index.getFullName(L), Size, MTime) || Size != L.Size ||
+        MTime != L.MTime) {
+      LLVM_DEBUG(dbgs() << "Dyld::RestoreFromIndex: Changed library "
+                        << Index.getFullName(L) << "\n");
+      return false;
+    }
+
+  LibraryPaths& Libs = searchSystemLibraries ? m_SysLibraries : m_Libraries;
+  for (const DyldIndexLib& L : Index.Libs) {
+    const BasePath& BaseP =
+        m_BasePaths.RegisterBasePath(Index.getString(L.Dir));
+    LibraryPath LibPath(BaseP, Index.getString(L.Name));
+    if (m_SysLibraries.HasRegisteredLib(LibPath) ||
+        m_Libraries.HasRegisteredLib(LibPath) ||
+        m_DynamicLibraryManager.isLibraryLoaded(LibPath.GetFullName()))
+      continue;
+    Index.restore(*const_cast<LibraryPath*>(Libs.RegisterLib(LibPath)), L);
+  }
+  LLVM_DEBUG(dbgs() << "Dyld::RestoreFromIndex: Restored "
+                    << Index.Libs.size() << " libraries\n");
+  return true;
+#undef DEBUG_TYPE
+}
+
+void Dyld::UpdateIndex(StringRef IndexPath, bool searchSystemLibraries,
+                       const DyldIndex* Old) {
+#define DEBUG_TYPE "Dyld::UpdateIndex:"
+  StringMap<const DyldIndexLib*> OldLibs;
+  if (Old)
+    for (const DyldIndexLib& L : Old->Libs)
+      OldLibs[Old->getFullName(L)] = &L;
+
+  const bool WithHashes = m_DynamicLibraryManager.indexSymbolHashes();
+  const unsigned IgnoreSymbolFlags =
+      GetIgnoreSymbolFlags(searchSystemLibraries);
+
+  StringMap<uint32_t> StrIndex;
+  std::string StrTab(1, '\0');
+  auto AddString = [&](StringRef S) -> uint32_t {
+    if (S.empty())
+      return 0;
+    auto R = StrIndex.try_emplace(S, StrTab.size());
+    if (R.second) {
+      StrTab.append(S.data(), S.size());
+      StrTab.push_back('\0');
+    }
+    return R.first->second;
+  };
+
+  std::vector<DyldIndexDir> Dirs;
+  std::vector<DyldIndexLib> Libs;
+  std::vector<uint64_t> Words;
+  std::vector<uint32_t> Hashes;
+
+  uint64_t Size, MTime;
+  llvm::SmallSet<std::string, 32> SeenDirs;
+  for (const auto& Info : m_DynamicLibraryManager.getSearchPaths()) {
+    if (Info.IsUser == searchSystemLibraries ||
+        !SeenDirs.insert(Info.Path).second)
+      continue;
+    const bool Absent = !llvm::sys::fs::is_directory(Info.Path) ||
+                        !GetFileStamp(Info.Path, Size, MTime);
+    Dirs.push_back(DyldIndexDir{AddString(Info.Path), Absent,
+                                Absent ? 0 : MTime});
+  }
+
+  // Reuse the filters of an unchanged library: the same size and either the
+  // same mtime or, if it was only touched, the same build-id. The remaining
+  // libraries are read concurrently.
+  const LibraryPaths& Scanned =
+      searchSystemLibraries ? m_SysLibraries : m_Libraries;
+  struct Entry {
+    LibraryPath* Lib;
+    uint64_t Size;
+    uint64_t MTime;
+    const DyldIndexLib* OldL;
+  };
+  std::vector<Entry> Entries;
+  std::vector<Entry*> Pending;
+  Entries.reserve(Scanned.size());
+  for (const LibraryPath* P : Scanned.GetLibraries()) {
+    auto* Lib = const_cast<LibraryPath*>(P);
+    const std::string FullName = Lib->GetFullName();
+    if (!GetFileStamp(FullName, Size, MTime))
+      continue;
+    auto OldIt = OldLibs.find(FullName);
+    const DyldIndexLib* OldL = OldIt != OldLibs.end() ? OldIt->second : nullptr;
+    if (OldL && (OldL->Size != Size || (WithHashes && !OldL->NumHashes)))
+      OldL = nullptr;
+    Entries.push_back(Entry{Lib, Size, MTime, OldL});
+    if (Lib->hasBloomFilter())
+      continue;
+    if (OldL && OldL->MTime == MTime)
+      Old->restore(*Lib, *OldL);
     else
-      Lib->AddBloom(S);
+      Pending.push_back(&Entries.back());
+  }
+
+  llvm::parallelForEach(Pending, [&](Entry* E) {
+    LibraryPath* Lib = E->Lib;
+    auto ObjF = OpenObjectFile(Lib->GetFullName());
+    if (!ObjF) {
+      llvm::consumeError(ObjF.takeError());
+      E->Lib = nullptr;
+      return;
+    }
+    llvm::object::ObjectFile* BinObjFile = ObjF->getBinary();
+    Lib->m_BuildId = llvm::toHex(llvm::object::getBuildID(BinObjFile));
+    if (E->OldL && !Lib->m_BuildId.empty() &&
+        Lib->m_BuildId == Old->getString(E->OldL->BuildId)) {
+      Old->restore(*Lib, *E->OldL);
+      return;
+    }
+    if (!Lib->m_GnuHash.m_IsInitialized) {
+      if (BinObjFile->isELF())
+        ReadElfGnuHashFilter(BinObjFile, Lib->m_GnuHash);
+      else
+        Lib->m_GnuHash.m_IsInitialized = true;
+    }
+    BuildBloomFilter(Lib, BinObjFile, IgnoreSymbolFlags);
+  });
+
+  for (const Entry& E : Entries) {
+    LibraryPath* Lib = E.Lib;
+    if (!Lib)
+      continue;
+    DyldIndexLib L = {};
+    L.Dir = AddString(Lib->m_Path);
+    L.Name = AddString(Lib->m_LibName);
+    L.BuildId = AddString(Lib->m_BuildId);
+    L.SymbolsCount = Lib->m_Filter.m_SymbolsCount;
+    L.Size = E.Size;
+    L.MTime = E.MTime;
+    L.FirstBloomWord = Words.size();
+    L.NumBloomWords = Lib->m_Filter.numWords();
+    if (L.NumBloomWords)
+      Words.insert(Words.end(), Lib->m_Filter.words(),
+                   Lib->m_Filter.words() + L.NumBloomWords);
+    L.FirstGnuWord = Words.size();
+    L.NumGnuWords = Lib->m_GnuHash.m_Words.size();
+    Words.insert(Words.end(), Lib->m_GnuHash.m_Words.begin(),
+                 Lib->m_GnuHash.m_Words.end());
+    L.GnuBits = Lib->m_GnuHash.m_Bits;
+    L.GnuShift2 = Lib->m_GnuHash.m_Shift2;
+    L.FirstHash = Hashes.size();
+    if (WithHashes) {
+      if (Lib->m_SymbolsLoaded) {
+        Lib->AppendSymbolHashes(Hashes);
+      } else {
+        Hashes.insert(Hashes.end(), Lib->m_SymbolHashes.begin(),
+                      Lib->m_SymbolHashes.end());
+      }
+    }
+    L.NumHashes = Hashes.size() - L.FirstHash;
+    Libs.push_back(L);
+  }
+
+  DyldIndexHeader H = {};
+  std::memcpy(H.Magic, kDyldIndexMagic, sizeof(H.Magic));
+  H.Version = kDyldIndexVersion;
+  H.PointerSize = sizeof(void*);
+  H.NumDirs = Dirs.size();
+  H.NumLibs = Libs.size();
+  H.NumWords = Words.size();
+  H.NumHashes = Hashes.size();
+  H.StrTabSize = StrTab.size();
+  uint64_t Offset = sizeof(DyldIndexHeader);
+  auto Place = [&Offset](uint64_t Size) {
+    uint64_t Start = llvm::alignTo(Offset, 8);
+    Offset = Start + Size;
+    return Start;
+  };
+  H.DirsOffset = Place(Dirs.size() * sizeof(DyldIndexDir));
+  H.LibsOffset = Place(Libs.size() * sizeof(DyldIndexLib));
+  H.WordsOffset = Place(Words.size() * sizeof(uint64_t));
+  H.HashesOffset = Place(Hashes.size() * sizeof(uint32_t));
+  H.StrTabOffset = Place(StrTab.size());
+
+  // Write to a temporary and rename it so that concurrent processes never
+  // map a partially written index.
+  if (llvm::sys::fs::create_directories(
+          m_DynamicLibraryManager.getIndexDirectory()))
+    return;
+  int FD;
+  SmallString<512> TmpPath;
+  if (llvm::sys::fs::createUniqueFile(IndexPath + "-%%%%%%.tmp", FD, TmpPath))
+    return;
+  llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+  auto Emit = [&OS](uint64_t At, const void* Data, size_t Size) {
+    OS.write_zeros(At - OS.tell());
+    OS.write(static_cast<const char*>(Data), Size);
+  };
+  Emit(0, &H, sizeof(H));
+  Emit(H.DirsOffset, Dirs.data(), Dirs.size() * sizeof(DyldIndexDir));
+  Emit(H.LibsOffset, Libs.data(), Libs.size() * sizeof(DyldIndexLib));
+  Emit(H.WordsOffset, Words.data(), Words.size() * sizeof(uint64_t));
+  Emit(H.HashesOffset, Hashes.data(), Hashes.size() * sizeof(uint32_t));
+  Emit(H.StrTabOffset, StrTab.data(), StrTab.size());
+  OS.close();
+  if (OS.has_error() || llvm::sys::fs::rename(TmpPath, IndexPath)) {
+    OS.clear_error();
+    llvm::sys::fs::remove(TmpPath);
+    LLVM_DEBUG(dbgs() << "Dyld::UpdateIndex: Failed to write " << IndexPath
+                      << "\n");
   }
 #undef DEBUG_TYPE
 }
 
+void Dyld::ScanOrRestoreLibraries(bool searchSystemLibraries) {
+  if (m_DynamicLibraryManager.getIndexDirectory().empty()) {
+    ScanForLibraries(searchSystemLibraries);
+    return;
+  }
+
+  std::string IndexPath = GetIndexPath(searchSystemLibraries);
+  std::unique_ptr<DyldIndex>& Index = m_Indexes[searchSystemLibraries];
+  Index = DyldIndex::open(IndexPath);
+  if (Index && RestoreFromIndex(*Index, searchSystemLibraries))
+    return;
+
+  ScanForLibraries(searchSystemLibraries);
+  // Keep the old index mapped: reused symbol hashes point into it.
+  UpdateIndex(IndexPath, searchSystemLibraries, Index.get());
+}
+
 bool Dyld::ContainsSymbol(const LibraryPath* Lib, StringRef mangledName,
                           unsigned IgnoreSymbolFlags /*= 0*/) const {
 #define DEBUG_TYPE "Dyld::ContainsSymbol:"
@@ -994,51 +2031,97 @@ bool Dyld::ContainsSymbol(const LibraryPath* Lib, StringRef mangledName,
                     << library_filename << ", mangled=" << mangledName.str()
                     << "\n");
 
-  auto ObjF = llvm::object::ObjectFile::createObjectFile(library_filename);
-  if (llvm::Error Err = ObjF.takeError()) {
-    std::string Message;
-    handleAllErrors(std::move(Err), [&](llvm::ErrorInfoBase& EIB) {
-      Message += EIB.message() + "; ";
-    });
-    LLVM_DEBUG(dbgs() << "Dyld::ContainsSymbol: Failed to read object file "
-                      << library_filename << " Errors: " << Message << "\n");
-    return false;
+  // The filters of a library are read from its image the first time they are
+  // needed. Afterwards negative answers come from them alone and the image is
+  // only needed when we have to iterate its symbols.
+  auto* MutableLib = const_cast<LibraryPath*>(Lib);
+  llvm::object::ObjectFile* BinObjFile = nullptr;
+  if (!Lib->m_GnuHash.m_IsInitialized) {
+    BinObjFile = GetObjectFile(Lib);
+    if (!BinObjFile)
+      return false;
+    if (BinObjFile->isELF())
+      ReadElfGnuHashFilter(BinObjFile, MutableLib->m_GnuHash);
+    else
+      MutableLib->m_GnuHash.m_IsInitialized = true;
   }
 
-  llvm::object::ObjectFile* BinObjFile = ObjF.get().getBinary();
-
   uint32_t hashedMangle = GNUHash(mangledName);
   // Check for the gnu.hash section if ELF.
   // If the symbol doesn't exist, exit early.
-  if (BinObjFile->isELF() &&
-      !MayExistInElfObjectFile(BinObjFile, hashedMangle)) {
+  const bool HasGnuHash = !Lib->m_GnuHash.m_Words.empty();
+  if (HasGnuHash)
+    Count(&SearchStats::GnuHashProbes);
+  if (!Lib->m_GnuHash.MayExist(hashedMangle)) {
     LLVM_DEBUG(dbgs() << "Dyld::ContainsSymbol: ELF BloomFilter: Skip symbol <"
                       << mangledName.str() << ">.\n");
     return false;
   }
+  if (HasGnuHash)
+    Count(&SearchStats::GnuHashPassed);
+
+  // Credits the filters which let the library through when it defines the
+  // symbol; the rest of what they passed are false positives.
+  auto Confirm = [&](bool Found) {
+    if (Found && HasGnuHash)
+      Count(&SearchStats::GnuHashHits);
+    if (Found && m_UseBloomFilter)
+      Count(&SearchStats::BloomHits);
+    return Found;
+  };
 
   if (m_UseBloomFilter) {
     // Use our bloom filters and create them if necessary.
-    if (!Lib->hasBloomFilter())
-      BuildBloomFilter(const_cast<LibraryPath*>(Lib), BinObjFile,
-                       IgnoreSymbolFlags);
+    if (!Lib->hasBloomFilter()) {
+      if (!BinObjFile)
+        BinObjFile = GetObjectFile(Lib);
+      if (!BinObjFile)
+        return false;
+      BuildBloomFilter(MutableLib, BinObjFile, IgnoreSymbolFlags);
+    }
 
     // If the symbol does not exist, exit early. In case it may exist, iterate.
+    Count(&SearchStats::BloomProbes);
     if (!Lib->MayExistSymbol(hashedMangle)) {
       LLVM_DEBUG(dbgs() << "Dyld::ContainsSymbol: BloomFilter: Skip symbol <"
                         << mangledName.str() << ">.\n");
       return false;
     }
+    Count(&SearchStats::BloomPassed);
     LLVM_DEBUG(dbgs() << "Dyld::ContainsSymbol: BloomFilter: Symbol <"
                       << mangledName.str() << "> May exist."
                       << " Search for it. ");
   }
 
+  if (!Lib->m_SymbolHashes.empty() &&
+      !std::binary_search(Lib->m_SymbolHashes.begin(),
+                          Lib->m_SymbolHashes.end(), hashedMangle)) {
+    LLVM_DEBUG(dbgs() << "Dyld::ContainsSymbol: Index: Skip symbol <"
+                      << mangledName.str() << ">.\n");
+    return false;
+  }
+
   if (m_UseHashTable) {
-    bool result = Lib->ExistSymbol(mangledName);
+    if (!Lib->m_SymbolsLoaded) {
+      if (!BinObjFile)
+        BinObjFile = GetObjectFile(Lib);
+      if (!BinObjFile)
+        return false;
+      BuildSymbolTable(MutableLib, BinObjFile, IgnoreSymbolFlags);
+    }
+    Count(&SearchStats::HashTableLookups);
+    // The compact table keeps only hashes and offsets: a name whose hash it
+    // has is compared against the image, mapping it again if it was evicted.
+    if (!BinObjFile && Lib->NeedsImageToConfirm(hashedMangle))
+      BinObjFile = GetObjectFile(Lib);
+    bool result = Lib->ExistSymbol(
+        mangledName, hashedMangle,
+        BinObjFile ? BinObjFile->getData() : StringRef());
     LLVM_DEBUG(dbgs() << "Dyld::ContainsSymbol: HashTable: Symbol "
                       << (result ? "Exist" : "Not exist") << "\n");
-    return result;
+    if (result)
+      Count(&SearchStats::HashTableHits);
+    return Confirm(result);
   }
 
   auto ForeachSymbol =
@@ -1090,10 +2173,18 @@ bool Dyld::ContainsSymbol(const LibraryPath* Lib, StringRef mangledName,
   LLVM_DEBUG(dbgs() << "Dyld::ContainsSymbol: Iterate all for <"
                     << mangledName.str() << ">");
 
+  if (!BinObjFile)
+    BinObjFile = GetObjectFile(Lib);
+  if (!BinObjFile)
+    return false;
+
+  Count(&SearchStats::SymbolIterations);
+  StatTimer Timer(*this, &SearchStats::SymbolIterationNs);
   // Symbol may exist. Iterate.
   if (ForeachSymbol(BinObjFile->symbols(), IgnoreSymbolFlags, mangledName)) {
     LLVM_DEBUG(dbgs() << " -> found.\n");
-    return true;
+    Count(&SearchStats::SymbolIterationHits);
+    return Confirm(true);
   }
 
   if (!BinObjFile->isELF()) {
@@ -1107,7 +2198,9 @@ bool Dyld::ContainsSymbol(const LibraryPath* Lib, StringRef mangledName,
   bool result = ForeachSymbol(ElfObj->getDynamicSymbolIterators(),
                               IgnoreSymbolFlags, mangledName);
   LLVM_DEBUG(dbgs() << (result ? " -> found.\n" : " -> not found.\n"));
-  return result;
+  if (result)
+    Count(&SearchStats::SymbolIterationHits);
+  return Confirm(result);
 #undef DEBUG_TYPE
 }
 
@@ -1123,7 +2216,7 @@ bool Dyld::ShouldPermanentlyIgnore(StringRef FileName) const {
   if (m_DynamicLibraryManager.isLibraryLoaded(FileName))
     return true;
 
-  auto ObjF = llvm::object::ObjectFile::createObjectFile(FileName);
+  auto ObjF = OpenObjectFile(FileName);
   if (!ObjF) {
     llvm::consumeError(ObjF.takeError());
     LLVM_DEBUG(dbgs() << "[DyLD] Failed to read object file " << FileName
@@ -1187,39 +2280,248 @@ void Dyld::dumpDebugInfo() const {
                       << "\n");
   }
 #endif
+  LLVM_DEBUG({
+    dbgs() << "Dyld: Search stats:";
+    getSearchStats().forEach([](const char* Name, uint64_t Value) {
+      dbgs() << " " << Name << "=" << Value;
+    });
+    dbgs() << "\n";
+  });
 #undef DEBUG_TYPE
 }
 
-std::string Dyld::searchLibrariesForSymbol(StringRef mangledName,
-                                           bool searchSystem /* = true*/) {
+void Dyld::ScanOnce(bool searchSystemLibraries) {
 #define DEBUG_TYPE "Dyld:searchLibrariesForSymbol:"
-  assert(
-      !llvm::sys::DynamicLibrary::SearchForAddressOfSymbol(mangledName.str()) &&
-      "Library already loaded, please use dlsym!");
-  assert(!mangledName.empty());
+  bool& FirstRun = searchSystemLibraries ? m_FirstRunSysLib : m_FirstRun;
+  if (!FirstRun)
+    return;
+
+  const char* Kind = searchSystemLibraries ? "system" : "user";
+  LLVM_DEBUG(dbgs() << "Dyld::searchLibrariesForSymbol: FirstRun(" << Kind
+                    << ")... scanning\n");
+
+  LLVM_DEBUG(dbgs() << "Dyld::searchLibrariesForSymbol: Before first " << Kind
+                    << " ScanForLibraries\n");
+  dumpDebugInfo();
+
+  // Watch first, so that changes during the scan are not lost.
+  if (m_DynamicLibraryManager.watchSearchPaths())
+    WatchDirectories(searchSystemLibraries);
+  {
+    const size_t Before = m_Libraries.size() + m_SysLibraries.size();
+    Count(&SearchStats::Scans);
+    StatTimer Timer(*this, &SearchStats::ScanNs);
+    ScanOrRestoreLibraries(searchSystemLibraries);
+    Count(&SearchStats::ScannedLibraries,
+          m_Libraries.size() + m_SysLibraries.size() - Before);
+  }
+  FirstRun = false;
+  m_SymbolIndexDirty = true;
+  ++m_FilterGeneration;
+
+  LLVM_DEBUG(dbgs() << "Dyld::searchLibrariesForSymbol: After first " << Kind
+                    << " ScanForLibraries\n");
+  dumpDebugInfo();
+#undef DEBUG_TYPE
+}
+
+void Dyld::ForgetLibrary(const LibraryPath& Lib) {
+  // Lib may be the registered copy, which unregistering destroys.
+  const LibraryPath Key(Lib.m_Path, Lib.m_LibName);
+  for (const LibraryPath* Registered : {m_Libraries.GetRegisteredLib(Key),
+                                        m_SysLibraries.GetRegisteredLib(Key)})
+    if (Registered) {
+      ReleaseObjectFile(Registered);
+      m_SymbolIndex.Forget(Registered);
+    }
+  m_Libraries.UnregisterLib(Key);
+  m_SysLibraries.UnregisterLib(Key);
+  ++m_FilterGeneration;
+}
+
+void Dyld::WatchDirectories(bool searchSystemLibraries) {
+#ifdef __linux__
+  if (m_Watching[searchSystemLibraries])
+    return;
+  if (m_WatchFd == -1)
+    m_WatchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_WatchFd == -1)
+    return;
+  m_Watching[searchSystemLibraries] = true;
+
+  // The directories ScanForLibraries lists. Dependencies found through
+  // RPATH/RUNPATH elsewhere are not watched.
+  for (const auto& Info : m_DynamicLibraryManager.getSearchPaths()) {
+    if (Info.IsUser == searchSystemLibraries)
+      continue;
+    std::string Dir = cached_realpath(Info.Path);
+    if (Dir.empty() || !llvm::sys::fs::is_directory(Dir))
+      continue;
+    int WD = inotify_add_watch(m_WatchFd, Dir.c_str(),
+                               IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO |
+                                   IN_DELETE | IN_MOVED_FROM | IN_ONLYDIR);
+    // A directory on both kinds of paths belongs to the first one scanned.
+    if (WD != -1)
+      m_WatchedDirs.try_emplace(WD, WatchedDir{Dir, searchSystemLibraries});
+  }
+#endif
+}
 
-  using namespace llvm::sys::path;
-  using namespace llvm::sys::fs;
+void Dyld::UpdateWatches() {
+#ifdef __linux__
+  if (!m_DynamicLibraryManager.watchSearchPaths()) {
+    if (m_WatchFd != -1) {
+      ::close(m_WatchFd);
+      m_WatchFd = -1;
+      m_WatchedDirs.clear();
+      m_Watching[0] = m_Watching[1] = false;
+    }
+    return;
+  }
+  // Watching was turned on after a scan; changes made in between are missed.
+  if (!m_FirstRun)
+    WatchDirectories(/*searchSystemLibraries=*/false);
+  if (!m_FirstRunSysLib)
+    WatchDirectories(/*searchSystemLibraries=*/true);
+#endif
+}
 
-  if (m_FirstRun) {
-    LLVM_DEBUG(dbgs() << "Dyld::searchLibrariesForSymbol:" << mangledName.str()
-                      << ", searchSystem=" << (searchSystem ? "true" : "false")
-                      << ", FirstRun(user)... scanning\n");
+size_t Dyld::ScanOrderPosition(const LibraryPath& Lib,
+                               bool searchSystemLibraries) {
+  const LibraryPaths& Libs =
+      searchSystemLibraries ? m_SysLibraries : m_Libraries;
+  // The search paths of the kind, in the order ScanForLibraries lists them.
+  llvm::DenseMap<const BasePath*, size_t> Rank;
+  for (const auto& Info : m_DynamicLibraryManager.getSearchPaths()) {
+    if (Info.IsUser == searchSystemLibraries)
+      continue;
+    std::string Dir = cached_realpath(Info.Path);
+    if (!Dir.empty())
+      Rank.try_emplace(&m_BasePaths.RegisterBasePath(Dir), Rank.size());
+  }
+  auto Own = Rank.find(&Lib.m_Path);
+  if (Own == Rank.end())
+    return Libs.size();
+  const auto& Registered = Libs.GetLibraries();
+  for (size_t I = 0, E = Registered.size(); I < E; ++I) {
+    auto Other = Rank.find(&Registered[I]->m_Path);
+    if (Other != Rank.end() && Other->second > Own->second)
+      return I;
+  }
+  return Libs.size();
+}
 
-    LLVM_DEBUG(
-        dbgs()
-        << "Dyld::searchLibrariesForSymbol: Before first ScanForLibraries\n");
-    dumpDebugInfo();
+void Dyld::ApplyChange(StringRef Path, bool searchSystemLibraries) {
+#define DEBUG_TYPE "Dyld::ApplyChange:"
+  // A library reached through a symlink is registered under its target;
+  // ask the caches where Path pointed before dropping them.
+  std::string Old = cached_realpath(Path);
+  if (Old.empty())
+    Old = Path.str();
+  invalidate_path_caches(Path);
+  invalidate_path_caches(Old);
+
+  LibraryPath OldLib(
+      m_BasePaths.RegisterBasePath(llvm::sys::path::parent_path(Old).str()),
+      llvm::sys::path::filename(Old).str());
+  LibraryPaths& Libs = searchSystemLibraries ? m_SysLibraries : m_Libraries;
+  const size_t OldPos = Libs.GetPosition(OldLib);
+  const bool WasRegistered = OldPos < Libs.size();
+  ForgetLibrary(OldLib);
+  m_QueriedLibraries.UnregisterLib(OldLib);
+
+  std::string New = cached_realpath(Path);
+  if (New.empty() || llvm::sys::fs::is_directory(New))
+    return;
+  LibraryPath NewLib(
+      m_BasePaths.RegisterBasePath(llvm::sys::path::parent_path(New).str()),
+      llvm::sys::path::filename(New).str());
+  if (m_Libraries.HasRegisteredLib(NewLib) ||
+      m_SysLibraries.HasRegisteredLib(NewLib) ||
+      m_DynamicLibraryManager.isLibraryLoaded(New))
+    return;
+  // Registered like ScanForLibraries does; the filters are built on demand.
+  ScannedLibrary Info = ReadLibraryInfo(New);
+  if (Info.Ignored || Info.IsPIEExecutable)
+    return;
+  LLVM_DEBUG(dbgs() << "Dyld::ApplyChange: Registering " << New << "\n");
+  // A rewritten library keeps its place in the search order, and a new one
+  // goes where a scan would put it: after the libraries of the search paths
+  // before its own.
+  const size_t Pos =
+      WasRegistered ? OldPos : ScanOrderPosition(NewLib, searchSystemLibraries);
+  Libs.RegisterLibAt(NewLib, Pos);
+#undef DEBUG_TYPE
+}
 
-    ScanForLibraries(/* SearchSystemLibraries= */ false);
-    m_FirstRun = false;
+void Dyld::ApplyWatchEvents() {
+#ifdef __linux__
+#define DEBUG_TYPE "Dyld::ApplyWatchEvents:"
+  if (m_WatchFd == -1)
+    return;
 
-    LLVM_DEBUG(
-        dbgs()
-        << "Dyld::searchLibrariesForSymbol: After first ScanForLibraries\n");
-    dumpDebugInfo();
+  // The last kind of change does not matter: the file is examined when the
+  // change is applied.
+  llvm::MapVector<std::string, bool> Changed;
+  bool Overflow = false;
+  alignas(struct inotify_event) char Buf[4096];
+  ssize_t Len;
+  while ((Len = ::read(m_WatchFd, Buf, sizeof(Buf))) > 0) {
+    for (const char* P = Buf; P < Buf + Len;) {
+      const auto* E = reinterpret_cast<const struct inotify_event*>(P);
+      P += sizeof(struct inotify_event) + E->len;
+      if (E->mask & IN_Q_OVERFLOW) {
+        Overflow = true;
+        continue;
+      }
+      auto W = m_WatchedDirs.find(E->wd);
+      if (W == m_WatchedDirs.end())
+        continue;
+      if (E->mask & IN_IGNORED) {
+        m_WatchedDirs.erase(W);
+        continue;
+      }
+      if (!E->len)
+        continue;
+      SmallString<512> Path(W->second.Path);
+      llvm::sys::path::append(Path, E->name);
+      Changed.insert({Path.str().str(), W->second.System});
+    }
   }
 
+  if (Overflow) {
+    // Events were lost: fall back to scanning again.
+    LLVM_DEBUG(dbgs() << "Dyld::ApplyWatchEvents: Overflow, rescanning\n");
+    std::vector<const LibraryPath*> All(m_Libraries.GetLibraries());
+    All.insert(All.end(), m_SysLibraries.GetLibraries().begin(),
+               m_SysLibraries.GetLibraries().end());
+    for (const LibraryPath* P : All)
+      ForgetLibrary(*P);
+    invalidate_path_caches("");
+    m_FirstRun = true;
+    m_FirstRunSysLib = true;
+    m_SymbolIndexDirty = true;
+    return;
+  }
+  if (Changed.empty())
+    return;
+
+  for (const auto& C : Changed)
+    ApplyChange(C.first, C.second);
+  m_SymbolIndexDirty = true;
+  ++m_RescansAvoided;
+  LLVM_DEBUG(dbgs() << "Dyld::ApplyWatchEvents: Applied " << Changed.size()
+                    << " changes\n");
+#undef DEBUG_TYPE
+#endif
+}
+
+void Dyld::PrepareSearch() {
+#define DEBUG_TYPE "Dyld:searchLibrariesForSymbol:"
+  UpdateWatches();
+  ApplyWatchEvents();
+  ScanOnce(/* SearchSystemLibraries= */ false);
+
   if (m_QueriedLibraries.size() > 0) {
     // Last call we were asked if a library contains a symbol. Usually, the
     // caller wants to load this library. Check if was loaded and remove it
@@ -1238,16 +2540,183 @@ std::string Dyld::searchLibrariesForSymbol(StringRef mangledName,
       if (!m_DynamicLibraryManager.isLibraryLoaded(LibName))
         continue;
 
-      m_Libraries.UnregisterLib(*P);
-      m_SysLibraries.UnregisterLib(*P);
+      ForgetLibrary(*P);
     }
     // TODO:  m_QueriedLibraries.clear ?
   }
+#undef DEBUG_TYPE
+}
+
+std::string Dyld::searchLibrariesForSymbol(StringRef mangledName,
+                                           bool searchSystem /* = true*/) {
+  assert(
+      !llvm::sys::DynamicLibrary::SearchForAddressOfSymbol(mangledName.str()) &&
+      "Library already loaded, please use dlsym!");
+  assert(!mangledName.empty());
+
+  Count(&SearchStats::Searches);
+  StatTimer Timer(*this, &SearchStats::SearchNs);
+  PrepareSearch();
+  return LookupSymbol(mangledName, searchSystem);
+}
+
+std::vector<std::string>
+Dyld::searchLibrariesForSymbols(ArrayRef<StringRef> mangledNames,
+                                bool searchSystem /* = true*/) {
+  Count(&SearchStats::Searches, mangledNames.size());
+  StatTimer Timer(*this, &SearchStats::SearchNs);
+  PrepareSearch();
+  std::vector<std::string> Result;
+  Result.reserve(mangledNames.size());
+  for (StringRef mangledName : mangledNames) {
+    assert(!llvm::sys::DynamicLibrary::SearchForAddressOfSymbol(
+               mangledName.str()) &&
+           "Library already loaded, please use dlsym!");
+    Result.push_back(mangledName.empty()
+                         ? std::string()
+                         : LookupSymbol(mangledName, searchSystem));
+  }
+  return Result;
+}
+
+/// Asks the kernel to read \p FileName into the page cache, so that mapping
+/// it later does not fault it in page by page.
+static void PrefetchFile(StringRef FileName) {
+#ifdef LLVM_ON_UNIX
+  int FD = ::open(FileName.str().c_str(), O_RDONLY | O_CLOEXEC);
+  if (FD == -1)
+    return;
+#if defined(__linux__)
+  struct stat St;
+  if (!fstat(FD, &St))
+    readahead(FD, 0, St.st_size);
+#elif defined(__APPLE__)
+  struct stat St;
+  if (!fstat(FD, &St)) {
+    struct radvisory Advice;
+    Advice.ra_offset = 0;
+    Advice.ra_count = static_cast<int>(
+        std::min<off_t>(St.st_size, std::numeric_limits<int>::max()));
+    fcntl(FD, F_RDADVISE, &Advice);
+  }
+#else
+  posix_fadvise(FD, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+  ::close(FD);
+#endif // LLVM_ON_UNIX
+}
+
+///\returns true if the dynamic loader already has \p FileName loaded, e.g.
+/// the C and C++ runtimes, so there is nothing to prefetch.
+static bool IsLoadedInProcess(StringRef FileName) {
+#ifdef LLVM_ON_UNIX
+  if (void* Handle =
+          dlopen(FileName.str().c_str(), RTLD_LAZY | RTLD_NOLOAD)) {
+    dlclose(Handle);
+    return true;
+  }
+#endif // LLVM_ON_UNIX
+  return false;
+}
+
+std::vector<std::string>
+Dyld::PrefetchDependencyGraph(ArrayRef<std::string> Libs) const {
+#define DEBUG_TYPE "Dyld::PrefetchDependencyGraph:"
+  struct Node {
+    ScannedLibrary Info;
+    std::vector<size_t> Deps;
+    bool Requested = false;
+  };
+  std::vector<std::string> Files;
+  std::vector<Node> Nodes;
+  StringMap<size_t> FileIndex;
+  for (const std::string& Lib : Libs)
+    if (FileIndex.try_emplace(Lib, Files.size()).second)
+      Files.push_back(Lib);
+  const size_t NumRequested = Files.size();
+  Nodes.resize(NumRequested);
+  for (Node& N : Nodes)
+    N.Requested = true;
+
+  // Breadth first: the libraries of a level are read and prefetched
+  // concurrently, then their dependencies make up the next level.
+  for (size_t Begin = 0; Begin < Files.size();) {
+    const size_t End = Files.size();
+    Nodes.resize(End);
+    llvm::parallelFor(Begin, End, [&](size_t I) {
+      PrefetchFile(Files[I]);
+      Nodes[I].Info = ReadLibraryInfo(Files[I]);
+    });
+    for (size_t I = Begin; I < End; ++I) {
+      const ScannedLibrary& Info = Nodes[I].Info;
+      if (Info.Ignored || !Info.Readable)
+        continue;
+      llvm::SmallVector<llvm::StringRef, 2> RPath(Info.RPath.begin(),
+                                                  Info.RPath.end());
+      llvm::SmallVector<llvm::StringRef, 2> RunPath(Info.RunPath.begin(),
+                                                    Info.RunPath.end());
+      for (const std::string& Dep : Info.Deps) {
+        std::string DepPath = m_DynamicLibraryManager.lookupLibrary(
+            Dep, RPath, RunPath, Files[I], false);
+        if (DepPath.empty())
+          continue;
+        auto Found = FileIndex.find(DepPath);
+        if (Found == FileIndex.end()) {
+          if (m_DynamicLibraryManager.isLibraryLoaded(DepPath) ||
+              IsLoadedInProcess(DepPath))
+            continue;
+          Found = FileIndex.try_emplace(DepPath, Files.size()).first;
+          Files.push_back(DepPath);
+        }
+        Nodes[I].Deps.push_back(Found->second);
+      }
+    }
+    LLVM_DEBUG(dbgs() << "Dyld::PrefetchDependencyGraph: Read "
+                      << End - Begin << " libraries\n");
+    Begin = End;
+  }
+
+  // Postorder of a depth-first walk from each requested library, in request
+  // order. A dependency cycle is broken where the walk re-enters it.
+  enum : uint8_t { kNew, kVisiting, kDone };
+  std::vector<uint8_t> State(Files.size(), kNew);
+  std::vector<std::string> Order;
+  std::function<void(size_t)> Visit = [&](size_t I) {
+    if (State[I] != kNew)
+      return;
+    State[I] = kVisiting;
+    for (size_t Dep : Nodes[I].Deps)
+      Visit(Dep);
+    State[I] = kDone;
+    if (Nodes[I].Requested)
+      Order.push_back(Files[I]);
+  };
+  for (size_t I = 0; I < NumRequested; ++I)
+    Visit(I);
+  return Order;
+#undef DEBUG_TYPE
+}
 
-  // Iterate over files under this path. We want to get each ".so" files
-  for (const LibraryPath* P : m_Libraries.GetLibraries()) {
+std::string Dyld::LookupSymbol(StringRef mangledName, bool searchSystem) {
+#define DEBUG_TYPE "Dyld:searchLibrariesForSymbol:"
+  if (m_DynamicLibraryManager.useSymbolIndex())
+    return LookupSymbolInIndex(mangledName, searchSystem);
+
+  const uint32_t hashedMangle = GNUHash(mangledName);
+  BuildFilters(m_Libraries, hashedMangle,
+               GetIgnoreSymbolFlags(/*searchSystemLibraries=*/false));
+
+  // Only the libraries whose bloom filter may contain the symbol are
+  // searched; the filters of all of them are tested in one pass.
+  const FilterSet& UserSet = GetFilterSet(/*searchSystemLibraries=*/false);
+  UserSet.m_Filters.Probe(hashedMangle, m_Candidates);
+  Count(&SearchStats::FilterSetProbes, UserSet.m_Filters.size());
+  for (uint32_t I : m_Candidates) {
+    const LibraryPath* P = UserSet.m_Libs[I];
+    Count(&SearchStats::FilterSetPassed);
     if (ContainsSymbol(P, mangledName, /*ignore*/
                        llvm::object::SymbolRef::SF_Undefined)) {
+      Count(&SearchStats::FilterSetHits);
       if (!m_QueriedLibraries.HasRegisteredLib(*P))
         m_QueriedLibraries.RegisterLib(*P);
 
@@ -1265,27 +2734,21 @@ std::string Dyld::searchLibrariesForSymbol(StringRef mangledName,
   LLVM_DEBUG(dbgs() << "Dyld::searchLibrariesForSymbol: SearchSystem!!!\n");
 
   // Lookup in non-system libraries failed. Expand the search to the system.
-  if (m_FirstRunSysLib) {
-    LLVM_DEBUG(dbgs() << "Dyld::searchLibrariesForSymbol:" << mangledName.str()
-                      << ", searchSystem=" << (searchSystem ? "true" : "false")
-                      << ", FirstRun(system)... scanning\n");
-
-    LLVM_DEBUG(dbgs() << "Dyld::searchLibrariesForSymbol: Before first system "
-                         "ScanForLibraries\n");
-    dumpDebugInfo();
+  ScanOnce(/* SearchSystemLibraries= */ true);
 
-    ScanForLibraries(/* SearchSystemLibraries= */ true);
-    m_FirstRunSysLib = false;
+  BuildFilters(m_SysLibraries, hashedMangle,
+               GetIgnoreSymbolFlags(/*searchSystemLibraries=*/true));
 
-    LLVM_DEBUG(dbgs() << "Dyld::searchLibrariesForSymbol: After first system "
-                         "ScanForLibraries\n");
-    dumpDebugInfo();
-  }
-
-  for (const LibraryPath* P : m_SysLibraries.GetLibraries()) {
+  const FilterSet& SysSet = GetFilterSet(/*searchSystemLibraries=*/true);
+  SysSet.m_Filters.Probe(hashedMangle, m_Candidates);
+  Count(&SearchStats::FilterSetProbes, SysSet.m_Filters.size());
+  for (uint32_t I : m_Candidates) {
+    const LibraryPath* P = SysSet.m_Libs[I];
+    Count(&SearchStats::FilterSetPassed);
     if (ContainsSymbol(P, mangledName, /*ignore*/
                        llvm::object::SymbolRef::SF_Undefined |
                            llvm::object::SymbolRef::SF_Weak)) {
+      Count(&SearchStats::FilterSetHits);
       if (!m_QueriedLibraries.HasRegisteredLib(*P))
         m_QueriedLibraries.RegisterLib(*P);
 
@@ -1303,6 +2766,104 @@ std::string Dyld::searchLibrariesForSymbol(StringRef mangledName,
 #undef DEBUG_TYPE
 }
 
+const Dyld::FilterSet& Dyld::GetFilterSet(bool searchSystemLibraries) {
+  FilterSet& Set = m_FilterSets[searchSystemLibraries];
+  const uint64_t Generation = m_FilterGeneration.load();
+  if (Set.m_Generation == Generation)
+    return Set;
+
+  // Libraries without a filter yet stay candidates; ContainsSymbol builds
+  // their filter.
+  const LibraryPaths& Libs =
+      searchSystemLibraries ? m_SysLibraries : m_Libraries;
+  Set.m_Libs = Libs.GetLibraries();
+  Set.m_Filters.clear();
+  for (const LibraryPath* P : Set.m_Libs)
+    Set.m_Filters.Add(m_UseBloomFilter && P->hasBloomFilter() ? &P->m_Filter
+                                                              : nullptr);
+  Set.m_Generation = Generation;
+  return Set;
+}
+
+void Dyld::BuildSymbolIndex(bool searchSystem) {
+#define DEBUG_TYPE "Dyld::BuildSymbolIndex:"
+  if (searchSystem)
+    ScanOnce(/* SearchSystemLibraries= */ true);
+  if (!m_SymbolIndexDirty && (m_SymbolIndex.HasSystem() || !searchSystem))
+    return;
+
+  // Library ids follow the search order: user libraries, then system ones.
+  std::vector<const LibraryPath*> Libs(m_Libraries.GetLibraries());
+  const size_t NumUser = Libs.size();
+  if (searchSystem)
+    Libs.insert(Libs.end(), m_SysLibraries.GetLibraries().begin(),
+                m_SysLibraries.GetLibraries().end());
+
+  // The hashes come from the persistent index or the symbol table when we
+  // have them, and are read from the images otherwise.
+  std::vector<std::vector<uint32_t>> Hashes(Libs.size());
+  llvm::parallelFor(0, Libs.size(), [&](size_t I) {
+    const LibraryPath* Lib = Libs[I];
+    std::vector<uint32_t>& Out = Hashes[I];
+    if (!Lib->m_SymbolHashes.empty()) {
+      Out.assign(Lib->m_SymbolHashes.begin(), Lib->m_SymbolHashes.end());
+      return;
+    }
+    if (Lib->m_SymbolsLoaded) {
+      Lib->AppendSymbolHashes(Out);
+      return;
+    }
+    auto ObjF = OpenObjectFile(Lib->GetFullName());
+    if (!ObjF) {
+      llvm::consumeError(ObjF.takeError());
+      return;
+    }
+    std::list<llvm::StringRef> symbols;
+    ReadSymbols(ObjF->getBinary(), GetIgnoreSymbolFlags(I >= NumUser),
+                symbols);
+    for (StringRef S : symbols)
+      Out.push_back(GNUHash(S));
+  });
+
+  m_SymbolIndex.Build(std::move(Libs), NumUser, searchSystem, Hashes);
+  m_SymbolIndexDirty = false;
+  LLVM_DEBUG(dbgs() << "Dyld::BuildSymbolIndex: " << m_SymbolIndex.size()
+                    << " distinct hashes\n");
+#undef DEBUG_TYPE
+}
+
+std::string Dyld::LookupSymbolInIndex(StringRef mangledName,
+                                      bool searchSystem) {
+#define DEBUG_TYPE "Dyld:searchLibrariesForSymbol:"
+  BuildSymbolIndex(searchSystem);
+
+  // The candidates share the hash of the symbol; confirm them in search
+  // order.
+  ArrayRef<uint32_t> Candidates = m_SymbolIndex.Lookup(GNUHash(mangledName));
+  Count(&SearchStats::SymbolIndexLookups);
+  Count(&SearchStats::SymbolIndexCandidates, Candidates.size());
+  for (uint32_t Id : Candidates) {
+    const bool IsSystem = Id >= m_SymbolIndex.NumUser();
+    if (IsSystem && !searchSystem)
+      break;
+    const LibraryPath* P = m_SymbolIndex.GetLibrary(Id);
+    if (!P || !ContainsSymbol(P, mangledName, GetIgnoreSymbolFlags(IsSystem)))
+      continue;
+    Count(&SearchStats::SymbolIndexHits);
+
+    if (!m_QueriedLibraries.HasRegisteredLib(*P))
+      m_QueriedLibraries.RegisterLib(*P);
+
+    LLVM_DEBUG(dbgs() << "Dyld::ResolveSymbol: Index found match: "
+                      << P->GetFullName() << "!\n");
+    return P->GetFullName();
+  }
+
+  LLVM_DEBUG(dbgs() << "Dyld::ResolveSymbol: Index found no match!\n");
+  return "";
+#undef DEBUG_TYPE
+}
+
 DynamicLibraryManager::~DynamicLibraryManager() {
   static_assert(sizeof(Dyld) > 0, "Incomplete type");
   delete m_Dyld;
@@ -1327,6 +2888,59 @@ std::string DynamicLibraryManager::searchLibrariesForSymbol(
   return m_Dyld->searchLibrariesForSymbol(mangledName, searchSystem);
 }
 
+std::vector<std::string> DynamicLibraryManager::searchLibrariesForSymbols(
+    llvm::ArrayRef<llvm::StringRef> mangledNames,
+    bool searchSystem /* = true*/) const {
+  assert(m_Dyld && "Must call initialize dyld before!");
+  return m_Dyld->searchLibrariesForSymbols(mangledNames, searchSystem);
+}
+
+void DynamicLibraryManager::setMappingBudget(size_t Bytes) {
+  m_MappingBudget = Bytes;
+  if (m_Dyld)
+    m_Dyld->TrimObjectFiles(Bytes);
+}
+
+std::vector<DynamicLibraryManager::LoadLibResult>
+DynamicLibraryManager::loadLibraries(llvm::ArrayRef<std::string> Libs,
+                                     bool permanent) {
+  std::vector<std::string> Order =
+      m_Dyld ? m_Dyld->PrefetchDependencyGraph(Libs)
+             : std::vector<std::string>(Libs.begin(), Libs.end());
+  StringMap<LoadLibResult> Loaded;
+  for (const std::string& Lib : Order)
+    Loaded[Lib] = loadLibrary(Lib, permanent, /*resolved=*/true);
+
+  std::vector<LoadLibResult> Results;
+  Results.reserve(Libs.size());
+  for (const std::string& Lib : Libs)
+    Results.push_back(Loaded.lookup(Lib));
+  return Results;
+}
+
+bool DynamicLibraryManager::setWatchSearchPaths(bool Watch) {
+#ifdef __linux__
+  m_WatchSearchPaths = Watch;
+  return true;
+#else
+  return !Watch;
+#endif
+}
+
+size_t DynamicLibraryManager::getRescansAvoided() const {
+  return m_Dyld ? m_Dyld->getRescansAvoided() : 0;
+}
+
+DynamicLibraryManager::SearchStats
+DynamicLibraryManager::getSearchStats() const {
+  return m_Dyld ? m_Dyld->getSearchStats() : SearchStats();
+}
+
+void DynamicLibraryManager::resetSearchStats() {
+  if (m_Dyld)
+    m_Dyld->resetSearchStats();
+}
+
 std::string DynamicLibraryManager::getSymbolLocation(void* func) {
 #if defined(__CYGWIN__) && defined(__GNUC__)
   return {};
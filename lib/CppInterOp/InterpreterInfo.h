@@ -21,10 +21,13 @@
 #include "clang/AST/Decl.h"
 #include "clang/AST/Type.h"
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/FoldingSet.h"
 #include "llvm/ADT/StringMap.h"
 
 #include <deque>
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -36,10 +39,110 @@ struct InterpreterInfo {
   bool isOwned = true;
   // Store the list of builtin types.
   llvm::StringMap<clang::QualType> BuiltinMap;
+  // Every cache below that is keyed on a decl or a type, or holds
+  // JIT-compiled code, is dropped by Undo and UnloadLibrary (see
+  // forgetUnloadedCode in CppInterOp.cpp): they may free decls, whose memory
+  // a later decl can reuse, and code.
+  //
   // Per-interpreter wrapper caches. Keyed on AST nodes that belong to this
   // interpreter, so the caches must be destroyed together with it.
   std::map<const clang::FunctionDecl*, void*> WrapperStore;
   std::map<const clang::Decl*, void*> DtorWrapperStore;
+  // Dense type ids handed out by GetTypeId. TypeIds maps the opaque pointer
+  // of a canonical QualType to its id; TypeIdTable is indexed by id (slot 0
+  // is reserved for the null type) and caches the properties of each type.
+  // Undo and UnloadLibrary retire the ids handed out so far: their entries
+  // are reset to the null type, and ids are never reused.
+  struct TypeIdEntry {
+    clang::QualType Type;
+    TypeIdInfo Info;
+    // False while Type is incomplete, so that Info is recomputed once the
+    // definition becomes available.
+    bool IsFinal = false;
+  };
+  llvm::DenseMap<const void*, size_t> TypeIds;
+  std::vector<TypeIdEntry> TypeIdTable;
+  // GetVariableOffset results keyed on (variable, canonical record the
+  // field is accessed through). Static data members use a null record.
+  // Field offsets are fixed once the record is laid out and the addresses
+  // of globals never move.
+  llvm::DenseMap<std::pair<const clang::Decl*, const clang::Decl*>, intptr_t>
+      VariableOffsets;
+  // InstantiateTemplate memo: the key profiles the canonical template decl
+  // followed by its canonical template argument list.
+  std::map<llvm::FoldingSetNodeID, clang::Decl*> TemplateInstantiations;
+  // GetVTableLayoutInfo results keyed on the canonical class decl. Only
+  // complete classes are cached, and their vtable layout never changes.
+  llvm::DenseMap<const clang::Decl*, VTableLayoutInfo> VTableLayouts;
+  // Vtable group of the classes whose objects carry several vptrs, keyed
+  // like VTableLayouts (Itanium only). Slots count from the primary address
+  // point, as in VTableLayoutInfo, and run on through the secondary vtables.
+  struct VTableGroup {
+    // Index of the primary address point in the group, and the group size.
+    int AddressPoint = 0;
+    int NumComponents = 0;
+    // (object offset of a vptr, slot of its address point), primary first.
+    std::vector<std::pair<intptr_t, int>> VPtrs;
+    // Every slot filled by one final overrider, as (slot, object offset of
+    // the subobject whose vtable holds the slot).
+    struct Overrider {
+      const clang::Decl* Method = nullptr;
+      std::vector<std::pair<int, intptr_t>> Slots;
+      // Some slot of the overrider needs a covariant return adjustment.
+      bool AdjustsReturn = false;
+    };
+    std::vector<Overrider> Overriders;
+    // Overriders index of each canonical method and of each slot (-1 for
+    // slots that hold no method).
+    llvm::DenseMap<const clang::Decl*, int> OverriderIndex;
+    std::vector<int> SlotOverrider;
+    // (slot, object offset) of each deleting destructor.
+    std::vector<std::pair<int, intptr_t>> DeletingDtors;
+    // JIT-compiled this-adjusting overlay thunks keyed on (Overriders
+    // index, or -1 for the deleting destructor; object offset).
+    std::map<std::pair<int, intptr_t>, void*> Thunks;
+  };
+  // A std::map keeps the groups at stable addresses.
+  std::map<const clang::Decl*, VTableGroup> VTableGroups;
+  // GetDispatchThunk instantiations JIT-compiled in this interpreter, keyed
+  // on traits, slot and signature shape.
+  llvm::StringMap<void*> DispatchThunks;
+  // MakeClosure trampolines, JIT-compiled in pools per signature shape.
+  // Trampoline I of a pool reads its handler and user data from Slots[2 * I]
+  // and Slots[2 * I + 1]. A deque keeps the pools at stable addresses.
+  struct ClosurePool {
+    std::string Shape;
+    std::unique_ptr<void*[]> Slots;
+    std::vector<void*> Trampolines;
+    // Set by Undo and UnloadLibrary: live trampolines of the pool keep
+    // their slots, but are not handed out again once freed.
+    bool Retired = false;
+  };
+  std::deque<ClosurePool> ClosurePools;
+  // Unused trampolines of each shape, and the (pool, index) of each one
+  // handed out by MakeClosure.
+  llvm::StringMap<std::vector<std::pair<ClosurePool*, unsigned>>> FreeClosures;
+  llvm::DenseMap<void*, std::pair<ClosurePool*, unsigned>> LiveClosures;
+  // Box ObjectOps of the objects EvaluateInto heap-allocates, keyed on the
+  // canonical type. The ops live in EvalObjectOpsStorage, which is never
+  // cleared, so that Boxes made before an Undo keep theirs.
+  llvm::DenseMap<const void*, Box::ObjectOps*> EvalObjectOps;
+  std::deque<Box::ObjectOps> EvalObjectOpsStorage;
+  // ObjToString printers void(const void*, std::string&), compiled once per
+  // canonical type and also indexed by the type spellings asked for. Size
+  // is the sizeof of the type. A null Fn records a failed lookup or compile.
+  struct ObjPrinter {
+    void* Fn = nullptr;
+    size_t Size = 0;
+  };
+  llvm::DenseMap<const void*, ObjPrinter> ObjPrinters;
+  llvm::StringMap<ObjPrinter> ObjPrintersByName;
+  // GetContiguousView extractors void(void* obj, void** data, size_t* size)
+  // JIT-compiled per canonical container type, and the hooks registered
+  // with RegisterContiguousView keyed on the canonical class or class
+  // template.
+  llvm::DenseMap<const void*, void*> ContiguousViewExtractors;
+  llvm::DenseMap<const clang::Decl*, ContiguousViewHook> ContiguousViewHooks;
   // A deque keeps element addresses stable so DiagnosticRef::data
   // survives push_back.
   std::deque<StoredDiagView> StoredDiags;
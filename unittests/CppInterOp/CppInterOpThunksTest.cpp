@@ -1,8 +1,12 @@
 #include "CppInterOp/CppInterOpThunks.h"
 
+#include "CppInterOp/CppInterOp.h"
+
 #include "gtest/gtest.h"
 
 #include <cstddef>
+#include <string>
+#include <vector>
 
 // Cpp::Thunks::dispatch<Traits, Slot, R, Args...> turns a per-call
 // virtual dispatch into the binding's Traits::Call. It is consumed in
@@ -49,6 +53,49 @@ struct VoidTraits {
   }
 };
 
+// Interpreter-side traits with AccumTraits' behavior, and a class whose
+// virtuals provide the signature shapes. The first user virtual sits after
+// the Itanium D1/D0 pair or the single MSVC deleting dtor.
+void DeclareJitTraits() {
+  Cpp::CreateInterpreter({"-include", "new"});
+  Cpp::Declare("#include <cstddef>\n"
+               "struct JitHandler { int Value; };"
+               "struct JitTraits {"
+               "  static JitHandler& From(void* self) {"
+               "    return *static_cast<JitHandler*>(self);"
+               "  }"
+               "  template <class R, class... Args>"
+               "  static R Call(JitHandler& H, std::size_t Slot, Args... args) {"
+               "    R acc = static_cast<R>(H.Value) + static_cast<R>(Slot);"
+               "    ((acc += static_cast<R>(args)), ...);"
+               "    return acc;"
+               "  }"
+               "};"
+               "struct ThunkShapes {"
+               "  virtual ~ThunkShapes() {}"
+               "  virtual int f(int x) { return x; }"
+               "  virtual double g(double x, int) { return x; }"
+               "  virtual int h(int x) { return x; }"
+               "};");
+}
+
+Cpp::FuncRef ShapeMethod(const char* name) {
+  std::vector<Cpp::FuncRef> methods;
+  Cpp::GetClassMethods(Cpp::GetNamed("ThunkShapes"), methods);
+  for (auto m : methods)
+    if (Cpp::GetName(Cpp::DeclRef{m.data}) == name)
+      return m;
+  return nullptr;
+}
+
+#ifdef _WIN32
+constexpr std::size_t kFirstSlot = 1;
+#else
+constexpr std::size_t kFirstSlot = 2;
+#endif
+
+int HostThunk(void*, int x) { return -x; }
+
 } // namespace
 
 // dispatch is a function template. Each (Traits, Slot, R, Args...) tuple
@@ -92,3 +139,71 @@ TEST(CppInterOpThunks, DispatchWithNoArgsAndVoidReturn) {
   Fn(&H);
   EXPECT_EQ(H, 6); // 0 + 5 + 1
 }
+
+// The catalog source lists one entry per (shape, slot); f and h share a
+// shape but not a slot, and the destructor is skipped.
+TEST(CppInterOpThunks, EmitThunkCatalog) {
+  DeclareJitTraits();
+  std::string src = Cpp::EmitThunkCatalog({Cpp::GetNamed("ThunkShapes")},
+                                          "JitTraits", "shapes_catalog");
+  EXPECT_NE(src.find("extern const Cpp::ThunkCatalogEntry shapes_catalog[]"),
+            std::string::npos);
+  EXPECT_NE(src.find("shapes_catalog_size = 3;"), std::string::npos);
+  EXPECT_NE(src.find("{\"int(int)\", " + std::to_string(kFirstSlot)),
+            std::string::npos);
+  EXPECT_NE(src.find("Cpp::Thunks::dispatch<JitTraits, " +
+                     std::to_string(kFirstSlot + 1) + ", double, double, int>"),
+            std::string::npos);
+  EXPECT_TRUE(Cpp::EmitThunkCatalog({}, nullptr, "x").empty());
+}
+
+// Only the primary vtable of a class with several vptrs is listed: r is
+// reached through the secondary vtable, whose `this` is the ThunkR subobject.
+TEST(CppInterOpThunks, EmitThunkCatalogPrimaryVTableOnly) {
+  DeclareJitTraits();
+  Cpp::Declare("struct ThunkL { virtual ~ThunkL() {} virtual int l(int); };"
+               "struct ThunkR { virtual ~ThunkR() {} virtual int r(char); };"
+               "struct ThunkLR : ThunkL, ThunkR {};");
+  std::string src = Cpp::EmitThunkCatalog({Cpp::GetNamed("ThunkLR")},
+                                          "JitTraits", "lr_catalog");
+#ifdef _WIN32
+  EXPECT_NE(src.find("lr_catalog_size = 0;"), std::string::npos);
+#else
+  EXPECT_NE(src.find("lr_catalog_size = 1;"), std::string::npos);
+  EXPECT_NE(src.find("{\"int(int)\", " + std::to_string(kFirstSlot)),
+            std::string::npos);
+  EXPECT_EQ(src.find("int(char)"), std::string::npos);
+#endif
+}
+
+// A shape missing from the catalog is JIT-compiled once and cached; the
+// result behaves like the AOT instantiation.
+TEST(CppInterOpThunks, GetDispatchThunkCompilesMissingShapes) {
+  DeclareJitTraits();
+  void* f = Cpp::GetDispatchThunk("JitTraits", ShapeMethod("f"), kFirstSlot);
+  ASSERT_NE(f, nullptr);
+  EXPECT_EQ(Cpp::GetDispatchThunk("JitTraits", ShapeMethod("f"), kFirstSlot),
+            f);
+  Handler H{100};
+  auto* Fn = reinterpret_cast<int (*)(void*, int)>(f);
+  EXPECT_EQ(Fn(&H, 7), static_cast<int>(107 + kFirstSlot));
+
+  void* g =
+      Cpp::GetDispatchThunk("JitTraits", ShapeMethod("g"), kFirstSlot + 1);
+  ASSERT_NE(g, nullptr);
+  auto* Gn = reinterpret_cast<double (*)(void*, double, int)>(g);
+  EXPECT_DOUBLE_EQ(Gn(&H, 0.5, 2), 102.5 + static_cast<double>(kFirstSlot + 1));
+
+  EXPECT_EQ(Cpp::GetDispatchThunk(nullptr, ShapeMethod("f"), 0), nullptr);
+  EXPECT_EQ(Cpp::GetDispatchThunk("JitTraits", nullptr, 0), nullptr);
+}
+
+// Registered catalog entries take precedence over JIT compilation.
+TEST(CppInterOpThunks, GetDispatchThunkUsesRegisteredCatalog) {
+  DeclareJitTraits();
+  static const Cpp::ThunkCatalogEntry catalog[] = {
+      {"int(int)", 7, reinterpret_cast<void*>(&HostThunk)}};
+  Cpp::RegisterThunkCatalog("JitTraits", catalog, 1);
+  EXPECT_EQ(Cpp::GetDispatchThunk("JitTraits", ShapeMethod("h"), 7),
+            reinterpret_cast<void*>(&HostThunk));
+}
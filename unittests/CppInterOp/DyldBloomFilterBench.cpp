@@ -0,0 +1,249 @@
+// False-positive rate and probe throughput of the bloom filters with which
+// the library symbol search rules out libraries.
+//
+// The blocked filter (DyldBloomFilter.h) is compared against the filter it
+// replaced, kept below as LegacyBloomFilter: two bits anywhere in one word of
+// a table sized for p = 0.02. The symbols are synthetic mangled names, so the
+// numbers reflect the GNU hash on realistic inputs rather than ideal ones.
+
+#include "../../lib/CppInterOp/DyldBloomFilter.h"
+
+#include "PerfCompare.h"
+#include "gtest/gtest.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using CppInternal::BloomFilter;
+using CppInternal::BloomFilterSet;
+using CppInternal::GNUHash;
+
+namespace {
+
+constexpr uint32_t log2u(std::uint32_t n) {
+  return (n > 1) ? 1 + log2u(n >> 1) : 0;
+}
+
+// The filter of the symbol search before the blocked one.
+struct LegacyBloomFilter {
+  const int m_Bits = 8 * sizeof(uint64_t);
+  const float m_P = 0.02f;
+
+  uint32_t m_SymbolsCount = 0;
+  uint32_t m_BloomSize = 0;
+  uint32_t m_BloomShift = 0;
+  std::vector<uint64_t> m_BloomTable;
+
+  bool TestHash(uint32_t hash) const {
+    uint32_t hash2 = hash >> m_BloomShift;
+    uint32_t n = (hash >> log2u(m_Bits)) % m_BloomSize;
+    uint64_t mask = ((1ULL << (hash % m_Bits)) | (1ULL << (hash2 % m_Bits)));
+    return (mask & m_BloomTable[n]) == mask;
+  }
+
+  void AddHash(uint32_t hash) {
+    uint32_t hash2 = hash >> m_BloomShift;
+    uint32_t n = (hash >> log2u(m_Bits)) % m_BloomSize;
+    uint64_t mask = ((1ULL << (hash % m_Bits)) | (1ULL << (hash2 % m_Bits)));
+    m_BloomTable[n] |= mask;
+  }
+
+  void ResizeTable(uint32_t newSymbolsCount) {
+    m_SymbolsCount = newSymbolsCount;
+    m_BloomSize = ceil((-1.44f * m_SymbolsCount * log2f(m_P)) / m_Bits);
+    m_BloomShift = std::min(6u, log2u(m_SymbolsCount));
+    m_BloomTable.resize(m_BloomSize);
+  }
+};
+
+// Mangled-looking names of free functions and methods; Salt keeps the names
+// of different synthetic libraries (and of absent symbols) apart.
+std::vector<uint32_t> SymbolHashes(uint32_t Count, uint32_t Salt) {
+  std::vector<uint32_t> Hashes;
+  Hashes.reserve(Count);
+  for (uint32_t I = 0; I < Count; ++I) {
+    std::string Name = "_ZN" + std::to_string(Salt) + "ns" +
+                       std::to_string(I % 97) + "5Class" + std::to_string(I) +
+                       (I % 3 ? "E6methodEv" : "EC2ERKS_");
+    Hashes.push_back(GNUHash(Name));
+  }
+  return Hashes;
+}
+
+template <typename Filter> Filter MakeFilter(const std::vector<uint32_t>& H) {
+  Filter F;
+  F.ResizeTable(H.size());
+  for (uint32_t Hash : H)
+    F.AddHash(Hash);
+  return F;
+}
+
+BloomFilter MakeBlocked(const std::vector<uint32_t>& H) {
+  BloomFilter F;
+  F.m_IsInitialized = true;
+  F.ResizeTable(H.size());
+  for (uint32_t Hash : H)
+    F.AddHash(Hash);
+  return F;
+}
+
+template <typename Filter>
+double FalsePositiveRate(const Filter& F, const std::vector<uint32_t>& Absent) {
+  size_t Hits = 0;
+  for (uint32_t Hash : Absent)
+    Hits += F.TestHash(Hash);
+  return double(Hits) / Absent.size();
+}
+
+constexpr uint32_t kAbsentSalt = 0xABCDEF;
+
+} // namespace
+
+TEST(DyldBloomFilter, NoFalseNegatives) {
+  for (uint32_t Count : {1u, 7u, 1000u, 100000u}) {
+    std::vector<uint32_t> H = SymbolHashes(Count, 1);
+    BloomFilter F = MakeBlocked(H);
+    for (uint32_t Hash : H)
+      ASSERT_TRUE(F.TestHash(Hash)) << Count << " symbols";
+  }
+}
+
+TEST(DyldBloomFilter, FalsePositiveRate) {
+  const std::vector<uint32_t> Absent = SymbolHashes(200000, kAbsentSalt);
+  for (uint32_t Count : {1000u, 10000u, 100000u, 1000000u}) {
+    std::vector<uint32_t> H = SymbolHashes(Count, 1);
+    double Legacy =
+        FalsePositiveRate(MakeFilter<LegacyBloomFilter>(H), Absent);
+    double Blocked = FalsePositiveRate(MakeBlocked(H), Absent);
+    RecordProperty("legacy_fpr_" + std::to_string(Count),
+                   std::to_string(Legacy));
+    RecordProperty("blocked_fpr_" + std::to_string(Count),
+                   std::to_string(Blocked));
+    EXPECT_LT(Blocked, 0.03) << Count << " symbols";
+    EXPECT_LE(Blocked, Legacy) << Count << " symbols";
+  }
+}
+
+TEST(DyldBloomFilter, SetProbeMatchesFilters) {
+  std::vector<BloomFilter> Filters;
+  BloomFilterSet Set;
+  for (uint32_t Lib = 0; Lib < 64; ++Lib)
+    Filters.push_back(MakeBlocked(SymbolHashes(Lib * 37, Lib)));
+  for (uint32_t Lib = 0; Lib < 64; ++Lib)
+    // Every fourth library has no filter yet and must stay a candidate.
+    Set.Add(Lib % 4 == 3 ? nullptr : &Filters[Lib]);
+
+  std::vector<uint32_t> Candidates;
+  std::vector<uint32_t> Queries = SymbolHashes(1000, 5);
+  std::vector<uint32_t> Absent = SymbolHashes(1000, kAbsentSalt);
+  Queries.insert(Queries.end(), Absent.begin(), Absent.end());
+  for (uint32_t Hash : Queries) {
+    std::vector<uint32_t> Expected;
+    for (uint32_t Lib = 0; Lib < 64; ++Lib) {
+      const BloomFilter& F = Filters[Lib];
+      if (Lib % 4 == 3 || (F.m_SymbolsCount && F.TestHash(Hash)))
+        Expected.push_back(Lib);
+    }
+    Set.Probe(Hash, Candidates);
+    EXPECT_EQ(Expected, Candidates);
+  }
+}
+
+// Probe throughput of one filter; half of the probes are for present symbols.
+template <typename Filter>
+static void ProbeOne(benchmark::State& state, const Filter& F,
+                     const std::vector<uint32_t>& Present,
+                     const std::vector<uint32_t>& Absent) {
+  size_t I = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(F.TestHash(Present[I % Present.size()]));
+    benchmark::DoNotOptimize(F.TestHash(Absent[I % Absent.size()]));
+    ++I;
+  }
+  state.SetItemsProcessed(2 * state.iterations());
+  state.counters["fpr"] = FalsePositiveRate(F, Absent);
+}
+
+static void BM_DyldBloom_Legacy(benchmark::State& state) {
+  std::vector<uint32_t> Present = SymbolHashes(state.range(0), 1);
+  std::vector<uint32_t> Absent = SymbolHashes(100000, kAbsentSalt);
+  ProbeOne(state, MakeFilter<LegacyBloomFilter>(Present), Present, Absent);
+}
+BENCHMARK(BM_DyldBloom_Legacy)->RangeMultiplier(10)->Range(1000, 1000000);
+
+static void BM_DyldBloom_Blocked(benchmark::State& state) {
+  std::vector<uint32_t> Present = SymbolHashes(state.range(0), 1);
+  std::vector<uint32_t> Absent = SymbolHashes(100000, kAbsentSalt);
+  ProbeOne(state, MakeBlocked(Present), Present, Absent);
+}
+BENCHMARK(BM_DyldBloom_Blocked)->RangeMultiplier(10)->Range(1000, 1000000);
+
+// One absent symbol against the filters of many libraries: the search loop
+// before (a filter per library) and after (one pass over the set).
+namespace {
+constexpr uint32_t kLibraries = 2000;
+constexpr uint32_t kSymbolsPerLibrary = 1000;
+
+const std::vector<BloomFilter>& LibraryFilters() {
+  static std::vector<BloomFilter> Filters = [] {
+    std::vector<BloomFilter> Result;
+    for (uint32_t Lib = 0; Lib < kLibraries; ++Lib)
+      Result.push_back(MakeBlocked(SymbolHashes(kSymbolsPerLibrary, Lib)));
+    return Result;
+  }();
+  return Filters;
+}
+} // namespace
+
+static void BM_DyldBloom_PerLibrary(benchmark::State& state) {
+  const std::vector<BloomFilter>& Filters = LibraryFilters();
+  std::vector<const BloomFilter*> Libs;
+  for (const BloomFilter& F : Filters)
+    Libs.push_back(&F);
+  const std::vector<uint32_t> Absent = SymbolHashes(1024, kAbsentSalt);
+  size_t I = 0;
+  for (auto _ : state) {
+    const uint32_t Hash = Absent[I++ % Absent.size()];
+    unsigned Found = 0;
+    for (const BloomFilter* F : Libs)
+      Found += F->TestHash(Hash);
+    benchmark::DoNotOptimize(Found);
+  }
+  state.SetItemsProcessed(state.iterations() * kLibraries);
+}
+BENCHMARK(BM_DyldBloom_PerLibrary);
+
+static void BM_DyldBloom_FilterSet(benchmark::State& state) {
+  BloomFilterSet Set;
+  for (const BloomFilter& F : LibraryFilters())
+    Set.Add(&F);
+  const std::vector<uint32_t> Absent = SymbolHashes(1024, kAbsentSalt);
+  std::vector<uint32_t> Candidates;
+  size_t I = 0;
+  for (auto _ : state) {
+    Set.Probe(Absent[I++ % Absent.size()], Candidates);
+    benchmark::DoNotOptimize(Candidates.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kLibraries);
+}
+BENCHMARK(BM_DyldBloom_FilterSet);
+
+TEST(DyldBloomFilter, FilterSetNotSlowerThanPerLibrary) {
+#if !defined(NDEBUG) || defined(__SANITIZE_ADDRESS__)
+  GTEST_SKIP() << "Perf assertions need a Release, non-sanitizer build.";
+#endif
+  EXPECT_NOT_SLOWER_THAN(BM_DyldBloom_FilterSet, BM_DyldBloom_PerLibrary);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  benchmark::Initialize(&argc, argv);
+#if defined(NDEBUG) && !defined(__SANITIZE_ADDRESS__)
+  benchmark::RunSpecifiedBenchmarks();
+#endif
+  return RUN_ALL_TESTS();
+}
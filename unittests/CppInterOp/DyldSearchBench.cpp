@@ -0,0 +1,375 @@
+// Latency and memory footprint of the library symbol search
+// (Cpp::SearchLibrariesForSymbol) on generated library trees.
+//
+// A tree is a directory of NumLibs shared libraries defining NumSymbols
+// functions each, reached through chains of LinkDepth symlinks like
+// versioned sonames are. The libraries are minimal ELF images holding only
+// what the search reads, so that trees of thousands of them are cheap to
+// generate. Every benchmark reports the counters of Cpp::GetLibrarySearchStats
+// next to its time, e.g. the false-positive rate of the bloom filters.
+
+#include "CppInterOp/CppInterOp.h"
+
+#include "gtest/gtest.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/BinaryFormat/ELF.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+#if defined(__linux__) && defined(__x86_64__)
+constexpr uint16_t kMachine = llvm::ELF::EM_X86_64;
+#elif defined(__linux__) && defined(__aarch64__) &&                            \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+constexpr uint16_t kMachine = llvm::ELF::EM_AARCH64;
+#else
+constexpr uint16_t kMachine = llvm::ELF::EM_NONE;
+#endif
+
+// Writes a shared object defining Symbols as functions: an ELF header, the
+// .dynsym and .dynstr sections the search reads, and a .text section so that
+// the library is not taken for a debug-info-only file.
+bool WriteLibrary(llvm::StringRef Path,
+                  const std::vector<std::string>& Symbols) {
+  using namespace llvm::ELF;
+  // Section indices and their names' offsets in .shstrtab.
+  enum { kDynStr = 1, kDynSym, kText, kShStrTab, kNumSections };
+  static const char ShStrTab[] = "\0.dynstr\0.dynsym\0.text\0.shstrtab";
+  const uint32_t ShNames[kNumSections] = {0, 1, 9, 17, 23};
+
+  std::string DynStr(1, '\0');
+  std::vector<Elf64_Sym> Syms(1, Elf64_Sym{});
+  for (const std::string& Name : Symbols) {
+    Elf64_Sym Sym = {};
+    Sym.st_name = DynStr.size();
+    Sym.setBindingAndType(STB_GLOBAL, STT_FUNC);
+    Sym.st_shndx = kText;
+    Sym.st_size = 1;
+    Syms.push_back(Sym);
+    DynStr += Name;
+    DynStr += '\0';
+  }
+
+  const uint64_t DynStrOff = sizeof(Elf64_Ehdr);
+  const uint64_t DynSymOff = llvm::alignTo(DynStrOff + DynStr.size(), 8);
+  const uint64_t TextOff =
+      llvm::alignTo(DynSymOff + Syms.size() * sizeof(Elf64_Sym), 16);
+  const uint64_t TextSize = 16;
+  const uint64_t ShStrOff = TextOff + TextSize;
+  const uint64_t ShOff = llvm::alignTo(ShStrOff + sizeof(ShStrTab), 8);
+  const uint64_t End = ShOff + kNumSections * sizeof(Elf64_Shdr);
+  for (Elf64_Sym& Sym : Syms)
+    if (Sym.st_shndx == kText)
+      Sym.st_value = TextOff;
+
+  Elf64_Ehdr Ehdr = {};
+  std::memcpy(Ehdr.e_ident, ElfMagic, strlen(ElfMagic));
+  Ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+  Ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+  Ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+  Ehdr.e_type = ET_DYN;
+  Ehdr.e_machine = kMachine;
+  Ehdr.e_version = EV_CURRENT;
+  Ehdr.e_shoff = ShOff;
+  Ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+  Ehdr.e_phentsize = sizeof(Elf64_Phdr);
+  Ehdr.e_shentsize = sizeof(Elf64_Shdr);
+  Ehdr.e_shnum = kNumSections;
+  Ehdr.e_shstrndx = kShStrTab;
+
+  Elf64_Shdr Shdrs[kNumSections] = {};
+  auto SetSection = [&](unsigned I, uint32_t Type, uint64_t Flags,
+                        uint64_t Off, uint64_t Size, uint64_t Align) {
+    Elf64_Shdr& S = Shdrs[I];
+    S.sh_name = ShNames[I];
+    S.sh_type = Type;
+    S.sh_flags = Flags;
+    S.sh_addr = (Flags & SHF_ALLOC) ? Off : 0;
+    S.sh_offset = Off;
+    S.sh_size = Size;
+    S.sh_addralign = Align;
+  };
+  SetSection(kDynStr, SHT_STRTAB, SHF_ALLOC, DynStrOff, DynStr.size(), 1);
+  SetSection(kDynSym, SHT_DYNSYM, SHF_ALLOC, DynSymOff,
+             Syms.size() * sizeof(Elf64_Sym), 8);
+  Shdrs[kDynSym].sh_link = kDynStr;
+  Shdrs[kDynSym].sh_info = 1; // The first global symbol.
+  Shdrs[kDynSym].sh_entsize = sizeof(Elf64_Sym);
+  SetSection(kText, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, TextOff, TextSize,
+             16);
+  SetSection(kShStrTab, SHT_STRTAB, 0, ShStrOff, sizeof(ShStrTab), 1);
+
+  // isSharedLibrary reads the first kilobyte; keep the file at least a page.
+  std::string Image(std::max<uint64_t>(End, 4096), '\0');
+  auto Put = [&](uint64_t Off, const void* Data, size_t Size) {
+    std::memcpy(&Image[Off], Data, Size);
+  };
+  Put(0, &Ehdr, sizeof(Ehdr));
+  Put(DynStrOff, DynStr.data(), DynStr.size());
+  Put(DynSymOff, Syms.data(), Syms.size() * sizeof(Elf64_Sym));
+  std::memset(&Image[TextOff], 0xC3, TextSize); // ret
+  Put(ShStrOff, ShStrTab, sizeof(ShStrTab));
+  Put(ShOff, Shdrs, sizeof(Shdrs));
+
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC);
+  if (EC)
+    return false;
+  OS << Image;
+  return !OS.has_error();
+}
+
+std::string SymbolName(unsigned Lib, unsigned Sym) {
+  return "_ZN9dyldbench3lib" + std::to_string(Lib) + "2fn" +
+         std::to_string(Sym) + "Ev";
+}
+
+constexpr const char* kMissingSymbol = "_ZN9dyldbench7missingEv";
+
+// A generated tree; removed at exit.
+struct LibraryTree {
+  llvm::SmallString<128> Root;
+  std::string SearchDir;
+  // Defined by the last library only, the worst case of a search hit.
+  std::string LastSymbol;
+
+  ~LibraryTree() {
+    if (!Root.empty())
+      llvm::sys::fs::remove_directories(Root);
+  }
+};
+
+std::unique_ptr<LibraryTree> MakeTree(unsigned NumLibs, unsigned NumSymbols,
+                                      unsigned LinkDepth) {
+  auto Tree = std::make_unique<LibraryTree>();
+  llvm::SmallString<128> Prefix;
+  llvm::sys::path::system_temp_directory(/*ErasedOnReboot=*/true, Prefix);
+  llvm::sys::path::append(Prefix, "cppinterop-dyldbench");
+  if (llvm::sys::fs::createUniqueDirectory(Prefix, Tree->Root))
+    return nullptr;
+
+  llvm::SmallString<128> RealDir(Tree->Root), LibDir(Tree->Root);
+  llvm::sys::path::append(RealDir, "real");
+  llvm::sys::path::append(LibDir, "lib");
+  if (llvm::sys::fs::create_directory(RealDir) ||
+      llvm::sys::fs::create_directory(LibDir))
+    return nullptr;
+  Tree->SearchDir = LibDir.str().str();
+
+  std::vector<std::string> Symbols(NumSymbols);
+  for (unsigned L = 0; L < NumLibs; ++L) {
+    for (unsigned S = 0; S < NumSymbols; ++S)
+      Symbols[S] = SymbolName(L, S);
+    const std::string Name = "libdyldbench" + std::to_string(L) + ".so";
+    llvm::SmallString<256> Real(LinkDepth ? RealDir : LibDir);
+    llvm::sys::path::append(Real, Name);
+    if (!WriteLibrary(Real, Symbols))
+      return nullptr;
+    // libX.so -> libX.so.1 -> ... -> ../real/libX.so
+    for (unsigned D = 0; D < LinkDepth; ++D) {
+      llvm::SmallString<256> Link(LibDir);
+      llvm::sys::path::append(Link, D ? Name + "." + std::to_string(D) : Name);
+      std::string Target = D + 1 < LinkDepth
+                               ? Name + "." + std::to_string(D + 1)
+                               : "../real/" + Name;
+      if (llvm::sys::fs::create_link(Target, Link))
+        return nullptr;
+    }
+  }
+  if (NumLibs && NumSymbols)
+    Tree->LastSymbol = SymbolName(NumLibs - 1, NumSymbols - 1);
+  return Tree;
+}
+
+const LibraryTree* GetTree(unsigned NumLibs, unsigned NumSymbols,
+                           unsigned LinkDepth) {
+  static std::map<std::tuple<unsigned, unsigned, unsigned>,
+                  std::unique_ptr<LibraryTree>>
+      Trees;
+  auto& Tree = Trees[{NumLibs, NumSymbols, LinkDepth}];
+  if (!Tree)
+    Tree = MakeTree(NumLibs, NumSymbols, LinkDepth);
+  return Tree.get();
+}
+
+std::map<std::string, uint64_t> SearchStats() {
+  std::vector<std::string> Names;
+  std::vector<uint64_t> Values;
+  Cpp::GetLibrarySearchStats(Names, Values);
+  std::map<std::string, uint64_t> Stats;
+  for (size_t I = 0; I < Names.size(); ++I)
+    Stats[Names[I]] = Values[I];
+  return Stats;
+}
+
+long ResidentKb() {
+  std::ifstream Statm("/proc/self/statm");
+  long Size = 0, Resident = 0;
+  Statm >> Size >> Resident;
+  return Resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void ReportStats(benchmark::State& state, uint64_t Searches) {
+  std::map<std::string, uint64_t> Stats = SearchStats();
+  auto PerSearch = [&](const char* Name) {
+    return Searches ? double(Stats[Name]) / Searches : 0.0;
+  };
+  auto FalsePositiveRate = [&](const char* Probes, const char* Passed,
+                               const char* Hits) {
+    return Stats[Probes]
+               ? double(Stats[Passed] - Stats[Hits]) / Stats[Probes]
+               : 0.0;
+  };
+  state.counters["scanned_libs"] = Stats["scanned_libraries"];
+  state.counters["opens/search"] = PerSearch("object_opens");
+  state.counters["iterations/search"] = PerSearch("symbol_iterations");
+  state.counters["set_fpr"] = FalsePositiveRate(
+      "filter_set_probes", "filter_set_passed", "filter_set_hits");
+  state.counters["bloom_fpr"] =
+      FalsePositiveRate("bloom_probes", "bloom_passed", "bloom_hits");
+}
+
+bool CanGenerateLibraries() { return kMachine != llvm::ELF::EM_NONE; }
+
+} // namespace
+
+// {NumLibs, NumSymbols, LinkDepth}
+static void TreeShapes(benchmark::internal::Benchmark* B) {
+  B->Args({100, 100, 0});
+  B->Args({1000, 100, 0});
+  B->Args({100, 10000, 0});
+  B->Args({1000, 100, 3});
+}
+
+// The first search of a fresh interpreter: the scan of the tree, and the
+// filters of every library built to rule it out. rss_kb is what the search
+// left resident.
+static void BM_DyldSearch_FirstMiss(benchmark::State& state) {
+  const LibraryTree* Tree =
+      GetTree(state.range(0), state.range(1), state.range(2));
+  if (!CanGenerateLibraries() || !Tree) {
+    state.SkipWithError("Cannot generate the library tree");
+    return;
+  }
+  long RssKb = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    Cpp::CreateInterpreter({});
+    Cpp::AddSearchPath(Tree->SearchDir.c_str());
+    const long Before = ResidentKb();
+    state.ResumeTiming();
+
+    std::string Found =
+        Cpp::SearchLibrariesForSymbol(kMissingSymbol, /*search_system=*/false);
+    benchmark::DoNotOptimize(Found);
+
+    state.PauseTiming();
+    RssKb = ResidentKb() - Before;
+    ReportStats(state, /*Searches=*/1);
+    Cpp::DeleteInterpreter();
+    state.ResumeTiming();
+  }
+  state.counters["rss_kb"] = RssKb;
+}
+BENCHMARK(BM_DyldSearch_FirstMiss)
+    ->Apply(TreeShapes)
+    ->Iterations(3)
+    ->Unit(benchmark::kMillisecond);
+
+// Searches once everything is scanned and the filters are built, for the
+// symbol of the last library.
+static void BM_DyldSearch_WarmHit(benchmark::State& state) {
+  const LibraryTree* Tree =
+      GetTree(state.range(0), state.range(1), state.range(2));
+  if (!CanGenerateLibraries() || !Tree) {
+    state.SkipWithError("Cannot generate the library tree");
+    return;
+  }
+  Cpp::CreateInterpreter({});
+  Cpp::AddSearchPath(Tree->SearchDir.c_str());
+  const long Before = ResidentKb();
+  Cpp::SearchLibrariesForSymbol(kMissingSymbol, /*search_system=*/false);
+  const long RssKb = ResidentKb() - Before;
+  Cpp::ResetLibrarySearchStats();
+
+  for (auto _ : state) {
+    std::string Found = Cpp::SearchLibrariesForSymbol(
+        Tree->LastSymbol.c_str(), /*search_system=*/false);
+    benchmark::DoNotOptimize(Found);
+  }
+
+  ReportStats(state, state.iterations());
+  state.counters["rss_kb"] = RssKb;
+  Cpp::DeleteInterpreter();
+}
+BENCHMARK(BM_DyldSearch_WarmHit)
+    ->Apply(TreeShapes)
+    ->Unit(benchmark::kMicrosecond);
+
+TEST(DyldSearchBench, StatsCountEachLayer) {
+#ifdef CPPINTEROP_USE_CLING
+  GTEST_SKIP() << "Cling uses its own library manager";
+#endif
+  if (!CanGenerateLibraries())
+    GTEST_SKIP() << "Generating libraries needs ELF on x86-64 or AArch64";
+
+  const LibraryTree* Tree = GetTree(8, 50, /*LinkDepth=*/2);
+  ASSERT_TRUE(Tree);
+  Cpp::CreateInterpreter({});
+  Cpp::AddSearchPath(Tree->SearchDir.c_str());
+
+  EXPECT_EQ("", Cpp::SearchLibrariesForSymbol(kMissingSymbol, false));
+  std::map<std::string, uint64_t> Stats = SearchStats();
+  EXPECT_EQ(1U, Stats["searches"]);
+  EXPECT_EQ(1U, Stats["scans"]);
+  // Other user search paths, e.g. $CWD, may hold more libraries.
+  EXPECT_LE(8U, Stats["scanned_libraries"]);
+  EXPECT_LE(8U, Stats["object_opens"]);
+  EXPECT_LE(8U, Stats["filter_set_probes"]);
+  EXPECT_EQ(0U, Stats["filter_set_hits"]);
+  EXPECT_LE(Stats["bloom_passed"], Stats["bloom_probes"]);
+
+  std::string Found =
+      Cpp::SearchLibrariesForSymbol(Tree->LastSymbol.c_str(), false);
+  EXPECT_NE(std::string::npos, Found.find("libdyldbench7.so")) << Found;
+  Stats = SearchStats();
+  EXPECT_EQ(2U, Stats["searches"]);
+  EXPECT_EQ(1U, Stats["scans"]);
+  EXPECT_EQ(1U, Stats["filter_set_hits"]);
+  EXPECT_EQ(1U, Stats["bloom_hits"]);
+  EXPECT_EQ(1U, Stats["hash_table_hits"]);
+  EXPECT_LT(0U, Stats["hash_table_bytes_built"]);
+
+  Cpp::ResetLibrarySearchStats();
+  for (const auto& Stat : SearchStats())
+    EXPECT_EQ(0U, Stat.second) << Stat.first;
+  Cpp::DeleteInterpreter();
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  benchmark::Initialize(&argc, argv);
+  // The benchmarks create an interpreter per first search; only run them
+  // when their numbers mean something.
+#if defined(NDEBUG) && !defined(__SANITIZE_ADDRESS__)
+  benchmark::RunSpecifiedBenchmarks();
+#endif
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,179 @@
+// Memory and lookup throughput of the exact per-library symbol tables of the
+// library symbol search.
+//
+// The compact table (DyldSymbolTable.h) is compared against the string set it
+// replaced. The "image" is a string table of synthetic mangled names, laid
+// out NUL-separated like .dynstr, which both tables are built from.
+
+#include "../../lib/CppInterOp/DyldBloomFilter.h"
+#include "../../lib/CppInterOp/DyldSymbolTable.h"
+
+#include "llvm/ADT/StringSet.h"
+
+#include "gtest/gtest.h"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+using CppInternal::CompactSymbolTable;
+using CppInternal::GNUHash;
+
+namespace {
+
+// Mangled-looking names; Salt keeps those of absent symbols apart.
+std::string SymbolName(uint32_t I, uint32_t Salt) {
+  return "_ZN" + std::to_string(Salt) + "ns" + std::to_string(I % 97) +
+         "5Class" + std::to_string(I) + (I % 3 ? "E6methodEv" : "EC2ERKS_");
+}
+
+struct StringTable {
+  std::string Image;
+  std::vector<llvm::StringRef> Names;
+  std::vector<uint32_t> Hashes;
+
+  explicit StringTable(uint32_t Count) {
+    // A leading NUL, like ELF string tables.
+    Image.push_back('\0');
+    std::vector<size_t> Offsets;
+    for (uint32_t I = 0; I < Count; ++I) {
+      Offsets.push_back(Image.size());
+      Image += SymbolName(I, 1);
+      Image.push_back('\0');
+    }
+    for (size_t Offset : Offsets) {
+      Names.emplace_back(Image.c_str() + Offset);
+      Hashes.push_back(GNUHash(Names.back()));
+    }
+  }
+};
+
+CompactSymbolTable MakeCompact(const StringTable& T) {
+  CompactSymbolTable Table;
+  Table.Build(T.Image, T.Names, T.Hashes);
+  return Table;
+}
+
+llvm::StringSet<> MakeStringSet(const StringTable& T) {
+  llvm::StringSet<> Set;
+  for (llvm::StringRef S : T.Names)
+    Set.insert(S);
+  return Set;
+}
+
+// What a string set takes: an entry holding the name per symbol, plus a
+// bucket with the full hash per slot. Allocator overhead is not counted.
+size_t StringSetSize(const llvm::StringSet<>& Set) {
+  size_t Size = Set.getNumBuckets() * (sizeof(void*) + sizeof(unsigned));
+  for (const auto& S : Set)
+    Size += sizeof(llvm::StringMapEntryBase) + S.getKey().size() + 1;
+  return Size;
+}
+
+std::vector<std::string> AbsentNames(uint32_t Count) {
+  std::vector<std::string> Names;
+  for (uint32_t I = 0; I < Count; ++I)
+    Names.push_back(SymbolName(I, 0xABCDEF));
+  return Names;
+}
+
+} // namespace
+
+TEST(DyldSymbolTable, ContainsExactlyTheSymbols) {
+  for (uint32_t Count : {0u, 1u, 7u, 10000u}) {
+    StringTable T(Count);
+    CompactSymbolTable Table = MakeCompact(T);
+    EXPECT_EQ(Count, Table.size());
+    for (uint32_t I = 0; I < Count; ++I)
+      ASSERT_TRUE(Table.Contains(T.Names[I], T.Hashes[I], T.Image))
+          << T.Names[I].str();
+    for (const std::string& Name : AbsentNames(1000))
+      ASSERT_FALSE(Table.Contains(Name, GNUHash(Name), T.Image)) << Name;
+  }
+}
+
+TEST(DyldSymbolTable, ConfirmsByName) {
+  StringTable T(100);
+  CompactSymbolTable Table = MakeCompact(T);
+  // A prefix of a symbol, and a symbol claimed to have another's hash.
+  llvm::StringRef Prefix = T.Names[5].drop_back();
+  EXPECT_FALSE(Table.Contains(Prefix, GNUHash(Prefix), T.Image));
+  EXPECT_FALSE(Table.Contains(T.Names[5], T.Hashes[6], T.Image));
+  // The image was truncated since the table was built.
+  EXPECT_FALSE(Table.Contains(T.Names[99], T.Hashes[99],
+                              llvm::StringRef(T.Image).take_front(10)));
+}
+
+TEST(DyldSymbolTable, RejectsNamesOutsideTheImage) {
+  StringTable T(10);
+  std::vector<llvm::StringRef> Names = T.Names;
+  std::string Elsewhere = "_Z3foov";
+  Names[3] = Elsewhere;
+  CompactSymbolTable Table;
+  EXPECT_FALSE(Table.Build(T.Image, Names, T.Hashes));
+  EXPECT_TRUE(Table.empty());
+  // A name which is not NUL-terminated in the image.
+  Names = T.Names;
+  Names[3] = Names[3].drop_back();
+  EXPECT_FALSE(Table.Build(T.Image, Names, T.Hashes));
+}
+
+TEST(DyldSymbolTable, SmallerThanStringSet) {
+  for (uint32_t Count : {1000u, 100000u}) {
+    StringTable T(Count);
+    const size_t Compact = MakeCompact(T).getMemorySize();
+    const size_t Set = StringSetSize(MakeStringSet(T));
+    RecordProperty("compact_bytes_" + std::to_string(Count),
+                   std::to_string(Compact));
+    RecordProperty("string_set_bytes_" + std::to_string(Count),
+                   std::to_string(Set));
+    EXPECT_EQ(8 * Count, Compact);
+    EXPECT_LT(3 * Compact, Set) << Count << " symbols";
+  }
+}
+
+// Lookups of present and absent symbols, half each, as the search does them
+// after a bloom filter let the library through.
+static void BM_DyldSymbols_StringSet(benchmark::State& state) {
+  StringTable T(state.range(0));
+  llvm::StringSet<> Set = MakeStringSet(T);
+  const std::vector<std::string> Absent = AbsentNames(1024);
+  size_t I = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Set.count(T.Names[I % T.Names.size()]));
+    benchmark::DoNotOptimize(Set.count(Absent[I % Absent.size()]));
+    ++I;
+  }
+  state.SetItemsProcessed(2 * state.iterations());
+  state.counters["bytes"] = StringSetSize(Set);
+}
+BENCHMARK(BM_DyldSymbols_StringSet)->RangeMultiplier(10)->Range(1000, 100000);
+
+static void BM_DyldSymbols_Compact(benchmark::State& state) {
+  StringTable T(state.range(0));
+  CompactSymbolTable Table = MakeCompact(T);
+  const std::vector<std::string> Absent = AbsentNames(1024);
+  size_t I = 0;
+  for (auto _ : state) {
+    const size_t P = I % T.Names.size();
+    const std::string& A = Absent[I % Absent.size()];
+    // The search hashes the name once for all of its filters.
+    benchmark::DoNotOptimize(
+        Table.Contains(T.Names[P], T.Hashes[P], T.Image));
+    benchmark::DoNotOptimize(Table.Contains(A, GNUHash(A), T.Image));
+    ++I;
+  }
+  state.SetItemsProcessed(2 * state.iterations());
+  state.counters["bytes"] = Table.getMemorySize();
+}
+BENCHMARK(BM_DyldSymbols_Compact)->RangeMultiplier(10)->Range(1000, 100000);
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  benchmark::Initialize(&argc, argv);
+#if defined(NDEBUG) && !defined(__SANITIZE_ADDRESS__)
+  benchmark::RunSpecifiedBenchmarks();
+#endif
+  return RUN_ALL_TESTS();
+}
@@ -3,11 +3,16 @@
 
 #include "clang/Basic/Version.h"
 
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
 
 #include "gtest/gtest.h"
 
+#include <memory>
+#include <string>
+#include <vector>
+
 // This function isn't referenced outside its translation unit, but it
 // can't use the "static" keyword because its address is used for
 // GetMainExecutable (since some platforms don't support taking the
@@ -20,6 +25,352 @@ std::string GetExecutablePath(const char* Argv0) {
   return llvm::sys::fs::getMainExecutable(Argv0, MainAddr);
 }
 
+namespace {
+#ifdef __APPLE__
+const char* const kRetZero = "_ret_zero";
+const char* const kSharedLibExt = ".dylib";
+#else
+const char* const kRetZero = "ret_zero";
+const char* const kSharedLibExt = ".so";
+#endif // __APPLE__
+
+// A temporary directory of a test, removed with its contents. Tests which
+// search for or load libraries use copies of TestSharedLib in one, so that
+// none of them depends on what another left loaded or cached.
+class TempLibDir {
+  llvm::SmallString<128> m_Path;
+
+public:
+  explicit TempLibDir(llvm::StringRef Prefix) {
+    llvm::SmallString<128> Model;
+    llvm::sys::path::system_temp_directory(/*ErasedOnReboot=*/true, Model);
+    llvm::sys::path::append(Model, Prefix);
+    EXPECT_FALSE(llvm::sys::fs::createUniqueDirectory(Model, m_Path));
+  }
+  ~TempLibDir() { llvm::sys::fs::remove_directories(m_Path); }
+
+  const char* c_str() const { return m_Path.c_str(); }
+  std::string File(llvm::StringRef Name) const {
+    llvm::SmallString<256> Path(m_Path);
+    llvm::sys::path::append(Path, Name);
+    return Path.str().str();
+  }
+
+  /// Copies lib<Original>, built next to the test executable, into the
+  /// directory as lib<Name>.
+  ///\returns the real path of the copy.
+  std::string AddLibrary(llvm::StringRef Name,
+                         llvm::StringRef Original = "TestSharedLib") const {
+    llvm::SmallString<256> Lib(
+        llvm::sys::path::parent_path(GetExecutablePath(/*Argv0=*/nullptr)));
+    llvm::sys::path::append(Lib, "lib" + Original + kSharedLibExt);
+    std::string Copy = File(("lib" + Name + kSharedLibExt).str());
+    EXPECT_FALSE(llvm::sys::fs::copy_file(Lib, Copy)) << Copy;
+    llvm::SmallString<256> RealPath;
+    EXPECT_FALSE(llvm::sys::fs::real_path(Copy, RealPath)) << Copy;
+    return RealPath.str().str();
+  }
+};
+
+uint64_t SearchStat(llvm::StringRef Name) {
+  std::vector<std::string> Names;
+  std::vector<uint64_t> Values;
+  Cpp::GetLibrarySearchStats(Names, Values);
+  for (size_t I = 0; I < Names.size(); ++I)
+    if (Names[I] == Name)
+      return Values[I];
+  ADD_FAILURE() << "No search stat " << Name.str();
+  return 0;
+}
+} // namespace
+
+TYPED_TEST(CPPINTEROP_TEST_MODE, DynamicLibraryManager_PersistentIndex) {
+#ifdef EMSCRIPTEN
+  GTEST_SKIP() << "Test fails for Emscipten builds";
+#endif
+#ifdef _WIN32
+  GTEST_SKIP() << "Disabled on Windows. Needs fixing.";
+#endif
+#ifdef CPPINTEROP_USE_CLING
+  GTEST_SKIP() << "Cling uses its own library manager";
+#endif
+  if (TypeParam::isOutOfProcess)
+    GTEST_SKIP() << "Test fails for OOP JIT builds";
+
+  TempLibDir IndexDir("cppinterop-dyld-index");
+  TempLibDir Libs("cppinterop-dyld-libs");
+  Libs.AddLibrary("Indexed");
+  // A search path which does not exist yet, ahead of the other one.
+  TempLibDir LaterParent("cppinterop-dyld-later");
+  std::string Later = LaterParent.File("libs");
+
+  // Each interpreter has its own library manager, which restores the index
+  // or scans on its first search, like a new process would.
+  auto FreshSearch = [&]() {
+    EXPECT_TRUE(TestFixture::CreateInterpreter());
+    Cpp::SetLibraryIndexDirectory(IndexDir.c_str(), /*symbol_hashes=*/true);
+    Cpp::AddSearchPath(Later.c_str());
+    Cpp::AddSearchPath(Libs.c_str());
+    return Cpp::SearchLibrariesForSymbol(kRetZero, false);
+  };
+
+  // The first scan builds the filters and writes the index.
+  std::string Found = FreshSearch();
+  EXPECT_NE(std::string::npos, Found.find("libIndexed")) << Found;
+  EXPECT_LT(0U, SearchStat("bloom_builds"));
+  EXPECT_EQ("", Cpp::SearchLibrariesForSymbol("__no_such_symbol_idx", false));
+  std::error_code EC;
+  bool HasIndex = false;
+  for (llvm::sys::fs::directory_iterator It(IndexDir.c_str(), EC), End;
+       It != End && !EC; It.increment(EC))
+    HasIndex |= llvm::sys::path::extension(It->path()) == ".dyldidx";
+  EXPECT_TRUE(HasIndex);
+
+  // The next one restores them from the index.
+  EXPECT_EQ(Found, FreshSearch());
+  EXPECT_EQ(0U, SearchStat("bloom_builds"));
+  EXPECT_EQ("", Cpp::SearchLibrariesForSymbol("__no_such_symbol_idx", false));
+
+  // The absent search path appearing makes the index stale: its library,
+  // searched first, is found.
+  ASSERT_FALSE(llvm::sys::fs::create_directory(Later));
+  llvm::SmallString<256> LaterLib(Later);
+  llvm::sys::path::append(LaterLib, std::string("libLater") + kSharedLibExt);
+  ASSERT_FALSE(llvm::sys::fs::copy_file(Found, LaterLib));
+  Found = FreshSearch();
+  EXPECT_NE(std::string::npos, Found.find("libLater")) << Found;
+}
+
+TYPED_TEST(CPPINTEROP_TEST_MODE, DynamicLibraryManager_ScanOrder) {
+#ifdef EMSCRIPTEN
+  GTEST_SKIP() << "Test fails for Emscipten builds";
+#endif
+#ifdef _WIN32
+  GTEST_SKIP() << "Disabled on Windows. Needs fixing.";
+#endif
+#ifdef CPPINTEROP_USE_CLING
+  GTEST_SKIP() << "Cling uses its own library manager";
+#endif
+  if (TypeParam::isOutOfProcess)
+    GTEST_SKIP() << "Test fails for OOP JIT builds";
+
+  // The same symbol in a library of each directory. The directories are
+  // listed and read concurrently, yet the libraries must be searched in the
+  // order of the search paths, whichever way they are listed.
+  const char* Names[] = {"First", "Second", "Third"};
+  std::vector<std::unique_ptr<TempLibDir>> Dirs;
+  for (const char* Name : Names) {
+    Dirs.push_back(std::make_unique<TempLibDir>("cppinterop-dyld-order"));
+    Dirs.back()->AddLibrary(Name);
+  }
+  for (size_t Rotation = 0; Rotation < 3; ++Rotation)
+    for (int Repeat = 0; Repeat < 2; ++Repeat) {
+      EXPECT_TRUE(TestFixture::CreateInterpreter());
+      for (size_t I = 0; I < 3; ++I)
+        Cpp::AddSearchPath(Dirs[(Rotation + I) % 3]->c_str());
+      std::string Found = Cpp::SearchLibrariesForSymbol(kRetZero, false);
+      EXPECT_NE(std::string::npos,
+                Found.find(std::string("lib") + Names[Rotation]))
+          << Found;
+    }
+}
+
+TYPED_TEST(CPPINTEROP_TEST_MODE, DynamicLibraryManager_MappingBudget) {
+#ifdef EMSCRIPTEN
+  GTEST_SKIP() << "Test fails for Emscipten builds";
+#endif
+#ifdef _WIN32
+  GTEST_SKIP() << "Disabled on Windows. Needs fixing.";
+#endif
+  if (TypeParam::isOutOfProcess)
+    GTEST_SKIP() << "Test fails for OOP JIT builds";
+
+  EXPECT_TRUE(TestFixture::CreateInterpreter());
+
+  TempLibDir Dir("cppinterop-dyld-mapped");
+  Dir.AddLibrary("Mapped");
+  Cpp::AddSearchPath(Dir.c_str());
+  const char* Sym = kRetZero;
+
+  // With no budget every image is unmapped as soon as the next one is needed;
+  // the answers must not depend on what stayed mapped.
+  Cpp::SetLibraryMappingBudget(0);
+  std::string First = Cpp::SearchLibrariesForSymbol(Sym, false);
+  EXPECT_NE(std::string::npos, First.find("libMapped")) << First;
+  EXPECT_EQ("", Cpp::SearchLibrariesForSymbol("__no_such_symbol_0", false));
+  EXPECT_EQ(First, Cpp::SearchLibrariesForSymbol(Sym, false));
+
+  Cpp::SetLibraryMappingBudget(256 * 1024 * 1024);
+  EXPECT_EQ(First, Cpp::SearchLibrariesForSymbol(Sym, false));
+  EXPECT_EQ("", Cpp::SearchLibrariesForSymbol("__no_such_symbol_1", false));
+  EXPECT_EQ(First, Cpp::SearchLibrariesForSymbol(Sym, false));
+}
+
+TYPED_TEST(CPPINTEROP_TEST_MODE, DynamicLibraryManager_SymbolIndexBatch) {
+#ifdef EMSCRIPTEN
+  GTEST_SKIP() << "Test fails for Emscipten builds";
+#endif
+#ifdef _WIN32
+  GTEST_SKIP() << "Disabled on Windows. Needs fixing.";
+#endif
+  if (TypeParam::isOutOfProcess)
+    GTEST_SKIP() << "Test fails for OOP JIT builds";
+
+  EXPECT_TRUE(TestFixture::CreateInterpreter());
+
+  TempLibDir Dir("cppinterop-dyld-batch");
+  Dir.AddLibrary("Batch");
+  Cpp::AddSearchPath(Dir.c_str());
+  const char* Sym = kRetZero;
+
+  std::string Expected = Cpp::SearchLibrariesForSymbol(Sym, false);
+  EXPECT_NE(std::string::npos, Expected.find("libBatch")) << Expected;
+
+  Cpp::UseLibrarySymbolIndex(true);
+  std::vector<std::string> Found = Cpp::SearchLibrariesForSymbols(
+      {Sym, "__no_such_symbol_2", Sym}, /*search_system=*/false);
+  ASSERT_EQ(3U, Found.size());
+  EXPECT_EQ(Expected, Found[0]);
+  EXPECT_EQ("", Found[1]);
+  EXPECT_EQ(Expected, Found[2]);
+  EXPECT_EQ(Expected, Cpp::SearchLibrariesForSymbol(Sym, false));
+  Cpp::UseLibrarySymbolIndex(false);
+
+  EXPECT_TRUE(Cpp::SearchLibrariesForSymbols({}, false).empty());
+}
+
+TYPED_TEST(CPPINTEROP_TEST_MODE, DynamicLibraryManager_AutoLoading) {
+#ifdef EMSCRIPTEN
+  GTEST_SKIP() << "Test fails for Emscipten builds";
+#endif
+#ifdef _WIN32
+  GTEST_SKIP() << "Disabled on Windows. Needs fixing.";
+#endif
+#ifdef CPPINTEROP_USE_CLING
+  GTEST_SKIP() << "Cling loads libraries through its own callbacks";
+#endif
+  if (TypeParam::isOutOfProcess)
+    GTEST_SKIP() << "Test fails for OOP JIT builds";
+
+  EXPECT_TRUE(TestFixture::CreateInterpreter());
+
+  TempLibDir Dir("cppinterop-dyld-autoload");
+  std::string Lib = Dir.AddLibrary("AutoLoaded");
+  Cpp::AddSearchPath(Dir.c_str());
+
+  EXPECT_TRUE(Cpp::SetLibraryAutoLoading(true));
+  EXPECT_EQ(0, Cpp::Declare("extern \"C\" int ret_zero();"));
+  EXPECT_EQ(0, Cpp::Process("int autoloaded_ret_zero = ret_zero();"));
+
+  std::vector<std::string> Libraries, Symbols;
+  Cpp::GetAutoLoadedLibraries(Libraries, Symbols);
+  ASSERT_EQ(1U, Libraries.size());
+  ASSERT_EQ(1U, Symbols.size());
+  EXPECT_NE(std::string::npos, Libraries[0].find("libAutoLoaded"));
+  EXPECT_EQ(kRetZero, Symbols[0]);
+
+  // Unloading the library takes the symbols it resolved with it, so the
+  // next reference loads it again.
+  Cpp::UnloadLibrary(Lib.c_str());
+  Libraries.clear();
+  Symbols.clear();
+  Cpp::GetAutoLoadedLibraries(Libraries, Symbols);
+  EXPECT_TRUE(Libraries.empty());
+  EXPECT_EQ(0, Cpp::Process("int autoloaded_again = ret_zero();"));
+  Cpp::GetAutoLoadedLibraries(Libraries, Symbols);
+  ASSERT_EQ(1U, Libraries.size());
+  EXPECT_NE(std::string::npos, Libraries[0].find("libAutoLoaded"));
+
+  EXPECT_TRUE(Cpp::SetLibraryAutoLoading(false));
+  // Leave no definition of ret_zero behind in the process.
+  Cpp::UnloadLibrary(Lib.c_str());
+}
+
+TYPED_TEST(CPPINTEROP_TEST_MODE, DynamicLibraryManager_WatchSearchPaths) {
+#ifndef __linux__
+  GTEST_SKIP() << "Watching the search paths needs inotify";
+#endif
+#ifdef CPPINTEROP_USE_CLING
+  GTEST_SKIP() << "Cling uses its own library manager";
+#endif
+  if (TypeParam::isOutOfProcess)
+    GTEST_SKIP() << "Test fails for OOP JIT builds";
+
+  EXPECT_TRUE(TestFixture::CreateInterpreter());
+
+  TempLibDir WatchDir("cppinterop-watch");
+  Cpp::AddSearchPath(WatchDir.c_str());
+  ASSERT_TRUE(Cpp::SetLibrarySearchPathWatching(true));
+
+  // The first search scans the empty directory.
+  std::string Found = Cpp::SearchLibrariesForSymbol("ret_zero", false);
+  EXPECT_EQ(std::string::npos, Found.find("libWatched"));
+  EXPECT_EQ(0U, Cpp::GetLibraryRescansAvoided());
+
+  // A library appearing afterwards is found without a rescan.
+  std::string Copy = WatchDir.AddLibrary("Watched");
+  Found = Cpp::SearchLibrariesForSymbol("ret_zero", false);
+  EXPECT_NE(std::string::npos, Found.find("libWatched.so")) << Found;
+  EXPECT_LE(1U, Cpp::GetLibraryRescansAvoided());
+
+  // A rewritten library keeps its place ahead of one added after it.
+  std::string Second = WatchDir.AddLibrary("Watched2");
+  Found = Cpp::SearchLibrariesForSymbol("ret_zero", false);
+  EXPECT_NE(std::string::npos, Found.find("libWatched.so")) << Found;
+  WatchDir.AddLibrary("Watched");
+  Found = Cpp::SearchLibrariesForSymbol("ret_zero", false);
+  EXPECT_NE(std::string::npos, Found.find("libWatched.so")) << Found;
+
+  // And forgotten once removed.
+  ASSERT_FALSE(llvm::sys::fs::remove(Second));
+  ASSERT_FALSE(llvm::sys::fs::remove(Copy));
+  Found = Cpp::SearchLibrariesForSymbol("ret_zero", false);
+  EXPECT_EQ(std::string::npos, Found.find("libWatched")) << Found;
+
+  EXPECT_TRUE(Cpp::SetLibrarySearchPathWatching(false));
+}
+
+TYPED_TEST(CPPINTEROP_TEST_MODE, DynamicLibraryManager_LoadLibraries) {
+#ifdef EMSCRIPTEN
+  GTEST_SKIP() << "Test fails for Emscipten builds";
+#endif
+#ifdef _WIN32
+  GTEST_SKIP() << "Disabled on Windows. Needs fixing.";
+#endif
+  if (TypeParam::isOutOfProcess)
+    GTEST_SKIP() << "Test fails for OOP JIT builds";
+
+  EXPECT_TRUE(TestFixture::CreateInterpreter());
+
+  TempLibDir Dir("cppinterop-dyld-load");
+  std::string Base = Dir.AddLibrary("TestSharedLib");
+  Cpp::AddSearchPath(Dir.c_str());
+  // Force ExecutionEngine to be created.
+  Cpp::Process("");
+
+#if defined(__linux__) && !defined(CPPINTEROP_USE_CLING)
+  // TestSharedLibDep has no RPATH: it only loads once TestSharedLib has, as
+  // the loader then matches its DT_NEEDED entry with the loaded soname.
+  std::string Dependent =
+      Dir.AddLibrary("TestSharedLibDep", "TestSharedLibDep");
+  EXPECT_FALSE(Cpp::LoadLibraries({Dependent}, /*lookup=*/false));
+  // Listed first, it is loaded after the library it depends on.
+  EXPECT_TRUE(Cpp::LoadLibraries({Dependent, Base}, /*lookup=*/false));
+  EXPECT_TRUE(Cpp::GetFunctionAddress("ret_one"));
+  EXPECT_TRUE(Cpp::GetFunctionAddress("ret_zero"));
+  Cpp::UnloadLibrary(Dependent.c_str());
+#endif
+
+  // A library which cannot be found fails the call, not the others.
+  EXPECT_FALSE(Cpp::LoadLibraries({"TestSharedLib", "__no_such_library"}));
+#ifndef __APPLE__
+  EXPECT_TRUE(Cpp::GetFunctionAddress("ret_zero"));
+#endif //__APPLE__
+  EXPECT_TRUE(Cpp::LoadLibraries({"TestSharedLib"}));
+
+  Cpp::UnloadLibrary("TestSharedLib");
+}
+
 TYPED_TEST(CPPINTEROP_TEST_MODE, DynamicLibraryManager_Sanity) {
 #ifdef EMSCRIPTEN
   GTEST_SKIP() << "Test fails for Emscipten builds";
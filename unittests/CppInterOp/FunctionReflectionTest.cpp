@@ -1094,6 +1094,89 @@ TYPED_TEST(CPPINTEROP_TEST_MODE, FunctionReflection_FunctionTypes) {
   EXPECT_TRUE(Cpp::IsSameType(typ1, typ2));
 }
 
+TYPED_TEST(CPPINTEROP_TEST_MODE, FunctionReflection_MakeClosure) {
+  std::vector<Decl*> Decls;
+  std::string code = R"(
+      int (*f1)(int, double) = nullptr;
+      int& (*f2)(int&) = nullptr;
+      void (*f3)() = nullptr;
+      int apply(int (*f)(int, double), int a) { return f(a, 0.5); }
+    )";
+  GetAllTopLevelDecls(code, Decls);
+  ASSERT_EQ(Decls.size(), 4);
+  Cpp::TypeRef typ1 = Cpp::GetVariableType(Decls[0]);
+  Cpp::TypeRef typ2 = Cpp::GetPointeeType(Cpp::GetVariableType(Decls[1]));
+  Cpp::TypeRef typ3 = Cpp::GetVariableType(Decls[2]);
+
+  Cpp::ClosureHandler scale = [](void* data, size_t nargs, void** args,
+                                 void* ret) {
+    EXPECT_EQ(nargs, 2U);
+    int a = *static_cast<int*>(args[0]);
+    double b = *static_cast<double*>(args[1]);
+    *static_cast<int*>(ret) = a * *static_cast<int*>(data) + int(b * 2);
+  };
+  int by10 = 10;
+  int by100 = 100;
+  if (TypeParam::isOutOfProcess) {
+    // The executor could not reach the handler.
+    EXPECT_FALSE(Cpp::MakeClosure(typ1, scale, &by10));
+    return;
+  }
+  void* c1 = Cpp::MakeClosure(typ1, scale, &by10);
+  void* c2 = Cpp::MakeClosure(Cpp::GetPointeeType(typ1), scale, &by100);
+  ASSERT_TRUE(c1);
+  ASSERT_TRUE(c2);
+  EXPECT_NE(c1, c2);
+  using IntFn = int (*)(int, double);
+  EXPECT_EQ(TestUtils::BitCastFn<IntFn>(c1)(4, 1.0), 42);
+  EXPECT_EQ(TestUtils::BitCastFn<IntFn>(c2)(4, 1.0), 402);
+
+  // JIT-compiled code calls the closure like any other function pointer.
+  Cpp::JitCall JC = Cpp::MakeFunctionCallable(Decls[3]);
+  int a = 2;
+  void* args[] = {&c1, &a};
+  int result = 0;
+  JC.Invoke(&result, {args, 2});
+  EXPECT_EQ(result, 21);
+
+  // Reference results are returned through the referee's address.
+  Cpp::ClosureHandler identity = [](void*, size_t, void** args, void* ret) {
+    *static_cast<void**>(ret) = args[0];
+  };
+  void* c3 = Cpp::MakeClosure(typ2, identity, nullptr);
+  ASSERT_TRUE(c3);
+  int x = 5;
+  int& (*ref_fn)(int&) = TestUtils::BitCastFn<int& (*)(int&)>(c3);
+  EXPECT_EQ(&ref_fn(x), &x);
+
+  Cpp::ClosureHandler count = [](void* data, size_t nargs, void**,
+                                 void* ret) {
+    EXPECT_EQ(nargs, 0U);
+    EXPECT_EQ(ret, nullptr);
+    ++*static_cast<int*>(data);
+  };
+  int calls = 0;
+  void* c4 = Cpp::MakeClosure(typ3, count, &calls);
+  ASSERT_TRUE(c4);
+  TestUtils::BitCastFn<void (*)()>(c4)();
+  TestUtils::BitCastFn<void (*)()>(c4)();
+  EXPECT_EQ(calls, 2);
+
+  // Released trampolines are handed out again for the same shape.
+  Cpp::FreeClosure(c2);
+  void* c5 = Cpp::MakeClosure(typ1, scale, &by100);
+  EXPECT_EQ(c5, c2);
+  EXPECT_EQ(TestUtils::BitCastFn<IntFn>(c5)(1, 0.5), 101);
+  Cpp::FreeClosure(c1);
+  Cpp::FreeClosure(c3);
+  Cpp::FreeClosure(c4);
+  Cpp::FreeClosure(c5);
+  Cpp::FreeClosure(nullptr);
+
+  EXPECT_FALSE(Cpp::MakeClosure(typ1, nullptr, nullptr));
+  EXPECT_FALSE(Cpp::MakeClosure(Cpp::GetType("int"), scale, nullptr));
+}
+
 TYPED_TEST(CPPINTEROP_TEST_MODE, FunctionReflection_GetDeallocType) {
   std::string code = R"(
     #include <new>
@@ -101,15 +101,24 @@ TYPED_TEST(CPPINTEROP_TEST_MODE, Interpreter_Evaluate) {
       16ULL);
   // Object payload: K_PtrOrObj carries an owned pointer to the JIT-managed
   // instance; lifetime ends with the Value going out of scope.
-  Cpp::Box sV = Cpp::Evaluate("struct S{} s; s");
+  Cpp::Box sV = Cpp::Evaluate("struct S{ ~S() {} } s; s");
   EXPECT_EQ(sV.getKind(), Cpp::Box::K_PtrOrObj);
   EXPECT_NE(sV.getObjectPtr(), nullptr);
+  // Small trivially copyable objects are copied into the Box itself.
+  Cpp::Box pV = Cpp::Evaluate("struct P{ double x, y; } p{1.5, -2.}; p");
+  ASSERT_EQ(pV.getKind(), Cpp::Box::K_InlineObj);
+  const auto* xy = static_cast<const double*>(pV.getObjectPtr());
+  EXPECT_EQ(xy[0], 1.5);
+  EXPECT_EQ(xy[1], -2.);
+  // Too large for the inline buffer.
+  EXPECT_EQ(Cpp::Evaluate("struct L{ char c[64]; } l{}; l").getKind(),
+            Cpp::Box::K_PtrOrObj);
 }
 
-// Copy semantics mirror clang::Value: fundamentals POD-copy; K_PtrOrObj is
-// refcounted-shallow (retain bumps a ref, dtor releases). The test exercises
-// both: fundamentals copy independently, K_PtrOrObj copy shares the payload
-// pointer and survives the original going out of scope.
+// Copy semantics mirror clang::Value: fundamentals and K_InlineObj POD-copy;
+// K_PtrOrObj is refcounted-shallow (retain bumps a ref, dtor releases). The
+// test exercises both: fundamentals copy independently, K_PtrOrObj copy
+// shares the payload pointer and survives the original going out of scope.
 TYPED_TEST(CPPINTEROP_TEST_MODE, Interpreter_Evaluate_Copy) {
 #ifdef EMSCRIPTEN
   GTEST_SKIP() << "Test fails for Emscipten builds";
@@ -128,13 +137,21 @@ TYPED_TEST(CPPINTEROP_TEST_MODE, Interpreter_Evaluate_Copy) {
   EXPECT_EQ(ic.unbox<int>(), 42);
   EXPECT_EQ(i.unbox<int>(), 42); // original survives copy
 
+  // K_InlineObj: the copy holds its own bytes.
+  Cpp::Box p = Cpp::Evaluate("struct PodT { int a, b; }; PodT{3, 4}");
+  ASSERT_EQ(p.getKind(), Cpp::Box::K_InlineObj);
+  Cpp::Box pc = p;
+  EXPECT_NE(pc.getObjectPtr(), p.getObjectPtr());
+  EXPECT_EQ(static_cast<const int*>(pc.getObjectPtr())[1], 4);
+
   // K_PtrOrObj: shallow + refcounted. Copy shares the payload pointer; the
   // payload survives the original going out of scope. Refcount reaches 0
   // only when both Values destruct (no double-free, no use-after-free under
   // ASan).
   void* sharedPtr = nullptr;
   {
-    Cpp::Box sV = Cpp::Evaluate("struct CopyT { int v = 7; }; CopyT{}");
+    Cpp::Box sV = Cpp::Evaluate(
+        "struct CopyT { int v = 7; ~CopyT() {} }; CopyT{}");
     ASSERT_EQ(sV.getKind(), Cpp::Box::K_PtrOrObj);
     Cpp::Box sC = sV;
     EXPECT_EQ(sC.getKind(), Cpp::Box::K_PtrOrObj);
@@ -183,7 +200,7 @@ TYPED_TEST(CPPINTEROP_TEST_MODE, Interpreter_Evaluate_Copy) {
   // Move semantics: src is reset to K_Unspecified so its dtor does not
   // release the storage the destination now owns. A regression here
   // would double-release the K_PtrOrObj payload (ASan-detectable).
-  Cpp::Declare("struct MoveT { int v = 1; };");
+  Cpp::Declare("struct MoveT { int v = 1; ~MoveT() {} };");
   Cpp::Box src = Cpp::Evaluate("MoveT{}");
   ASSERT_EQ(src.getKind(), Cpp::Box::K_PtrOrObj);
   void* origPtr = src.getObjectPtr();
@@ -288,6 +305,197 @@ TYPED_TEST(CPPINTEROP_TEST_MODE, Interpreter_Evaluate_NonValueStatement) {
             Cpp::Box::K_Unspecified);
 }
 
+// EvaluateInto writes the result of a single expression straight into the
+// Box, into caller storage, or into one refcounted heap block.
+TYPED_TEST(CPPINTEROP_TEST_MODE, Interpreter_EvaluateInto) {
+#ifdef EMSCRIPTEN
+  GTEST_SKIP() << "Test fails for Emscipten builds";
+#endif
+#ifdef _WIN32
+  GTEST_SKIP() << "Disabled on Windows. Needs fixing.";
+#endif
+  if (TypeParam::isOutOfProcess)
+    GTEST_SKIP() << "Test fails for OOP JIT builds";
+  TestFixture::CreateInterpreter();
+
+  Cpp::Declare(R"(
+    int EvalInto_g = 40;
+    enum EvalInto_E : short { kA = 7 };
+    struct EvalInto_Pod { double x, y; };
+    int EvalInto_dtors = 0;
+    struct EvalInto_Obj {
+      int v[16];
+      EvalInto_Obj(int i) { v[0] = i; }
+      EvalInto_Obj(const EvalInto_Obj& o) { v[0] = o.v[0] + 100; }
+      ~EvalInto_Obj() { ++EvalInto_dtors; }
+    };
+  )");
+
+  EXPECT_EQ(Cpp::EvaluateInto("EvalInto_g + 2").unbox<int>(), 42);
+  Cpp::Box e = Cpp::EvaluateInto("kA");
+  ASSERT_EQ(e.getKind(), Cpp::Box::K_Short);
+  EXPECT_EQ(e.unbox<short>(), 7);
+  Cpp::Box p = Cpp::EvaluateInto("&EvalInto_g");
+  ASSERT_EQ(p.getKind(), Cpp::Box::K_PtrOrObj);
+  EXPECT_EQ(*static_cast<int*>(p.getObjectPtr()), 40);
+
+  Cpp::Box pod = Cpp::EvaluateInto("EvalInto_Pod{1.5, 2.5}");
+  ASSERT_EQ(pod.getKind(), Cpp::Box::K_InlineObj);
+  EXPECT_EQ(static_cast<const double*>(pod.getObjectPtr())[1], 2.5);
+
+  // A prvalue is constructed in place: the copy constructor never runs.
+  {
+    Cpp::Box obj = Cpp::EvaluateInto("EvalInto_Obj(5)");
+    ASSERT_EQ(obj.getKind(), Cpp::Box::K_PtrOrObj);
+    EXPECT_EQ(static_cast<const int*>(obj.getObjectPtr())[0], 5);
+    Cpp::Box copy = obj;
+    EXPECT_EQ(copy.getObjectPtr(), obj.getObjectPtr());
+  }
+  EXPECT_EQ(Cpp::Evaluate("EvalInto_dtors").unbox<int>(), 1);
+
+  // Caller storage: the Box does not own the object.
+  alignas(16) unsigned char buf[128];
+  {
+    Cpp::Box obj = Cpp::EvaluateInto("EvalInto_Obj(6)", buf, sizeof(buf));
+    EXPECT_EQ(obj.getObjectPtr(), buf);
+  }
+  EXPECT_EQ(reinterpret_cast<const int*>(buf)[0], 6);
+  EXPECT_EQ(Cpp::Evaluate("EvalInto_dtors").unbox<int>(), 1);
+  Cpp::Destruct(buf, Cpp::GetNamed("EvalInto_Obj"), /*withFree=*/false);
+  EXPECT_EQ(Cpp::Evaluate("EvalInto_dtors").unbox<int>(), 2);
+  // Too small: falls back to the heap block.
+  EXPECT_NE(Cpp::EvaluateInto("EvalInto_Obj(7)", buf, 8).getObjectPtr(),
+            buf);
+
+  EXPECT_EQ(Cpp::EvaluateInto("EvalInto_g = 1, void()").getKind(),
+            Cpp::Box::K_Unspecified);
+  EXPECT_EQ(Cpp::Evaluate("EvalInto_g").unbox<int>(), 1);
+  EXPECT_EQ(Cpp::EvaluateInto("EvalInto_undeclared").getKind(),
+            Cpp::Box::K_Unspecified);
+}
+
+TYPED_TEST(CPPINTEROP_TEST_MODE, Interpreter_EvaluateBatch) {
+#ifdef EMSCRIPTEN
+  GTEST_SKIP() << "Test fails for Emscipten builds";
+#endif
+#ifdef _WIN32
+  GTEST_SKIP() << "Disabled on Windows. Needs fixing.";
+#endif
+  if (TypeParam::isOutOfProcess)
+    GTEST_SKIP() << "Test fails for OOP JIT builds";
+  TestFixture::CreateInterpreter();
+
+  Cpp::Declare("double EvalBatch_scale = 2.0;");
+  Cpp::BoxColumn col =
+      Cpp::EvaluateBatch({"1.5", "EvalBatch_scale * 3", "7", "-0.25"});
+  ASSERT_EQ(col.m_Kind, Cpp::Box::K_Double);
+  EXPECT_EQ(Cpp::GetTypeAsString(col.m_Type), "double");
+  ASSERT_EQ(col.m_Size, 4U);
+  EXPECT_EQ(col.m_ElementSize, sizeof(double));
+  EXPECT_EQ(col.as<double>()[1], 6.0);
+  EXPECT_EQ(col.as<double>()[2], 7.0);
+  EXPECT_EQ(col.as<double>()[3], -0.25);
+
+  // Mixed types widen to their common type instead of to the first one.
+  Cpp::BoxColumn mixed = Cpp::EvaluateBatch({"1", "2.5"});
+  ASSERT_EQ(mixed.m_Kind, Cpp::Box::K_Double);
+  ASSERT_EQ(mixed.m_Size, 2U);
+  EXPECT_EQ(mixed.as<double>()[0], 1.0);
+  EXPECT_EQ(mixed.as<double>()[1], 2.5);
+
+  // One expression over an input column, in a single compiled loop.
+  Cpp::BoxColumn sq = Cpp::EvaluateBatch("int(x * x) + 1", "x", col);
+  ASSERT_EQ(sq.m_Kind, Cpp::Box::K_Int);
+  ASSERT_EQ(sq.m_Size, 4U);
+  EXPECT_EQ(sq.as<int>()[0], 3);
+  EXPECT_EQ(sq.as<int>()[1], 37);
+  EXPECT_EQ(sq.as<int>()[3], 1);
+
+  EXPECT_EQ(Cpp::EvaluateBatch({}).m_Kind, -1);
+  EXPECT_EQ(Cpp::EvaluateBatch({"EvalBatch_undeclared"}).m_Kind, -1);
+  EXPECT_EQ(Cpp::EvaluateBatch({"\"not a number\""}).m_Kind, -1);
+  EXPECT_EQ(Cpp::EvaluateBatch({"1", "nullptr"}).m_Kind, -1);
+  EXPECT_EQ(Cpp::EvaluateBatch("x", "x", Cpp::BoxColumn{}).m_Kind, -1);
+}
+
+TYPED_TEST(CPPINTEROP_TEST_MODE, Interpreter_ObjToString) {
+#ifdef CPPINTEROP_USE_CLING
+  GTEST_SKIP() << "Cling formats through its own printValue";
+#endif
+#ifdef EMSCRIPTEN
+  GTEST_SKIP() << "Test fails for Emscipten builds";
+#endif
+  if (TypeParam::isOutOfProcess)
+    GTEST_SKIP() << "Test fails for OOP JIT builds";
+  TestFixture::CreateInterpreter();
+
+  Cpp::Declare(R"(
+    #include <string>
+    #include <vector>
+    struct ObjStr_Opaque { int i; };
+  )");
+  int i = 42;
+  EXPECT_EQ(Cpp::ObjToString("int", &i), "42");
+  bool b = true;
+  EXPECT_EQ(Cpp::ObjToString("bool", &b), "true");
+  std::string s = "hi";
+  EXPECT_EQ(Cpp::ObjToString("std::string", &s), "\"hi\"");
+  std::vector<int> v = {1, 2, 3};
+  EXPECT_EQ(Cpp::ObjToString("std::vector<int>", &v), "{ 1, 2, 3 }");
+  std::vector<std::string> vs = {"a"};
+  EXPECT_EQ(Cpp::ObjToString("std::vector<std::string>", &vs), "{ \"a\" }");
+  EXPECT_EQ(Cpp::ObjToString("ObjStr_Opaque", &i)[0], '@');
+  EXPECT_EQ(Cpp::ObjToString("ObjStr_Undeclared", &i), "");
+  // The failed lookup is cached: nothing is parsed the second time.
+  EXPECT_EQ(Cpp::ObjToString("ObjStr_Undeclared", &i), "");
+
+  double d[] = {0.5, 1.5, 2.5};
+  EXPECT_EQ(Cpp::ObjToStringMany("double", d, 3), "0.5\n1.5\n2.5");
+  EXPECT_EQ(Cpp::ObjToStringMany("double", d, 2, 2 * sizeof(double)),
+            "0.5\n2.5");
+  EXPECT_EQ(Cpp::ObjToStringMany("ObjStr_Undeclared", d, 3), "");
+}
+
+// Undo may free the code of a cached printer and the types ids were handed
+// out for, so neither survives it.
+TYPED_TEST(CPPINTEROP_TEST_MODE, Interpreter_CachesAfterUndo) {
+#ifdef _WIN32
+  GTEST_SKIP() << "Disabled on Windows. Needs fixing.";
+#endif
+#if defined(CPPINTEROP_USE_CLING)
+  GTEST_SKIP() << "cling unload walks a module already freed by ORC "
+                  "clone-on-emit; skip until the cling-side fix lands.";
+#endif
+#ifdef EMSCRIPTEN
+  GTEST_SKIP() << "Test fails for Emscipten builds";
+#endif
+  if (TypeParam::isOutOfProcess)
+    GTEST_SKIP() << "Test fails for OOP JIT builds";
+  TestFixture::CreateInterpreter();
+
+  ASSERT_EQ(Cpp::Process("struct UndoCache_T { int v; };"), 0);
+  size_t id =
+      Cpp::GetTypeId(Cpp::GetTypeFromScope(Cpp::GetNamed("UndoCache_T")));
+  ASSERT_NE(id, 0U);
+  // The first printer also brings in the helpers every printer shares.
+  int i = 42;
+  EXPECT_EQ(Cpp::ObjToString("int", &i), "42");
+  double d = 0.5;
+  EXPECT_EQ(Cpp::ObjToString("double", &d), "0.5");
+
+  // Undoes the unit the printer of double was compiled in; the next call
+  // must compile a new one rather than run the freed code.
+  Cpp::Undo();
+  EXPECT_EQ(Cpp::ObjToString("double", &d), "0.5");
+  EXPECT_EQ(Cpp::ObjToString("int", &i), "42");
+  EXPECT_EQ(Cpp::GetTypeFromId(id), nullptr);
+  EXPECT_EQ(Cpp::GetTypeIdInfo(id).m_BuiltinKind, -1);
+  size_t fresh =
+      Cpp::GetTypeId(Cpp::GetTypeFromScope(Cpp::GetNamed("UndoCache_T")));
+  EXPECT_NE(fresh, 0U);
+  EXPECT_NE(fresh, id);
+}
+
 TYPED_TEST(CPPINTEROP_TEST_MODE, Interpreter_DeleteInterpreter) {
   if (TypeParam::isOutOfProcess)
     GTEST_SKIP() << "Test fails for OOP JIT builds";
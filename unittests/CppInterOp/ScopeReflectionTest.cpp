@@ -12,9 +12,14 @@
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Sema/Sema.h"
 
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
 #include "gtest/gtest.h"
 
 #include <CppInterOp/CppInterOpTypes.h>
+#include <algorithm>
 #include <memory>
 #include <string>
 
@@ -1204,6 +1209,56 @@ template<typename T> T TrivialFnTemplate() { return T(); }
   EXPECT_TRUE(TA1.getAsType()->isIntegerType());
 }
 
+TYPED_TEST(CPPINTEROP_TEST_MODE, ScopeReflection_InstantiateTemplates) {
+  std::vector<Decl*> Decls;
+  std::string code = R"(
+    template<typename T> struct BatchBox { T t; };
+    template<typename K, typename V> struct BatchPair { K k; V v; };
+    template<typename T> T BatchFn() { return T(); }
+    typedef int BatchInt;
+    int batch_not_a_template;
+  )";
+
+  GetAllTopLevelDecls(code, Decls);
+  ASTContext& C = Interp->getCI()->getASTContext();
+  Cpp::TypeRef IntTy = C.IntTy.getAsOpaquePtr();
+  Cpp::TypeRef DoubleTy = C.DoubleTy.getAsOpaquePtr();
+
+  std::vector<Cpp::TemplateInstantiation> requests = {
+      {Decls[0], {IntTy.data}},
+      {Decls[1], {IntTy.data, DoubleTy.data}},
+      {Decls[2], {DoubleTy.data}},
+      {Decls[4], {IntTy.data}},
+      {Decls[0], {DoubleTy.data}},
+  };
+  std::vector<Cpp::DeclRef> instances;
+  Cpp::InstantiateTemplates(requests, instances);
+  ASSERT_EQ(instances.size(), requests.size());
+
+  auto* BoxInt = dyn_cast_or_null<ClassTemplateSpecializationDecl>(
+      Cpp::unwrap<Decl>(instances[0]));
+  ASSERT_TRUE(BoxInt);
+  EXPECT_TRUE(BoxInt->hasDefinition());
+  EXPECT_TRUE(isa_and_nonnull<ClassTemplateSpecializationDecl>(
+      Cpp::unwrap<Decl>(instances[1])));
+  EXPECT_TRUE(isa_and_nonnull<FunctionDecl>(Cpp::unwrap<Decl>(instances[2])));
+  EXPECT_FALSE(instances[3]);
+  EXPECT_NE(instances[4], instances[0]);
+
+  // The batch and the single-instantiation API share the memo; sugared
+  // arguments resolve to the same canonical specialization.
+  Cpp::TypeRef IntAlias = Cpp::GetTypeFromScope(Decls[3]);
+  std::vector<Cpp::TemplateArgInfo> alias_args = {IntAlias.data};
+  EXPECT_EQ(Cpp::InstantiateTemplate(Decls[0], alias_args), instances[0]);
+  std::vector<Cpp::TemplateArgInfo> fn_args = {DoubleTy.data};
+  EXPECT_EQ(Cpp::InstantiateTemplate(Decls[2], fn_args), instances[2]);
+
+  // Re-running the batch returns the memoized specializations.
+  std::vector<Cpp::DeclRef> again;
+  Cpp::InstantiateTemplates(requests, again);
+  EXPECT_EQ(again, instances);
+}
+
 TYPED_TEST(CPPINTEROP_TEST_MODE,
            ScopeReflection_InstantiateTemplateFunctionFromString) {
   std::vector<const char*> interpreter_args = {"-include", "new"};
@@ -1495,3 +1550,105 @@ TYPED_TEST(CPPINTEROP_TEST_MODE, ScopeReflection_GetOperator) {
   Cpp::GetOperator(Cpp::GetScope("Child"), Cpp::Operator::OP_Minus, ops);
   EXPECT_EQ(ops.size(), 1);
 }
+
+TYPED_TEST(CPPINTEROP_TEST_MODE, ScopeReflection_ReflectionDatabase) {
+  std::vector<Decl*> Decls;
+  std::string code = R"(
+    namespace rdb {
+      struct Point {
+        int x;
+        double y;
+        static int count;
+        int norm() const { return x; }
+      };
+      int Point::count = 0;
+      namespace inner { enum Color { Red = 1, Blue = 4 }; }
+      template<typename T> struct Skipped { T t; };
+    }
+    namespace rdb { struct Reopened { virtual ~Reopened() {} }; }
+  )";
+
+  GetAllTopLevelDecls(code, Decls);
+  SmallString<128> Path;
+  ASSERT_FALSE(sys::fs::createTemporaryFile("cppinterop", "rdb", Path));
+  EXPECT_FALSE(Cpp::ExportReflectionDatabase({"no_such_ns"}, Path.c_str()));
+  ASSERT_TRUE(Cpp::ExportReflectionDatabase({"rdb"}, Path.c_str()));
+  Cpp::ReflectionDatabase* DB = Cpp::OpenReflectionDatabase(Path.c_str());
+  ASSERT_TRUE(DB);
+
+  size_t Root = Cpp::ReflectionDBGetScope(DB, "");
+  EXPECT_EQ(Root, 1u);
+  std::vector<size_t> Subs;
+  Cpp::ReflectionDBGetSubScopes(DB, Root, Subs);
+  ASSERT_EQ(Subs.size(), 1u);
+  EXPECT_STREQ(Cpp::ReflectionDBGetScopeInfo(DB, Subs[0]).m_Name, "rdb");
+
+  // The reopened namespace is merged; the class template is skipped.
+  size_t NS = Cpp::ReflectionDBGetScope(DB, "rdb");
+  EXPECT_EQ(NS, Subs[0]);
+  Subs.clear();
+  Cpp::ReflectionDBGetSubScopes(DB, NS, Subs);
+  EXPECT_EQ(Subs.size(), 3u);
+  EXPECT_EQ(Cpp::ReflectionDBGetScope(DB, "rdb::Skipped"), 0u);
+  EXPECT_TRUE(Cpp::ReflectionDBGetScope(DB, "rdb::Reopened"));
+
+  size_t Point = Cpp::ReflectionDBGetScope(DB, "rdb::Point");
+  ASSERT_TRUE(Point);
+  Cpp::DeclRef LivePoint = Cpp::GetScopeFromCompleteName("rdb::Point");
+  Cpp::ReflectionDBScope Info = Cpp::ReflectionDBGetScopeInfo(DB, Point);
+  EXPECT_EQ(Info.m_Kind, Cpp::kRDBClass);
+  EXPECT_EQ(Info.m_Parent, NS);
+  EXPECT_EQ(Info.m_Size, Cpp::SizeOf(LivePoint));
+  EXPECT_EQ(Cpp::ReflectionDBResolveScope(DB, Point), LivePoint);
+
+  std::vector<Cpp::ReflectionDBField> Fields;
+  Cpp::ReflectionDBGetDatamembers(DB, Point, Fields);
+  ASSERT_EQ(Fields.size(), 3u);
+  EXPECT_STREQ(Fields[0].m_Name, "x");
+  EXPECT_STREQ(Fields[0].m_Type, "int");
+  EXPECT_EQ(Fields[0].m_Offset, 0);
+  EXPECT_STREQ(Fields[1].m_Name, "y");
+  EXPECT_EQ(Fields[1].m_Offset,
+            Cpp::GetVariableOffset(Cpp::LookupDatamember("y", LivePoint)));
+  EXPECT_STREQ(Fields[2].m_Name, "count");
+  EXPECT_EQ(Fields[2].m_Flags, Cpp::kRDBStatic);
+  EXPECT_STRNE(Fields[2].m_MangledName, "");
+
+  std::vector<Cpp::ReflectionDBMethod> Methods;
+  Cpp::ReflectionDBGetClassMethods(DB, Point, Methods);
+  auto Norm = std::find_if(Methods.begin(), Methods.end(), [](const auto& M) {
+    return std::string(M.m_Name) == "norm";
+  });
+  ASSERT_NE(Norm, Methods.end());
+  EXPECT_EQ(Norm->m_NumArgs, 0u);
+  EXPECT_EQ(Norm->m_Flags, Cpp::kRDBConst);
+  EXPECT_STRNE(Norm->m_MangledName, "");
+
+  size_t Color = Cpp::ReflectionDBGetScope(DB, "rdb::inner::Color");
+  ASSERT_TRUE(Color);
+  EXPECT_EQ(Cpp::ReflectionDBGetScopeInfo(DB, Color).m_Kind, Cpp::kRDBEnum);
+  std::vector<Cpp::ReflectionDBEnumerator> Enumerators;
+  Cpp::ReflectionDBGetEnumerators(DB, Color, Enumerators);
+  ASSERT_EQ(Enumerators.size(), 2u);
+  EXPECT_STREQ(Enumerators[0].m_Name, "Red");
+  EXPECT_EQ(Enumerators[0].m_Value, 1);
+  EXPECT_STREQ(Enumerators[1].m_Name, "Blue");
+  EXPECT_EQ(Enumerators[1].m_Value, 4);
+
+  // Invalid ids are harmless.
+  EXPECT_STREQ(Cpp::ReflectionDBGetScopeInfo(DB, 0).m_Name, "");
+  Subs.clear();
+  Cpp::ReflectionDBGetSubScopes(DB, 1000, Subs);
+  EXPECT_TRUE(Subs.empty());
+  Cpp::CloseReflectionDatabase(DB);
+
+  {
+    std::error_code EC;
+    raw_fd_ostream OS(Path, EC);
+    ASSERT_FALSE(EC);
+    OS << "not a reflection database";
+  }
+  EXPECT_FALSE(Cpp::OpenReflectionDatabase(Path.c_str()));
+  sys::fs::remove(Path);
+  EXPECT_FALSE(Cpp::OpenReflectionDatabase(Path.c_str()));
+}
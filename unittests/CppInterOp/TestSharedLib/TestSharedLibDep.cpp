@@ -0,0 +1,3 @@
+#include "TestSharedLib.h"
+
+extern "C" TESTSHAREDLIB_API int ret_one() { return ret_zero() + 1; }
@@ -853,3 +853,137 @@ TYPED_TEST(CPPINTEROP_TEST_MODE, TypeReflection_IsSameType) {
   EXPECT_TRUE(Cpp::IsSameType(Cpp::GetVariableType(Decls[5]),
                               Cpp::GetVariableType(Decls[6])));
 }
+
+TYPED_TEST(CPPINTEROP_TEST_MODE, TypeReflection_GetTypeId) {
+  std::vector<Decl*> Decls;
+
+  std::string code = R"(
+    typedef int IntAlias;
+    struct TypeIdPOD { int a; double b; };
+    struct TypeIdFwd;
+    IntAlias ia = 0;
+    int** ipp = nullptr;
+    TypeIdPOD pod;
+  )";
+
+  GetAllTopLevelDecls(code, Decls);
+  Decls.assign(Decls.end() - 3, Decls.end());
+
+  EXPECT_EQ(Cpp::GetTypeId(nullptr), 0U);
+
+  // Sugar is looked through: the typedef and the builtin share an id.
+  size_t IntId = Cpp::GetTypeId(Cpp::GetType("int"));
+  EXPECT_NE(IntId, 0U);
+  EXPECT_EQ(Cpp::GetTypeId(Cpp::GetVariableType(Decls[0])), IntId);
+  EXPECT_EQ(Cpp::GetTypeId(Cpp::GetType("IntAlias")), IntId);
+  EXPECT_NE(Cpp::GetTypeId(Cpp::GetType("unsigned int")), IntId);
+  EXPECT_TRUE(Cpp::IsSameType(Cpp::GetTypeFromId(IntId), Cpp::GetType("int")));
+  EXPECT_FALSE(Cpp::GetTypeFromId(0));
+  EXPECT_FALSE(Cpp::GetTypeFromId(1000000));
+
+  Cpp::TypeIdInfo IntInfo = Cpp::GetTypeIdInfo(IntId);
+  EXPECT_EQ(IntInfo.m_Size, sizeof(int));
+  EXPECT_EQ(IntInfo.m_Align, alignof(int));
+  EXPECT_EQ(IntInfo.m_BuiltinKind, Cpp::Box::K_Int);
+  EXPECT_EQ(IntInfo.m_PointerDepth, 0U);
+  EXPECT_TRUE(IntInfo.m_IsPOD);
+
+  size_t PtrId = Cpp::GetTypeId(Cpp::GetVariableType(Decls[1]));
+  Cpp::TypeIdInfo PtrInfo = Cpp::GetTypeIdInfo(PtrId);
+  EXPECT_EQ(PtrInfo.m_Size, sizeof(int**));
+  EXPECT_EQ(PtrInfo.m_BuiltinKind, Cpp::Box::K_PtrOrObj);
+  EXPECT_EQ(PtrInfo.m_PointerDepth, 2U);
+
+  size_t PODId = Cpp::GetTypeId(Cpp::GetVariableType(Decls[2]));
+  Cpp::TypeIdInfo PODInfo = Cpp::GetTypeIdInfo(PODId);
+  EXPECT_EQ(PODInfo.m_Size, 2 * sizeof(double));
+  EXPECT_EQ(PODInfo.m_Align, alignof(double));
+  EXPECT_TRUE(PODInfo.m_IsPOD);
+
+  // Ids are stable across repeated queries.
+  EXPECT_EQ(Cpp::GetTypeId(Cpp::GetType("TypeIdPOD")), PODId);
+  EXPECT_EQ(Cpp::GetTypeId(Cpp::GetType("int")), IntId);
+
+  // Incomplete types get an id; their size is filled in once they are
+  // defined.
+  size_t FwdId = Cpp::GetTypeId(Cpp::GetType("TypeIdFwd"));
+  EXPECT_NE(FwdId, 0U);
+  EXPECT_EQ(Cpp::GetTypeIdInfo(FwdId).m_Size, 0U);
+  Interp->declare("struct TypeIdFwd { char c[3]; };");
+  EXPECT_EQ(Cpp::GetTypeIdInfo(FwdId).m_Size, 3U);
+  EXPECT_EQ(Cpp::GetTypeId(Cpp::GetType("TypeIdFwd")), FwdId);
+
+  EXPECT_EQ(Cpp::GetTypeIdInfo(0).m_BuiltinKind, -1);
+}
+
+TYPED_TEST(CPPINTEROP_TEST_MODE, TypeReflection_GetContiguousView) {
+  if (TypeParam::isOutOfProcess)
+    GTEST_SKIP() << "Views read host objects in-process";
+  std::vector<Decl*> Decls;
+
+  std::string code = R"(
+    #include <string>
+    #include <vector>
+    template <class T> struct ViewBuf { T* p; int n; };
+    std::vector<double> view_vec;
+    std::string view_str;
+    int view_arr[4];
+    ViewBuf<float> view_buf;
+  )";
+
+  GetAllTopLevelDecls(code, Decls);
+  Decls.assign(Decls.end() - 4, Decls.end());
+
+  std::vector<double> vec = {1.0, 2.0, 3.0};
+  Cpp::ContiguousView View =
+      Cpp::GetContiguousView(Cpp::GetVariableType(Decls[0]), &vec);
+  EXPECT_EQ(View.m_Data, vec.data());
+  EXPECT_EQ(View.m_Size, 3U);
+  EXPECT_EQ(View.m_Stride, sizeof(double));
+  EXPECT_EQ(Cpp::GetTypeAsString(View.m_ElementType), "double");
+  // The extractor is cached; a different object of the type reuses it.
+  vec.push_back(4.0);
+  View = Cpp::GetContiguousView(Cpp::GetVariableType(Decls[0]), &vec);
+  EXPECT_EQ(View.m_Data, vec.data());
+  EXPECT_EQ(View.m_Size, 4U);
+
+  std::string str = "contiguous";
+  View = Cpp::GetContiguousView(Cpp::GetVariableType(Decls[1]), &str);
+  EXPECT_EQ(View.m_Data, str.data());
+  EXPECT_EQ(View.m_Size, str.size());
+  EXPECT_EQ(View.m_Stride, 1U);
+
+  int arr[4] = {};
+  View = Cpp::GetContiguousView(Cpp::GetVariableType(Decls[2]), arr);
+  EXPECT_EQ(View.m_Data, arr);
+  EXPECT_EQ(View.m_Size, 4U);
+  EXPECT_EQ(View.m_Stride, sizeof(int));
+
+  // User types are described by the hook registered for their template.
+  struct HostBuf {
+    float* p;
+    int n;
+  };
+  float fs[2] = {0.5f, 1.5f};
+  HostBuf buf = {fs, 2};
+  Cpp::TypeRef BufTy = Cpp::GetVariableType(Decls[3]);
+  EXPECT_FALSE(Cpp::GetContiguousView(BufTy, &buf).m_Data);
+  Cpp::RegisterContiguousView(
+      Cpp::GetNamed("ViewBuf"),
+      [](void* obj, Cpp::TypeRef, Cpp::ContiguousView& view) {
+        auto* b = static_cast<HostBuf*>(obj);
+        view.m_Data = b->p;
+        view.m_Size = b->n;
+        view.m_ElementType = Cpp::GetType("float");
+        view.m_Stride = sizeof(float);
+        return true;
+      });
+  View = Cpp::GetContiguousView(BufTy, &buf);
+  EXPECT_EQ(View.m_Data, fs);
+  EXPECT_EQ(View.m_Size, 2U);
+  Cpp::RegisterContiguousView(Cpp::GetNamed("ViewBuf"), nullptr);
+  EXPECT_FALSE(Cpp::GetContiguousView(BufTy, &buf).m_Data);
+
+  EXPECT_FALSE(Cpp::GetContiguousView(Cpp::GetType("int"), arr).m_Data);
+  EXPECT_FALSE(Cpp::GetContiguousView(BufTy, nullptr).m_Data);
+}
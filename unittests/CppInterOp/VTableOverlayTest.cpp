@@ -300,30 +300,82 @@ TEST(VTableOverlay, MultiLevelInheritance) {
 }
 
 // Multiple inheritance with two polymorphic direct bases produces two
-// vptrs (one per non-empty base subobject); the primary-vptr-only overlay
-// cannot retarget the secondary-base dispatch path. MakeVTableOverlay
-// refuses such a layout outright so the caller never gets back a handle
-// that would mis-dispatch through the untouched secondary vptr.
-TEST(VTableOverlay, RejectsMultipleInheritance) {
+// vptrs (one per non-empty base subobject). On Itanium the overlay copies
+// the whole vtable group and retargets both; the slot in the secondary
+// vtable gets a thunk that hands the replacement the complete object. MSVC
+// refuses the layout outright so the caller never gets back a handle that
+// would mis-dispatch through the untouched secondary vptr.
+TEST(VTableOverlay, MultipleInheritance) {
   Cpp::CreateInterpreter({"-include", "new"});
-  Cpp::Declare("struct MiA { virtual ~MiA() {} virtual int af(int x) { return x + 10; } };"
+  Cpp::Declare("struct MiA { int a = 7; virtual ~MiA() {} virtual int af(int x) { return x + 10; } };"
                "struct MiB { virtual ~MiB() {} virtual int bf(int x) { return x + 20; } };"
                "struct MiC : MiA, MiB {"
                "  int af(int x) override { return x + 11; }"
                "  int bf(int x) override { return x + 22; }"
                "};");
   auto C = Cpp::GetNamed("MiC");
+  auto MiB = Cpp::GetNamed("MiB");
   ASSERT_NE(C, nullptr);
+  ASSERT_NE(MiB, nullptr);
   void* inst = Cpp::Construct(C).data;
   ASSERT_NE(inst, nullptr);
 
+  // bf is named through the base it comes from; the overlay resolves the
+  // final overrider in MiC.
   auto ov = Cpp::MakeUniqueVTableOverlay(
-      inst, C, {{Method(C, "af"), MethodAddr(&Repl::negate)}});
+      inst, C,
+      {{Method(C, "af"), MethodAddr(&Repl::negate)},
+       {Method(MiB, "bf"), MethodAddr(&Repl::read_value)}});
+#ifdef _WIN32
   EXPECT_FALSE(ov); // refuses the layout
+#else
+  ASSERT_TRUE(ov);
+  EXPECT_TRUE(Cpp::GetVTableLayoutInfo(C).m_MultipleVPtrs);
+  void* sub = static_cast<char*>(inst) + Cpp::GetBaseClassOffset(C, MiB);
+  EXPECT_EQ(call_slot(inst, kAlpha, 5), -5); // MiC's primary vtable: af
+  EXPECT_EQ(call_slot(inst, kBeta, 5), 12);  // ... and bf: a(=7) + x
+  EXPECT_EQ(call_slot(sub, kAlpha, 5), 12);  // MiB-in-MiC, through the thunk
+  ov.reset();
+  EXPECT_EQ(call_slot(inst, kBeta, 5), 27);
+  EXPECT_EQ(call_slot(sub, kAlpha, 5), 27);
+#endif
 
   Cpp::Destruct(inst, C);
 }
 
+// A class with a single direct base still carries two vptrs when that base
+// has two polymorphic bases. Dispatch through the second of them must reach
+// the replacement, as in MultipleInheritance.
+TEST(VTableOverlay, IndirectMultipleInheritance) {
+  Cpp::CreateInterpreter({"-include", "new"});
+  Cpp::Declare("struct ImA { int a = 7; virtual ~ImA() {} virtual int af(int x) { return x + 10; } };"
+               "struct ImB { virtual ~ImB() {} virtual int bf(int x) { return x + 20; } };"
+               "struct ImC : ImA, ImB {};"
+               "struct ImD : ImC {};");
+  auto D = Cpp::GetNamed("ImD");
+  auto ImB = Cpp::GetNamed("ImB");
+  ASSERT_NE(D, nullptr);
+  ASSERT_NE(ImB, nullptr);
+  void* inst = Cpp::Construct(D).data;
+  ASSERT_NE(inst, nullptr);
+
+  auto ov = Cpp::MakeUniqueVTableOverlay(
+      inst, D, {{Method(ImB, "bf"), MethodAddr(&Repl::read_value)}});
+#ifdef _WIN32
+  EXPECT_FALSE(ov); // refuses the layout
+#else
+  ASSERT_TRUE(ov);
+  EXPECT_TRUE(Cpp::GetVTableLayoutInfo(D).m_MultipleVPtrs);
+  void* sub = static_cast<char*>(inst) + Cpp::GetBaseClassOffset(D, ImB);
+  ASSERT_NE(sub, inst);
+  EXPECT_EQ(call_slot(sub, kAlpha, 5), 12); // ImB-in-ImD: a(=7) + x
+  ov.reset();
+  EXPECT_EQ(call_slot(sub, kAlpha, 5), 25);
+#endif
+
+  Cpp::Destruct(inst, D);
+}
+
 // Non-polymorphic class has no vtable to overlay; rejected at the
 // RD->isPolymorphic() gate inside MakeVTableOverlay.
 TEST(VTableOverlay, RejectsNonPolymorphicBase) {
@@ -429,28 +481,57 @@ TEST(VTableOverlay, OverlayThroughHierarchyAccessesDataMembers) {
 
 // Virtual inheritance has a longer pre-address-point prefix (vbase-offset
 // entries) and a vtable-in-vbase that carries `_ZTv0_n*` virtual thunks for
-// dispatch through the virtual-base pointer -- neither is covered by the
-// primary-vptr overlay. MakeVTableOverlay refuses, mirroring the multi-
-// inheritance case. Reviewer ref: stackoverflow.com/a/39182009.
-TEST(VTableOverlay, RejectsVirtualInheritance) {
+// dispatch through the virtual-base pointer. On Itanium the overlay
+// retargets the virtual-base vptr too, including its deleting dtor when a
+// hook is requested; the extra-prefix slots are refused because the vbase
+// offset occupies their place. MSVC refuses the layout.
+// Reviewer ref: stackoverflow.com/a/39182009.
+TEST(VTableOverlay, VirtualInheritance) {
   Cpp::CreateInterpreter({"-include", "new"});
   Cpp::Declare("struct ViBase {"
+               "  int b = 7;"
                "  virtual ~ViBase() {}"
                "  virtual int frob(int x) { return x + 1; }"
                "};"
                "struct ViDerived : virtual ViBase {"
+               "  int d = 9;"
                "  int frob(int x) override { return x + 2; }"
                "};");
   auto D = Cpp::GetNamed("ViDerived");
+  auto VB = Cpp::GetNamed("ViBase");
   ASSERT_NE(D, nullptr);
+  ASSERT_NE(VB, nullptr);
   void* inst = Cpp::Construct(D).data;
   ASSERT_NE(inst, nullptr);
 
-  auto ov = Cpp::MakeUniqueVTableOverlay(
-      inst, D, {{Method(D, "frob"), MethodAddr(&Repl::negate)}});
-  EXPECT_FALSE(ov); // refuses the layout
-
+  Cpp::ConstFuncRef frob = Method(D, "frob");
+  void* fn = MethodAddr(&Repl::read_value);
+  int fires = 0;
+  auto* ov = Cpp::MakeVTableOverlay(
+      inst, D, &frob, &fn, 1, /*n_extra_prefix_slots=*/0,
+      [](void* /*i*/, void* data) { *static_cast<int*>(data) += 1; }, &fires);
+#ifdef _WIN32
+  EXPECT_EQ(ov, nullptr); // refuses the layout
   Cpp::Destruct(inst, D);
+#else
+  ASSERT_NE(ov, nullptr);
+  void* sub = static_cast<char*>(inst) + Cpp::GetBaseClassOffset(D, VB);
+  EXPECT_EQ(call_slot(inst, kAlpha, 5), 14); // d(=9) + x
+  EXPECT_EQ(call_slot(sub, kAlpha, 5), 14);  // ViBase-in-ViDerived
+
+  void* other = Cpp::Construct(D).data;
+  ASSERT_NE(other, nullptr);
+  EXPECT_EQ(Cpp::MakeVTableOverlay(other, D, &frob, &fn, 1,
+                                   /*n_extra_prefix_slots=*/1),
+            nullptr);
+  Cpp::Destruct(other, D);
+
+  // Deleting through the virtual base reaches the hook as well.
+  void** sub_vptr = *reinterpret_cast<void***>(sub);
+  TestUtils::BitCastFn<void (*)(void*)>(sub_vptr[1])(sub);
+  EXPECT_EQ(fires, 1);
+  Cpp::DestroyVTableOverlay(ov);
+#endif
 }
 
 // on_destroy fires once on the deleting-dtor path (before the original
@@ -608,3 +689,202 @@ TEST(VTableOverlay, SetsExtraPrefixSlots) {
   ov.reset();
   Cpp::Destruct(inst, B);
 }
+
+// The per-class layout info lets a binding resolve slots once and then
+// install overlays without going through reflection for every instance.
+TEST(VTableOverlay, LayoutInfoDrivesSlotOverload) {
+  auto B = DeclareBase();
+  Cpp::VTableLayoutInfo info = Cpp::GetVTableLayoutInfo(B);
+  ASSERT_TRUE(info.m_CanOverlay);
+  // Itanium: D1, D0, alpha, beta; MSVC: deleting dtor, alpha, beta.
+  EXPECT_EQ(info.m_NumSlots, kBeta + 1);
+  ASSERT_EQ(info.m_Slots.size(), static_cast<std::size_t>(kBeta + 1));
+  EXPECT_EQ(info.m_Slots[kAlpha].m_Method, Method(B, "alpha"));
+  EXPECT_EQ(info.m_Slots[kBeta].m_Method, Method(B, "beta"));
+  EXPECT_EQ(info.m_Slots[kBeta].m_Slot, kBeta);
+
+  void* inst = Cpp::Construct(B).data;
+  ASSERT_NE(inst, nullptr);
+  void* fn = MethodAddr(&Repl::negate);
+  int out_of_range = info.m_NumSlots;
+  EXPECT_EQ(Cpp::MakeVTableOverlay(inst, info, &out_of_range, &fn, 1),
+            nullptr);
+  EXPECT_EQ(Cpp::MakeVTableOverlay(inst, Cpp::VTableLayoutInfo(),
+                                   &info.m_Slots[kBeta].m_Slot, &fn, 1),
+            nullptr);
+
+  auto* ov =
+      Cpp::MakeVTableOverlay(inst, info, &info.m_Slots[kBeta].m_Slot, &fn, 1);
+  ASSERT_NE(ov, nullptr);
+  EXPECT_EQ(call_slot(inst, kBeta, 5), -5);  // overlaid
+  EXPECT_EQ(call_slot(inst, kAlpha, 5), 15); // preserved
+  Cpp::DestroyVTableOverlay(ov);
+  Cpp::Destruct(inst, B);
+
+  EXPECT_FALSE(Cpp::GetVTableLayoutInfo(nullptr).m_CanOverlay);
+}
+
+// An array of objects gets one patched vtable and one handle: every
+// element dispatches to the replacement, and destroying the handle
+// restores them all.
+TEST(VTableOverlay, ArrayOverlay) {
+  auto B = DeclareBase();
+  constexpr std::size_t kCount = 4;
+  void* arr = Cpp::Construct(B, nullptr, kCount).data;
+  ASSERT_NE(arr, nullptr);
+  std::size_t stride = Cpp::SizeOf(B);
+  auto at = [&](std::size_t i) { return static_cast<char*>(arr) + i * stride; };
+  void** orig = *reinterpret_cast<void***>(arr);
+
+  Cpp::ConstFuncRef beta = Method(B, "beta");
+  void* fn = MethodAddr(&Repl::negate);
+  EXPECT_EQ(Cpp::MakeVTableOverlayArray(arr, 1, kCount, B, &beta, &fn, 1),
+            nullptr); // stride smaller than the class
+  EXPECT_EQ(Cpp::MakeVTableOverlayArray(arr, stride, 0, B, &beta, &fn, 1),
+            nullptr);
+
+  auto* ov = Cpp::MakeVTableOverlayArray(arr, stride, kCount, B, &beta, &fn, 1);
+  ASSERT_NE(ov, nullptr);
+  void** shared = *reinterpret_cast<void***>(arr);
+  EXPECT_NE(shared, orig);
+  for (std::size_t i = 0; i < kCount; ++i) {
+    EXPECT_EQ(*reinterpret_cast<void***>(at(i)), shared);
+    EXPECT_EQ(call_slot(at(i), kBeta, 5), -5);
+    EXPECT_EQ(call_slot(at(i), kAlpha, 5), 15);
+  }
+
+  Cpp::DestroyVTableOverlay(ov);
+  for (std::size_t i = 0; i < kCount; ++i)
+    EXPECT_EQ(call_slot(at(i), kBeta, 5), 25);
+  Cpp::Destruct(arr, B, /*withFree=*/true, kCount);
+}
+
+// Instances overlaid with the same replacements share one interned vtable;
+// different replacements get their own.
+TEST(VTableOverlay, SharedOverlayIsInterned) {
+  auto B = DeclareBase();
+  Cpp::VTableLayoutInfo info = Cpp::GetVTableLayoutInfo(B);
+  void* a = Cpp::Construct(B).data;
+  void* b = Cpp::Construct(B).data;
+  void* c = Cpp::Construct(B).data;
+  ASSERT_NE(a, nullptr);
+  ASSERT_NE(b, nullptr);
+  ASSERT_NE(c, nullptr);
+  auto vptr_of = [](void* inst) { return *reinterpret_cast<void***>(inst); };
+  void** orig = vptr_of(a);
+
+  int slot = kBeta;
+  void* negate = MethodAddr(&Repl::negate);
+  void* twice = MethodAddr(&Repl::twice);
+  ASSERT_TRUE(Cpp::InstallSharedVTableOverlay(a, info, &slot, &negate, 1));
+  ASSERT_TRUE(Cpp::InstallSharedVTableOverlay(b, info, &slot, &negate, 1));
+  ASSERT_TRUE(Cpp::InstallSharedVTableOverlay(c, info, &slot, &twice, 1));
+  EXPECT_FALSE(Cpp::InstallSharedVTableOverlay(a, info, &slot, &negate, 1));
+  EXPECT_NE(vptr_of(a), orig);
+  EXPECT_EQ(vptr_of(a), vptr_of(b));
+  EXPECT_NE(vptr_of(a), vptr_of(c));
+  EXPECT_EQ(call_slot(a, kBeta, 5), -5);
+  EXPECT_EQ(call_slot(b, kAlpha, 5), 15);
+  EXPECT_EQ(call_slot(c, kBeta, 5), 10);
+
+  Cpp::RemoveSharedVTableOverlay(a);
+  EXPECT_EQ(vptr_of(a), orig);
+  EXPECT_EQ(call_slot(b, kBeta, 5), -5); // b still holds the shared block
+  Cpp::RemoveSharedVTableOverlay(a);     // no-op
+  Cpp::RemoveSharedVTableOverlay(b);
+  Cpp::RemoveSharedVTableOverlay(c);
+  EXPECT_EQ(vptr_of(b), orig);
+  EXPECT_EQ(vptr_of(c), orig);
+  Cpp::Destruct(a, B);
+  Cpp::Destruct(b, B);
+  Cpp::Destruct(c, B);
+}
+
+// Objects of a derived class overlaid once with the layout of their base and
+// once with their own share the original vtable, but not the block: the
+// block built for the base is too short for the slots the derived class adds.
+TEST(VTableOverlay, SharedOverlayKeyedOnLayoutSize) {
+  auto B = DeclareBase();
+  Cpp::Declare("struct OverlayD : OverlayB {"
+               "  virtual int gamma(int x) { return x + 30; }"
+               "};");
+  auto D = Cpp::GetNamed("OverlayD");
+  Cpp::VTableLayoutInfo base_info = Cpp::GetVTableLayoutInfo(B);
+  Cpp::VTableLayoutInfo derived_info = Cpp::GetVTableLayoutInfo(D);
+  ASSERT_LT(base_info.m_NumSlots, derived_info.m_NumSlots);
+  void* d1 = Cpp::Construct(D).data;
+  void* d2 = Cpp::Construct(D).data;
+  ASSERT_NE(d1, nullptr);
+  ASSERT_NE(d2, nullptr);
+  auto vptr_of = [](void* inst) { return *reinterpret_cast<void***>(inst); };
+  const int kGamma = kBeta + 1;
+
+  int slot = kBeta;
+  void* negate = MethodAddr(&Repl::negate);
+  ASSERT_TRUE(Cpp::InstallSharedVTableOverlay(d1, base_info, &slot, &negate,
+                                              1));
+  ASSERT_TRUE(Cpp::InstallSharedVTableOverlay(d2, derived_info, &slot,
+                                              &negate, 1));
+  EXPECT_NE(vptr_of(d1), vptr_of(d2));
+  EXPECT_EQ(call_slot(d1, kBeta, 5), -5);
+  EXPECT_EQ(call_slot(d2, kBeta, 5), -5);
+  EXPECT_EQ(call_slot(d2, kGamma, 5), 35);
+
+  Cpp::RemoveSharedVTableOverlay(d1);
+  Cpp::RemoveSharedVTableOverlay(d2);
+  EXPECT_EQ(vptr_of(d1), vptr_of(d2));
+  Cpp::Destruct(d1, D);
+  Cpp::Destruct(d2, D);
+}
+
+// The dtor hook of a shared overlay receives each instance's own data and
+// deleting an instance releases its reference.
+TEST(VTableOverlay, SharedOverlayDestructorHook) {
+  auto B = DeclareBase();
+  Cpp::VTableLayoutInfo info = Cpp::GetVTableLayoutInfo(B);
+  void* a = Cpp::Construct(B).data;
+  void* b = Cpp::Construct(B).data;
+  ASSERT_NE(a, nullptr);
+  ASSERT_NE(b, nullptr);
+
+  int fires_a = 0;
+  int fires_b = 0;
+  auto hook = [](void* /*i*/, void* data) { *static_cast<int*>(data) += 1; };
+  ASSERT_TRUE(Cpp::InstallSharedVTableOverlay(a, info, nullptr, nullptr, 0,
+                                              0, hook, &fires_a));
+  ASSERT_TRUE(Cpp::InstallSharedVTableOverlay(b, info, nullptr, nullptr, 0,
+                                              0, hook, &fires_b));
+  Cpp::Destruct(a, B);
+  EXPECT_EQ(fires_a, 1);
+  EXPECT_EQ(fires_b, 0);
+  Cpp::Destruct(b, B);
+  EXPECT_EQ(fires_b, 1);
+}
+
+// Instances sharing a block keep their own data, looked up by instance.
+TEST(VTableOverlay, SharedOverlayInstanceData) {
+  auto B = DeclareBase();
+  Cpp::VTableLayoutInfo info = Cpp::GetVTableLayoutInfo(B);
+  void* a = Cpp::Construct(B).data;
+  void* b = Cpp::Construct(B).data;
+  ASSERT_NE(a, nullptr);
+  ASSERT_NE(b, nullptr);
+  auto vptr_of = [](void* inst) { return *reinterpret_cast<void***>(inst); };
+
+  int data_a = 1;
+  int data_b = 2;
+  ASSERT_TRUE(Cpp::InstallSharedVTableOverlay(a, info, nullptr, nullptr, 0,
+                                              1, nullptr, &data_a));
+  ASSERT_TRUE(Cpp::InstallSharedVTableOverlay(b, info, nullptr, nullptr, 0,
+                                              1, nullptr, &data_b));
+  EXPECT_EQ(vptr_of(a), vptr_of(b));
+  EXPECT_EQ(Cpp::GetSharedVTableOverlayData(a), &data_a);
+  EXPECT_EQ(Cpp::GetSharedVTableOverlayData(b), &data_b);
+
+  Cpp::RemoveSharedVTableOverlay(a);
+  EXPECT_EQ(Cpp::GetSharedVTableOverlayData(a), nullptr);
+  EXPECT_EQ(Cpp::GetSharedVTableOverlayData(b), &data_b);
+  Cpp::Destruct(b, B);
+  EXPECT_EQ(Cpp::GetSharedVTableOverlayData(b), nullptr);
+  Cpp::Destruct(a, B);
+}
@@ -475,6 +475,110 @@ TYPED_TEST(CPPINTEROP_TEST_MODE, VariableReflection_VariableOffsetsWithInheritan
             ((intptr_t)&(my_k.s)) - ((intptr_t)&(my_k)));
 }
 
+#define CODE                                                                   \
+  struct LayoutA {                                                             \
+    int a;                                                                     \
+  };                                                                           \
+  struct LayoutV {                                                             \
+    double v;                                                                  \
+  };                                                                           \
+  struct LayoutB : LayoutA, virtual LayoutV {                                  \
+    char b;                                                                    \
+    union {                                                                    \
+      int u1;                                                                  \
+      float u2;                                                                \
+    };                                                                         \
+  };                                                                           \
+  struct LayoutC : LayoutB {                                                   \
+    long c;                                                                    \
+  } layout_c;
+
+CODE
+
+TYPED_TEST(CPPINTEROP_TEST_MODE, VariableReflection_GetFieldLayout) {
+#ifdef __EMSCRIPTEN__
+  GTEST_SKIP() << "Test fails for Emscipten builds";
+#endif
+  TestFixture::CreateInterpreter();
+
+#define Stringify(s) Stringifyx(s)
+#define Stringifyx(...) #__VA_ARGS__
+  Cpp::Declare(Stringify(CODE));
+#undef Stringifyx
+#undef Stringify
+#undef CODE
+
+  Cpp::DeclRef layout_c_klass = Cpp::GetNamed("LayoutC");
+  ASSERT_TRUE(layout_c_klass);
+
+  std::vector<Cpp::FieldLayoutEntry> fields;
+  Cpp::GetFieldLayout(layout_c_klass, fields);
+  ASSERT_EQ(fields.size(), 6);
+
+  auto offset_of = [](const void* member) {
+    return (intptr_t)member - (intptr_t)&layout_c;
+  };
+  const char* names[] = {"a", "b", "u1", "u2", "c", "v"};
+  intptr_t offsets[] = {offset_of(&layout_c.a),  offset_of(&layout_c.b),
+                        offset_of(&layout_c.u1), offset_of(&layout_c.u2),
+                        offset_of(&layout_c.c),  offset_of(&layout_c.v)};
+  for (size_t i = 0; i < fields.size(); ++i) {
+    EXPECT_EQ(Cpp::GetName(fields[i].m_Field), names[i]);
+    EXPECT_EQ(fields[i].m_Offset, offsets[i]) << names[i];
+    // GetVariableOffset agrees with, and is served from, the bulk layout.
+    EXPECT_EQ(Cpp::GetVariableOffset(fields[i].m_Field, layout_c_klass),
+              offsets[i])
+        << names[i];
+  }
+
+  // Repeated single-field queries return the cached value.
+  Cpp::DeclRef layout_b_klass = Cpp::GetNamed("LayoutB");
+  Cpp::DeclRef field_b = Cpp::GetNamed("b", layout_b_klass);
+  EXPECT_EQ(Cpp::GetVariableOffset(field_b, layout_c_klass),
+            offset_of(&layout_c.b));
+  EXPECT_EQ(Cpp::GetVariableOffset(field_b, layout_c_klass),
+            offset_of(&layout_c.b));
+
+  // Incomplete classes have no layout.
+  Cpp::Declare("struct LayoutFwd;");
+  std::vector<Cpp::FieldLayoutEntry> none;
+  Cpp::GetFieldLayout(Cpp::GetNamed("LayoutFwd"), none);
+  EXPECT_TRUE(none.empty());
+}
+
+TYPED_TEST(CPPINTEROP_TEST_MODE, VariableReflection_GetVariableOffsetAfterUndo) {
+#ifdef _WIN32
+  GTEST_SKIP() << "Disabled on Windows. Needs fixing.";
+#endif
+#if defined(CPPINTEROP_USE_CLING)
+  GTEST_SKIP() << "cling unload walks a module already freed by ORC "
+                  "clone-on-emit; skip until the cling-side fix lands.";
+#endif
+#ifdef EMSCRIPTEN
+  GTEST_SKIP() << "Test fails for Emscipten builds";
+#endif
+  TestFixture::CreateInterpreter();
+
+  // The cached address of the undone definition must not be handed out for
+  // the new one, even if it reuses the memory of the freed decl.
+  auto code = [](int value) {
+    return "struct UndoS { static int s; }; int UndoS::s = " +
+           std::to_string(value) + ";";
+  };
+  ASSERT_EQ(Cpp::Process(code(5).c_str()), 0);
+  auto* first = reinterpret_cast<int*>(
+      Cpp::GetVariableOffset(Cpp::GetNamed("s", Cpp::GetNamed("UndoS"))));
+  ASSERT_TRUE(first);
+  EXPECT_EQ(*first, 5);
+
+  Cpp::Undo();
+  ASSERT_EQ(Cpp::Process(code(7).c_str()), 0);
+  auto* second = reinterpret_cast<int*>(
+      Cpp::GetVariableOffset(Cpp::GetNamed("s", Cpp::GetNamed("UndoS"))));
+  ASSERT_TRUE(second);
+  EXPECT_EQ(*second, 7);
+}
+
 TYPED_TEST(CPPINTEROP_TEST_MODE, VariableReflection_IsPublicVariable) {
   std::vector<Decl *> Decls, SubDecls;
   std::string code = R"(